@@ -1,6 +1,7 @@
 #include "state.h"
 #include <stdlib.h>
 #include "lib/verified/boilerplate-util.h"
+#include "lib/verified/vigor-alloc.h"
 #ifdef KLEE_VERIFICATION
 #include "lib/models/verified/ether.h"
 #endif  // KLEE_VERIFICATION
@@ -8,7 +9,7 @@ struct State* allocated_nf_state = NULL;
 
 struct State* alloc_state() {
   if (allocated_nf_state != NULL) return allocated_nf_state;
-  struct State* ret = malloc(sizeof(struct State));
+  struct State* ret = vigor_malloc(sizeof(struct State));
   if (ret == NULL) return NULL;
 #ifdef KLEE_VERIFICATION
 #endif  // KLEE_VERIFICATION
@@ -0,0 +1,267 @@
+// Concurrent map stress benchmark: every worker lcore looks up random flow
+// keys in a lib/unverified/concurrent-map.h map, while the main lcore
+// replaces the keys in it, and reports lookup and update throughput.
+// Like an NF, the writer recycles the memory of erased keys, so readers
+// check that every key they find still holds the value it was found with,
+// which only holds if erased keys are never reused under a reader.
+//
+// Usage: concurrent-map-bench <EAL args, at least 2 lcores> --
+//            [--capacity N] [--occupancy PERCENT] [--batch N]
+//            [--burst N] [--seconds N]
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_launch.h>
+#include <rte_lcore.h>
+
+#include "lib/unverified/concurrent-map.h"
+#include "lib/verified/vigor-alloc.h"
+
+struct bench_key {
+  uint32_t src_ip;
+  uint32_t dst_ip;
+  uint16_t src_port;
+  uint16_t dst_port;
+  uint8_t protocol;
+};
+
+static unsigned bench_key_hash(void *obj) {
+  struct bench_key *key = obj;
+  unsigned hash = 0;
+  hash = __builtin_ia32_crc32si(hash, key->src_ip);
+  hash = __builtin_ia32_crc32si(hash, key->dst_ip);
+  hash = __builtin_ia32_crc32si(hash, key->src_port);
+  hash = __builtin_ia32_crc32si(hash, key->dst_port);
+  hash = __builtin_ia32_crc32si(hash, key->protocol);
+  return hash;
+}
+
+static bool bench_key_eq(void *a, void *b) {
+  struct bench_key *id1 = a;
+  struct bench_key *id2 = b;
+  return id1->src_ip == id2->src_ip && id1->dst_ip == id2->dst_ip &&
+         id1->src_port == id2->src_port && id1->dst_port == id2->dst_port &&
+         id1->protocol == id2->protocol;
+}
+
+// Keys of different ids differ in dst_ip
+static void bench_key_fill(struct bench_key *key, uint32_t id) {
+  key->src_ip = (uint32_t)(id * 0x9e3779b97f4a7c15ULL >> 32);
+  key->dst_ip = id;
+  key->src_port = (uint16_t)(id >> 7);
+  key->dst_port = 80;
+  key->protocol = 6;
+}
+
+static inline uint64_t xorshift(uint64_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+static struct ConcurrentMap *map;
+// Slot n of the map's values holds the key slots[n]; ids go up to 2 * stored,
+// so that about half of the lookups hit
+static struct bench_key *slots;
+static unsigned stored;
+static unsigned burst = 32;
+static bool stop;
+
+struct reader_stats {
+  uint64_t lookups;
+  uint64_t hits;
+  uint64_t errors;
+  uint64_t cycles;
+} __rte_cache_aligned;
+
+static struct reader_stats reader_stats[RTE_MAX_LCORE];
+
+static int reader_main(void *arg) {
+  unsigned reader_id = (unsigned)(uintptr_t)arg;
+  struct reader_stats *stats = &reader_stats[reader_id];
+  if (!concurrent_map_reader_register(map, reader_id)) {
+    rte_exit(EXIT_FAILURE, "Cannot register reader %u\n", reader_id);
+  }
+
+  uint64_t rng = 0x2545f4914f6cdd1dULL * (reader_id + 1);
+  uint64_t begin = rte_rdtsc();
+  while (!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+    for (unsigned i = 0; i < burst; i++) {
+      uint32_t id = xorshift(&rng) % (2 * stored);
+      struct bench_key key;
+      bench_key_fill(&key, id);
+      int value;
+      if (concurrent_map_get(map, &key, &value)) {
+        // Until the next quiescent state, the key found cannot be recycled
+        stats->hits++;
+        stats->errors += slots[value].dst_ip != id;
+      }
+    }
+    stats->lookups += burst;
+    concurrent_map_quiescent(map, reader_id);
+  }
+  stats->cycles = rte_rdtsc() - begin;
+
+  concurrent_map_reader_unregister(map, reader_id);
+  return 0;
+}
+
+static unsigned parse_unsigned(const char *arg) {
+  char *end;
+  unsigned long value = strtoul(arg, &end, 10);
+  if (*arg == '\0' || *end != '\0' || value > UINT32_MAX) {
+    rte_exit(EXIT_FAILURE, "Invalid number: %s\n", arg);
+  }
+  return value;
+}
+
+int main(int argc, char **argv) {
+  int consumed = rte_eal_init(argc, argv);
+  if (consumed < 0) {
+    rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+  }
+  argc -= consumed;
+  argv += consumed;
+
+  unsigned capacity = 65536;
+  unsigned occupancy = 50;
+  unsigned batch = 64;
+  unsigned seconds = 5;
+
+  static const struct option options[] = {
+      {"capacity", required_argument, NULL, 'c'},
+      {"occupancy", required_argument, NULL, 'o'},
+      {"batch", required_argument, NULL, 'a'},
+      {"burst", required_argument, NULL, 'b'},
+      {"seconds", required_argument, NULL, 's'},
+      {NULL, 0, NULL, 0}};
+  int opt;
+  while ((opt = getopt_long(argc, argv, "", options, NULL)) != EOF) {
+    switch (opt) {
+      case 'c':
+        capacity = parse_unsigned(optarg);
+        break;
+      case 'o':
+        occupancy = parse_unsigned(optarg);
+        break;
+      case 'a':
+        batch = parse_unsigned(optarg);
+        break;
+      case 'b':
+        burst = parse_unsigned(optarg);
+        break;
+      case 's':
+        seconds = parse_unsigned(optarg);
+        break;
+      default:
+        rte_exit(EXIT_FAILURE, "Unknown option\n");
+    }
+  }
+  stored = (uint64_t)capacity * occupancy / 100;
+  if (stored == 0 || occupancy > 100 || batch == 0 || batch > stored ||
+      burst == 0 || seconds == 0) {
+    rte_exit(EXIT_FAILURE, "Invalid parameters\n");
+  }
+  unsigned readers = rte_lcore_count() - 1;
+  if (readers == 0) {
+    rte_exit(EXIT_FAILURE, "Needs at least 2 lcores\n");
+  }
+
+  if (!concurrent_map_allocate(bench_key_eq, bench_key_hash, capacity,
+                               readers, &map)) {
+    rte_exit(EXIT_FAILURE, "Cannot allocate a map of capacity %u\n",
+             capacity);
+  }
+  // in_map[id] is the slot of the key of that id, or -1
+  slots = vigor_malloc(sizeof(struct bench_key) * stored);
+  int *in_map = vigor_malloc(sizeof(int) * 2 * stored);
+  unsigned *recycled = vigor_malloc(sizeof(unsigned) * batch);
+  if (slots == NULL || in_map == NULL || recycled == NULL) {
+    rte_exit(EXIT_FAILURE, "Cannot allocate the keys\n");
+  }
+  for (unsigned id = 0; id < 2 * stored; id++) {
+    in_map[id] = -1;
+  }
+  for (unsigned slot = 0; slot < stored; slot++) {
+    bench_key_fill(&slots[slot], slot);
+    concurrent_map_put(map, &slots[slot], slot);
+    in_map[slot] = slot;
+  }
+
+  unsigned reader_id = 0;
+  unsigned lcore_id;
+  RTE_LCORE_FOREACH_SLAVE(lcore_id) {
+    rte_eal_remote_launch(reader_main, (void *)(uintptr_t)reader_id,
+                          lcore_id);
+    reader_id++;
+  }
+
+  // Every round erases a batch of random keys, waits for the readers, and
+  // recycles the memory of the erased keys for new ones
+  uint64_t rng = 0x9e3779b97f4a7c15ULL;
+  uint64_t updates = 0;
+  uint64_t begin = rte_rdtsc();
+  uint64_t end = begin + seconds * rte_get_tsc_hz();
+  while (rte_rdtsc() < end) {
+    for (unsigned n = 0; n < batch; n++) {
+      uint32_t id;
+      do {
+        id = xorshift(&rng) % (2 * stored);
+      } while (in_map[id] < 0);
+      void *trash;
+      concurrent_map_erase(map, &slots[in_map[id]], &trash);
+      recycled[n] = in_map[id];
+      in_map[id] = -1;
+    }
+    concurrent_map_synchronize(map);
+    for (unsigned n = 0; n < batch; n++) {
+      uint32_t id;
+      do {
+        id = xorshift(&rng) % (2 * stored);
+      } while (in_map[id] >= 0);
+      bench_key_fill(&slots[recycled[n]], id);
+      concurrent_map_put(map, &slots[recycled[n]], recycled[n]);
+      in_map[id] = recycled[n];
+    }
+    updates += batch;
+  }
+  uint64_t writer_cycles = rte_rdtsc() - begin;
+
+  __atomic_store_n(&stop, true, __ATOMIC_RELAXED);
+  rte_eal_mp_wait_lcore();
+
+  double hz = rte_get_tsc_hz();
+  uint64_t lookups = 0;
+  uint64_t hits = 0;
+  uint64_t errors = 0;
+  printf("Capacity %u, %u keys, %u readers, bursts of %u, batches of %u\n",
+         capacity, stored, readers, burst, batch);
+  for (unsigned id = 0; id < readers; id++) {
+    struct reader_stats *stats = &reader_stats[id];
+    printf("reader %2u  %8.2f Mlookups/s  %6.2f cycles/lookup\n", id,
+           stats->lookups / (stats->cycles / hz) / 1e6,
+           (double)stats->cycles / stats->lookups);
+    lookups += stats->lookups;
+    hits += stats->hits;
+    errors += stats->errors;
+  }
+  printf("readers    %8.2f Mlookups/s, %" PRIu64 " lookups, %" PRIu64
+         " hits\n",
+         lookups / (writer_cycles / hz) / 1e6, lookups, hits);
+  printf("writer     %8.2f Mupdates/s, %" PRIu64 " updates\n",
+         updates / (writer_cycles / hz) / 1e6, updates);
+
+  if (errors != 0) {
+    rte_exit(EXIT_FAILURE, "%" PRIu64 " lookups saw a recycled key\n",
+             errors);
+  }
+  return 0;
+}
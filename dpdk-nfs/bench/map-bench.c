@@ -0,0 +1,186 @@
+// Map micro-benchmark: looks up bursts of flow keys in a map, once key by key
+// with map_get and once with map_get_bulk, and reports cycles per lookup.
+// Query keys are copies, in a separate array, of keys picked at random, as
+// they would be when built from packet headers, so that lookups pay for the
+// cache misses of a large map like in an NF.
+//
+// Usage: map-bench <EAL args> -- [--capacity N] [--occupancy PERCENT]
+//                  [--hits PERCENT] [--burst N] [--bursts N]
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_eal.h>
+
+#include "lib/verified/map.h"
+#include "lib/verified/vigor-alloc.h"
+
+struct bench_key {
+  uint32_t src_ip;
+  uint32_t dst_ip;
+  uint16_t src_port;
+  uint16_t dst_port;
+  uint8_t protocol;
+};
+
+static unsigned bench_key_hash(void *obj) {
+  struct bench_key *key = obj;
+  unsigned hash = 0;
+  hash = __builtin_ia32_crc32si(hash, key->src_ip);
+  hash = __builtin_ia32_crc32si(hash, key->dst_ip);
+  hash = __builtin_ia32_crc32si(hash, key->src_port);
+  hash = __builtin_ia32_crc32si(hash, key->dst_port);
+  hash = __builtin_ia32_crc32si(hash, key->protocol);
+  return hash;
+}
+
+static bool bench_key_eq(void *a, void *b) {
+  struct bench_key *id1 = a;
+  struct bench_key *id2 = b;
+  return id1->src_ip == id2->src_ip && id1->dst_ip == id2->dst_ip &&
+         id1->src_port == id2->src_port && id1->dst_port == id2->dst_port &&
+         id1->protocol == id2->protocol;
+}
+
+static void bench_key_fill(struct bench_key *key, uint64_t seed) {
+  key->src_ip = (uint32_t)(seed * 0x9e3779b97f4a7c15ULL >> 32);
+  key->dst_ip = (uint32_t)seed;
+  key->src_port = (uint16_t)(seed >> 7);
+  key->dst_port = 80;
+  key->protocol = 6;
+}
+
+static unsigned parse_unsigned(const char *arg) {
+  char *end;
+  unsigned long value = strtoul(arg, &end, 10);
+  if (*arg == '\0' || *end != '\0' || value > UINT32_MAX) {
+    rte_exit(EXIT_FAILURE, "Invalid number: %s\n", arg);
+  }
+  return value;
+}
+
+int main(int argc, char **argv) {
+  int consumed = rte_eal_init(argc, argv);
+  if (consumed < 0) {
+    rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+  }
+  argc -= consumed;
+  argv += consumed;
+
+  unsigned capacity = 65536;
+  unsigned occupancy = 50;
+  unsigned hits = 90;
+  unsigned burst = 32;
+  unsigned bursts = 1 << 16;
+
+  static const struct option options[] = {
+      {"capacity", required_argument, NULL, 'c'},
+      {"occupancy", required_argument, NULL, 'o'},
+      {"hits", required_argument, NULL, 'h'},
+      {"burst", required_argument, NULL, 'b'},
+      {"bursts", required_argument, NULL, 'n'},
+      {NULL, 0, NULL, 0}};
+  int opt;
+  while ((opt = getopt_long(argc, argv, "", options, NULL)) != EOF) {
+    switch (opt) {
+      case 'c':
+        capacity = parse_unsigned(optarg);
+        break;
+      case 'o':
+        occupancy = parse_unsigned(optarg);
+        break;
+      case 'h':
+        hits = parse_unsigned(optarg);
+        break;
+      case 'b':
+        burst = parse_unsigned(optarg);
+        break;
+      case 'n':
+        bursts = parse_unsigned(optarg);
+        break;
+      default:
+        rte_exit(EXIT_FAILURE, "Unknown option\n");
+    }
+  }
+  if (occupancy == 0 || occupancy > 100 || hits > 100 || burst == 0 ||
+      burst > MAP_BULK_MAX || bursts == 0) {
+    rte_exit(EXIT_FAILURE, "Invalid parameters\n");
+  }
+
+  struct Map *map;
+  if (!map_allocate(bench_key_eq, bench_key_hash, capacity, &map)) {
+    rte_exit(EXIT_FAILURE, "Cannot allocate a map of capacity %u\n",
+             capacity);
+  }
+  unsigned stored = (uint64_t)capacity * occupancy / 100;
+  struct bench_key *keys = vigor_malloc(sizeof(struct bench_key) * stored);
+  if (keys == NULL) {
+    rte_exit(EXIT_FAILURE, "Cannot allocate the keys\n");
+  }
+  for (unsigned index = 0; index < stored; index++) {
+    bench_key_fill(&keys[index], index);
+    map_put(map, &keys[index], index);
+  }
+
+  // Misses are keys that were never stored
+  unsigned query_count = bursts * burst;
+  struct bench_key *queries =
+      vigor_malloc(sizeof(struct bench_key) * query_count);
+  if (queries == NULL) {
+    rte_exit(EXIT_FAILURE, "Cannot allocate the queries\n");
+  }
+  srand(42);
+  for (unsigned q = 0; q < query_count; q++) {
+    if ((unsigned)rand() % 100 < hits) {
+      queries[q] = keys[(unsigned)rand() % stored];
+    } else {
+      bench_key_fill(&queries[q], stored + (unsigned)rand());
+    }
+  }
+
+  void *burst_keys[MAP_BULK_MAX];
+  unsigned burst_hashes[MAP_BULK_MAX];
+  int burst_values[MAP_BULK_MAX];
+  uint64_t found_scalar = 0;
+  uint64_t found_bulk = 0;
+
+  uint64_t begin = rte_rdtsc();
+  for (unsigned q = 0; q < query_count; q += burst) {
+    for (unsigned i = 0; i < burst; i++) {
+      found_scalar += map_get(map, &queries[q + i], &burst_values[i]);
+    }
+  }
+  uint64_t scalar_cycles = rte_rdtsc() - begin;
+
+  begin = rte_rdtsc();
+  for (unsigned q = 0; q < query_count; q += burst) {
+    for (unsigned i = 0; i < burst; i++) {
+      burst_keys[i] = &queries[q + i];
+    }
+    uint64_t hit_mask;
+    found_bulk += map_get_bulk(map, burst_keys, burst_hashes, burst,
+                               burst_values, &hit_mask);
+  }
+  uint64_t bulk_cycles = rte_rdtsc() - begin;
+
+  if (found_scalar != found_bulk) {
+    rte_exit(EXIT_FAILURE,
+             "map_get found %" PRIu64 " keys, map_get_bulk %" PRIu64 "\n",
+             found_scalar, found_bulk);
+  }
+
+  printf("Capacity %u, %u keys, %u lookups in bursts of %u, %" PRIu64
+         " hits\n",
+         capacity, stored, query_count, burst, found_bulk);
+  printf("map_get      %8.2f cycles/lookup\n",
+         (double)scalar_cycles / query_count);
+  printf("map_get_bulk %8.2f cycles/lookup (%.2fx)\n",
+         (double)bulk_cycles / query_count,
+         (double)scalar_cycles / bulk_cycles);
+  return 0;
+}
@@ -0,0 +1,364 @@
+// NIC-less benchmark driver: links with an NF's nf_init/nf_process instead of
+// nf.c, preloads pcap traces into mbufs, and replays them through nf_process
+// in a tight loop on one lcore, reporting throughput, cycles per packet and
+// the fate of the packets.
+//
+// Usage: nf-bench <EAL args> -- <NF args> -- [--repeat N] --pcap DEV:FILE...
+// Packets of every trace enter the NF on the given device; traces are merged
+// by timestamp. NF time follows the trace timestamps, shifted to be
+// monotonic across repetitions, so runs are repeatable.
+// The NF configuration needs devices, use e.g. --vdev=net_null0 (see the
+// nf-bench target in the Makefile).
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_memcpy.h>
+
+#include "lib/verified/packet-io.h"
+#include "lib/verified/vigor-time.h"
+#include "nf-log.h"
+#include "nf-util.h"
+#include "nf.h"
+
+#ifdef VIGOR_EXPIRATION_BUDGET
+#include "lib/unverified/expirator.h"
+#endif  // VIGOR_EXPIRATION_BUDGET
+
+// NFs only rewrite headers; this much of every packet is restored before
+// each replay
+#define BENCH_RESTORED_BYTES 128
+
+#define BENCH_MAX_TRACES 16
+
+// Microsecond and nanosecond pcap magic numbers, as written by the capturer
+#define PCAP_MAGIC_US 0xa1b2c3d4
+#define PCAP_MAGIC_NS 0xa1b23c4d
+#define PCAP_LINKTYPE_ETHERNET 1
+
+struct pcap_file_header {
+  uint32_t magic;
+  uint16_t version_major;
+  uint16_t version_minor;
+  int32_t thiszone;
+  uint32_t sigfigs;
+  uint32_t snaplen;
+  uint32_t linktype;
+};
+
+struct pcap_record_header {
+  uint32_t ts_sec;
+  uint32_t ts_frac;  // micro- or nanoseconds, depending on the magic
+  uint32_t caplen;
+  uint32_t len;
+};
+
+struct trace {
+  uint16_t device;
+  const char *path;
+  uint8_t *data;  // whole file
+  size_t size;
+  bool swapped;
+  bool nanoseconds;
+};
+
+struct bench_packet {
+  vigor_time_t time;  // relative to the first packet
+  uint16_t device;
+  struct rte_mbuf *mbuf;
+  uint16_t data_off;
+  uint32_t length;
+  uint8_t headers[BENCH_RESTORED_BYTES];
+};
+
+// The driver runs a single NF instance
+unsigned nf_lcores_count(void) { return 1; }
+
+unsigned nf_lcore_index(void) { return 0; }
+
+static uint32_t pcap_u32(const struct trace *trace, uint32_t value) {
+  return trace->swapped ? __builtin_bswap32(value) : value;
+}
+
+static void trace_load(struct trace *trace) {
+  FILE *file = fopen(trace->path, "rb");
+  if (file == NULL) {
+    rte_exit(EXIT_FAILURE, "Cannot open %s\n", trace->path);
+  }
+  fseek(file, 0, SEEK_END);
+  trace->size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  trace->data = malloc(trace->size);
+  if (trace->data == NULL ||
+      fread(trace->data, 1, trace->size, file) != trace->size) {
+    rte_exit(EXIT_FAILURE, "Cannot read %s\n", trace->path);
+  }
+  fclose(file);
+
+  if (trace->size < sizeof(struct pcap_file_header)) {
+    rte_exit(EXIT_FAILURE, "%s is not a pcap file\n", trace->path);
+  }
+  struct pcap_file_header *header = (struct pcap_file_header *)trace->data;
+  uint32_t magic = header->magic;
+  trace->swapped = magic == __builtin_bswap32(PCAP_MAGIC_US) ||
+                   magic == __builtin_bswap32(PCAP_MAGIC_NS);
+  magic = pcap_u32(trace, magic);
+  if (magic != PCAP_MAGIC_US && magic != PCAP_MAGIC_NS) {
+    rte_exit(EXIT_FAILURE, "%s is not a pcap file\n", trace->path);
+  }
+  trace->nanoseconds = magic == PCAP_MAGIC_NS;
+  if (pcap_u32(trace, header->linktype) != PCAP_LINKTYPE_ETHERNET) {
+    rte_exit(EXIT_FAILURE, "%s is not an Ethernet capture\n", trace->path);
+  }
+}
+
+// Calls the function on every record of the trace, stops at a truncated one
+static void trace_for_each(struct trace *trace,
+                           void (*fn)(struct trace *trace, vigor_time_t time,
+                                      const uint8_t *packet, uint32_t length,
+                                      void *arg),
+                           void *arg) {
+  size_t offset = sizeof(struct pcap_file_header);
+  while (offset + sizeof(struct pcap_record_header) <= trace->size) {
+    struct pcap_record_header *record =
+        (struct pcap_record_header *)(trace->data + offset);
+    offset += sizeof(struct pcap_record_header);
+    uint32_t caplen = pcap_u32(trace, record->caplen);
+    if (offset + caplen > trace->size) {
+      NF_INFO("Warning: %s is truncated.", trace->path);
+      return;
+    }
+
+    vigor_time_t time =
+        pcap_u32(trace, record->ts_sec) * 1000000000LL +
+        pcap_u32(trace, record->ts_frac) * (trace->nanoseconds ? 1 : 1000);
+    fn(trace, time, trace->data + offset, caplen, arg);
+    offset += caplen;
+  }
+}
+
+struct trace_stats {
+  size_t packets;
+  uint32_t max_length;
+};
+
+static void count_packet(struct trace *trace, vigor_time_t time,
+                         const uint8_t *packet, uint32_t length, void *arg) {
+  struct trace_stats *stats = arg;
+  stats->packets++;
+  stats->max_length = RTE_MAX(stats->max_length, length);
+}
+
+struct trace_loader {
+  struct rte_mempool *pool;
+  struct bench_packet *packets;
+  size_t count;
+};
+
+static void load_packet(struct trace *trace, vigor_time_t time,
+                        const uint8_t *packet, uint32_t length, void *arg) {
+  struct trace_loader *loader = arg;
+  struct rte_mbuf *mbuf = rte_pktmbuf_alloc(loader->pool);
+  if (mbuf == NULL) {
+    rte_exit(EXIT_FAILURE, "Not enough mbufs for the traces\n");
+  }
+  rte_memcpy(rte_pktmbuf_append(mbuf, length), packet, length);
+  mbuf->port = trace->device;
+
+  struct bench_packet *bench_packet = &loader->packets[loader->count];
+  bench_packet->time = time;
+  bench_packet->device = trace->device;
+  bench_packet->mbuf = mbuf;
+  bench_packet->data_off = mbuf->data_off;
+  bench_packet->length = length;
+  memcpy(bench_packet->headers, packet,
+         RTE_MIN(length, (uint32_t)BENCH_RESTORED_BYTES));
+  loader->count++;
+}
+
+static int compare_packets(const void *a, const void *b) {
+  const struct bench_packet *pa = a;
+  const struct bench_packet *pb = b;
+  return (pa->time > pb->time) - (pa->time < pb->time);
+}
+
+// Undoes whatever the previous replay did to the packet
+static void packet_restore(struct bench_packet *packet) {
+  struct rte_mbuf *mbuf = packet->mbuf;
+  mbuf->data_off = packet->data_off;
+  mbuf->data_len = packet->length;
+  mbuf->pkt_len = packet->length;
+  rte_memcpy(rte_pktmbuf_mtod(mbuf, uint8_t *), packet->headers,
+             RTE_MIN(packet->length, (uint32_t)BENCH_RESTORED_BYTES));
+}
+
+static void usage(const char *program) {
+  rte_exit(EXIT_FAILURE,
+           "Usage: %s <EAL args> -- <NF args> -- [--repeat N] "
+           "--pcap DEVICE:FILE...\n",
+           program);
+}
+
+int main(int argc, char **argv) {
+  int ret = rte_eal_init(argc, argv);
+  if (ret < 0) {
+    rte_exit(EXIT_FAILURE, "Error with EAL initialization, ret=%d\n", ret);
+  }
+  argc -= ret;
+  argv += ret;
+
+  // Split the NF arguments from ours
+  int nf_argc = 1;
+  while (nf_argc < argc && strcmp(argv[nf_argc], "--") != 0) {
+    nf_argc++;
+  }
+
+  struct trace traces[BENCH_MAX_TRACES];
+  unsigned traces_count = 0;
+  unsigned repeat = 1;
+  for (int arg = nf_argc + 1; arg < argc; arg++) {
+    if (strcmp(argv[arg], "--repeat") == 0 && arg + 1 < argc) {
+      repeat = nf_util_parse_int(argv[++arg], "repeat", 10, '\0');
+    } else if (strcmp(argv[arg], "--pcap") == 0 && arg + 1 < argc &&
+               traces_count < BENCH_MAX_TRACES) {
+      char *spec = argv[++arg];
+      char *separator = strchr(spec, ':');
+      if (separator == NULL) {
+        usage(argv[0]);
+      }
+      traces[traces_count].device =
+          nf_util_parse_int(spec, "pcap device", 10, ':');
+      traces[traces_count].path = separator + 1;
+      traces_count++;
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (traces_count == 0 || repeat == 0) {
+    usage(argv[0]);
+  }
+
+  nf_config_init(nf_argc, argv);
+  nf_config_print();
+  vigor_time_init();
+
+  uint16_t nb_devices = rte_eth_dev_count_avail();
+  struct trace_stats stats = {0};
+  for (unsigned t = 0; t < traces_count; t++) {
+    if (traces[t].device >= nb_devices) {
+      rte_exit(EXIT_FAILURE, "Device %" PRIu16 " of %s does not exist\n",
+               traces[t].device, traces[t].path);
+    }
+    trace_load(&traces[t]);
+    trace_for_each(&traces[t], count_packet, &stats);
+  }
+  if (stats.packets == 0) {
+    rte_exit(EXIT_FAILURE, "The traces contain no packets\n");
+  }
+  if (stats.max_length + RTE_PKTMBUF_HEADROOM > UINT16_MAX) {
+    rte_exit(EXIT_FAILURE, "Packets of %" PRIu32 " bytes do not fit in mbufs\n",
+             stats.max_length);
+  }
+
+  struct trace_loader loader = {
+      .pool = rte_pktmbuf_pool_create(
+          "BENCH_POOL", stats.packets, 0, 0,
+          RTE_MAX(stats.max_length + RTE_PKTMBUF_HEADROOM,
+                  (uint32_t)RTE_MBUF_DEFAULT_BUF_SIZE),
+          rte_socket_id()),
+      .packets = malloc(stats.packets * sizeof(struct bench_packet)),
+      .count = 0,
+  };
+  if (loader.pool == NULL || loader.packets == NULL) {
+    rte_exit(EXIT_FAILURE, "Cannot allocate %zu packets: %s\n", stats.packets,
+             rte_strerror(rte_errno));
+  }
+  for (unsigned t = 0; t < traces_count; t++) {
+    trace_for_each(&traces[t], load_packet, &loader);
+    free(traces[t].data);
+  }
+  struct bench_packet *packets = loader.packets;
+  size_t count = loader.count;
+  qsort(packets, count, sizeof(struct bench_packet), compare_packets);
+
+  // Each repetition starts one average inter-packet gap after the previous
+  vigor_time_t first_time = packets[0].time;
+  vigor_time_t duration = packets[count - 1].time - first_time;
+  vigor_time_t period = duration + duration / count + 1;
+  for (size_t n = 0; n < count; n++) {
+    packets[n].time -= first_time;
+  }
+
+#ifdef VIGOR_RSS_HASH
+  // Trace packets carry no RSS hash, flows are hashed in software
+  rss_hash_init();
+#endif  // VIGOR_RSS_HASH
+
+  if (!nf_init()) {
+    rte_exit(EXIT_FAILURE, "Error initializing NF");
+  }
+
+  NF_INFO("Replaying %zu packets %u times.", count, repeat);
+
+  uint64_t forwarded = 0;
+  uint64_t dropped = 0;
+  uint64_t flooded = 0;
+  uint64_t nf_cycles = 0;
+  vigor_time_t start_time = current_time();
+  uint64_t start_cycles = rte_rdtsc();
+  for (unsigned r = 0; r < repeat; r++) {
+    vigor_time_t offset = start_time + r * period;
+    for (size_t n = 0; n < count; n++) {
+      struct bench_packet *packet = &packets[n];
+      packet_restore(packet);
+      vigor_time_t now = offset + packet->time;
+
+      uint64_t begin = rte_rdtsc();
+#ifdef VIGOR_EXPIRATION_BUDGET
+      expirator_run(now, VIGOR_EXPIRATION_BUDGET);
+#endif  // VIGOR_EXPIRATION_BUDGET
+      uint8_t *data = rte_pktmbuf_mtod(packet->mbuf, uint8_t *);
+      packet_state_total_length(data, &(packet->mbuf->pkt_len));
+      packet_state_mbuf(packet->mbuf);
+      uint16_t dst_device = nf_process(packet->device, &data,
+                                       packet->mbuf->pkt_len, now,
+                                       packet->mbuf);
+      nf_return_all_chunks(data);
+      nf_cycles += rte_rdtsc() - begin;
+
+      if (dst_device == FLOOD_FRAME) {
+        flooded++;
+      } else if (dst_device == packet->device || dst_device >= nb_devices) {
+        dropped++;
+      } else {
+        forwarded++;
+      }
+    }
+  }
+  uint64_t total_cycles = rte_rdtsc() - start_cycles;
+
+  uint64_t total = (uint64_t)count * repeat;
+  double hz = rte_get_tsc_hz();
+  printf("Packets:         %" PRIu64 "\n", total);
+  printf("NF throughput:   %.3f Mpps\n", total / (nf_cycles / hz) / 1e6);
+  printf("NF cycles/pkt:   %.1f\n", (double)nf_cycles / total);
+  printf("Loop throughput: %.3f Mpps (including packet restoring)\n",
+         total / (total_cycles / hz) / 1e6);
+  printf("Forwarded:       %" PRIu64 " (%.2f%%)\n", forwarded,
+         100.0 * forwarded / total);
+  printf("Dropped:         %" PRIu64 " (%.2f%%)\n", dropped,
+         100.0 * dropped / total);
+  printf("Flooded:         %" PRIu64 " (%.2f%%)\n", flooded,
+         100.0 * flooded / total);
+
+  return 0;
+}
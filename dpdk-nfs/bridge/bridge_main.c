@@ -14,7 +14,11 @@
 #include "lib/verified/map.h"
 #include "lib/verified/vector.h"
 #include "lib/verified/expirator.h"
+#ifdef VIGOR_EXPIRATION_BUDGET
+#include "lib/unverified/expirator.h"
+#endif  // VIGOR_EXPIRATION_BUDGET
 #include "lib/verified/ether.h"
+#include "lib/unverified/ether-map.h"
 
 #include "nf.h"
 #include "nf-util.h"
@@ -44,7 +48,7 @@ int bridge_get_device(struct rte_ether_addr *dst, uint16_t src_device) {
 
   int index = -1;
   int device = -1;
-  int present = map_get(mac_tables->dyn_map, dst, &index);
+  int present = rte_ether_addr_map_get(mac_tables->dyn_map, dst, &index);
   if (present) {
     struct DynamicValue *value = 0;
     vector_borrow(mac_tables->dyn_vals, index, (void **)&value);
@@ -58,7 +62,7 @@ int bridge_get_device(struct rte_ether_addr *dst, uint16_t src_device) {
 void bridge_put_update_entry(struct rte_ether_addr *src, uint16_t src_device,
                              vigor_time_t time) {
   int index = -1;
-  int present = map_get(mac_tables->dyn_map, src, &index);
+  int present = rte_ether_addr_map_get(mac_tables->dyn_map, src, &index);
   if (present) {
     dchain_rejuvenate_index(mac_tables->dyn_heap, index, time);
   } else {
@@ -74,7 +78,7 @@ void bridge_put_update_entry(struct rte_ether_addr *src, uint16_t src_device,
     vector_borrow(mac_tables->dyn_vals, index, (void **)&value);
     memcpy(key, src, sizeof(struct rte_ether_addr));
     value->device = src_device;
-    map_put(mac_tables->dyn_map, key, index);
+    rte_ether_addr_map_put(mac_tables->dyn_map, key, index);
     // the other half of the key is in the map
     vector_return(mac_tables->dyn_keys, index, key);
     vector_return(mac_tables->dyn_vals, index, value);
@@ -90,6 +94,16 @@ bool nf_init(void) {
   if (mac_tables == NULL) {
     return false;
   }
+
+#ifdef VIGOR_EXPIRATION_BUDGET
+  // Entries are expired by the runtime instead of bridge_expire_entries
+  vigor_time_t vigor_time_expiration = (vigor_time_t)config.expiration_time;
+  if (!expirator_register(mac_tables->dyn_heap, mac_tables->dyn_keys,
+                          mac_tables->dyn_map,
+                          vigor_time_expiration * 1000)) {  // us to ns
+    return false;
+  }
+#endif  // VIGOR_EXPIRATION_BUDGET
   return true;
 }
 
@@ -97,7 +111,9 @@ int nf_process(uint16_t device, uint8_t **buffer, uint16_t packet_length,
                vigor_time_t now, struct rte_mbuf *mbuf) {
   struct rte_ether_hdr *rte_ether_header = nf_then_get_rte_ether_header(buffer);
 
+#ifndef VIGOR_EXPIRATION_BUDGET
   bridge_expire_entries(now);
+#endif  // VIGOR_EXPIRATION_BUDGET
   bridge_put_update_entry(&rte_ether_header->s_addr, device, now);
 
   int forward_to = bridge_get_device(&rte_ether_header->d_addr, device);
@@ -138,7 +138,8 @@ void nf_config_usage(void) {
       "\t--max-flows <max-flows>: maximum number of flows,"
       " default: %" PRIu32
       ".\n"
-      "\t--capacity <capacity>: size of the clients\' sketch,"
+      "\t--capacity <capacity>: buckets per row of the clients\' sketch,"
+      " rounded up to a power of 2,"
       " default: %" PRIu32
       ".\n"
       "\t--max-clients <max-clients>: maximum allowed number of clients,"
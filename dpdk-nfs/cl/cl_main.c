@@ -23,22 +23,37 @@ bool nf_init(void) {
   uint32_t dev_count = rte_eth_dev_count_avail();
 
   state = alloc_state(max_flows, sketch_capacity, max_clients, dev_count);
+  if (state == NULL) {
+    return false;
+  }
+
+#ifdef VIGOR_EXPIRATION_BUDGET
+  // Flows are expired by the runtime instead of expire_entries
+  uint64_t flow_expiration_time_ns =
+      ((uint64_t)config.flow_expiration_time) * 1000;  // us to ns
+  if (!expirator_register(state->flow_allocator, state->flows_keys,
+                          state->flows, flow_expiration_time_ns)) {
+    return false;
+  }
+#endif  // VIGOR_EXPIRATION_BUDGET
 
-  return state != NULL;
+  return true;
 }
 
 void expire_entries(vigor_time_t time) {
   assert(time >= 0);  // we don't support the past
   assert(sizeof(vigor_time_t) <= sizeof(uint64_t));
   uint64_t time_u = (uint64_t)time;  // OK because of the two asserts
-  uint64_t flow_expiration_time_ns =
-      ((uint64_t)config.flow_expiration_time) * 1000;  // us to ns
   uint64_t client_expiration_time_ns =
       ((uint64_t)config.client_expiration_time) * 1000;  // us to ns
-  vigor_time_t flow_last_time = time_u - flow_expiration_time_ns;
   vigor_time_t client_last_time = time_u - client_expiration_time_ns;
+#ifndef VIGOR_EXPIRATION_BUDGET
+  uint64_t flow_expiration_time_ns =
+      ((uint64_t)config.flow_expiration_time) * 1000;  // us to ns
+  vigor_time_t flow_last_time = time_u - flow_expiration_time_ns;
   expire_items_single_map(state->flow_allocator, state->flows_keys,
                           state->flows, flow_last_time);
+#endif  // VIGOR_EXPIRATION_BUDGET
   sketch_expire(state->sketch, client_last_time);
 }
 
@@ -4,6 +4,7 @@
 #include <assert.h>
 
 #include "lib/verified/boilerplate-util.h"
+#include "lib/verified/vigor-alloc.h"
 #ifdef KLEE_VERIFICATION
 #include "lib/models/verified/double-chain-control.h"
 #include "lib/models/verified/ether.h"
@@ -19,7 +20,7 @@ struct State *alloc_state(uint32_t max_flows, uint32_t sketch_capacity,
                           uint16_t max_clients, uint32_t dev_count) {
   if (allocated_nf_state != NULL) return allocated_nf_state;
 
-  struct State *ret = malloc(sizeof(struct State));
+  struct State *ret = vigor_malloc(sizeof(struct State));
 
   if (ret == NULL) return NULL;
 
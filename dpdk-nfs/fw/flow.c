@@ -2,6 +2,10 @@
 
 #include <stdint.h>
 
+#ifdef VIGOR_RSS_HASH
+#include "lib/unverified/rss-hash.h"
+#endif  // VIGOR_RSS_HASH
+
 bool FlowId_eq(void* a, void* b) {
   struct FlowId* id1 = (struct FlowId*)a;
   struct FlowId* id2 = (struct FlowId*)b;
@@ -52,6 +56,11 @@ unsigned FlowId_hash(void* obj) {
 unsigned FlowId_hash(void* obj) {
   struct FlowId* id = (struct FlowId*)obj;
 
+#ifdef VIGOR_RSS_HASH
+  // The hash the NICs compute for the flow's packets, see nf_rss_hash
+  return rss_hash_ipv4_tcpudp(id->src_ip, id->dst_ip, id->src_port,
+                              id->dst_port);
+#else   // VIGOR_RSS_HASH
   unsigned hash = 0;
   hash = __builtin_ia32_crc32si(hash, id->src_port);
   hash = __builtin_ia32_crc32si(hash, id->dst_port);
@@ -59,6 +68,9 @@ unsigned FlowId_hash(void* obj) {
   hash = __builtin_ia32_crc32si(hash, id->dst_ip);
   hash = __builtin_ia32_crc32si(hash, id->protocol);
   return hash;
+#endif  // VIGOR_RSS_HASH
 }
 
+MAP_SPECIALIZE_DEFINE(FlowId, struct FlowId, FlowId_hash, FlowId_eq)
+
 #endif  // KLEE_VERIFICATION
@@ -6,6 +6,7 @@
 
 #include "lib/verified/boilerplate-util.h"
 #include "lib/verified/ether.h"
+#include "lib/unverified/map-specialize.h"
 
 struct FlowId {
   uint16_t src_port;
@@ -31,6 +32,8 @@ void FlowId_allocate(void* obj);
   p("protocol: %d", (obj)->protocol); \
   p("}");
 
+MAP_SPECIALIZE_DECLARE(FlowId, struct FlowId)
+
 #ifdef KLEE_VERIFICATION
 #include <klee/klee.h>
 #include "lib/models/str-descr.h"
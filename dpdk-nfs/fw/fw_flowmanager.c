@@ -9,6 +9,9 @@
 #include "lib/verified/map.h"
 #include "lib/verified/vector.h"
 #include "lib/verified/expirator.h"
+#ifdef VIGOR_EXPIRATION_BUDGET
+#include "lib/unverified/expirator.h"
+#endif  // VIGOR_EXPIRATION_BUDGET
 
 #include "state.h"
 
@@ -32,6 +35,16 @@ struct FlowManager *flow_manager_allocate(uint16_t fw_device,
 
   manager->expiration_time = expiration_time;
 
+#ifdef VIGOR_EXPIRATION_BUDGET
+  // Flows are expired by the runtime instead of flow_manager_expire
+  if (!expirator_register(manager->state->heap, manager->state->fv,
+                          manager->state->fm,
+                          (vigor_time_t)manager->expiration_time *
+                              1000)) {  // us to ns
+    return NULL;
+  }
+#endif  // VIGOR_EXPIRATION_BUDGET
+
   return manager;
 }
 
@@ -40,7 +53,7 @@ void flow_manager_allocate_or_refresh_flow(struct FlowManager *manager,
                                            uint32_t internal_device,
                                            vigor_time_t time) {
   int index;
-  if (map_get(manager->state->fm, id, &index)) {
+  if (FlowId_map_get(manager->state->fm, id, &index)) {
     dchain_rejuvenate_index(manager->state->heap, index, time);
     return;
   }
@@ -53,7 +66,7 @@ void flow_manager_allocate_or_refresh_flow(struct FlowManager *manager,
   struct FlowId *key = 0;
   vector_borrow(manager->state->fv, index, (void **)&key);
   memcpy((void *)key, (void *)id, sizeof(struct FlowId));
-  map_put(manager->state->fm, key, index);
+  FlowId_map_put(manager->state->fm, key, index);
   vector_return(manager->state->fv, index, key);
   uint32_t *int_dev;
   vector_borrow(manager->state->int_devices, index, (void **)&int_dev);
@@ -75,7 +88,47 @@ bool flow_manager_get_refresh_flow(struct FlowManager *manager,
                                    struct FlowId *id, vigor_time_t time,
                                    uint32_t *internal_device) {
   int index;
-  if (map_get(manager->state->fm, id, &index) == 0) {
+  if (FlowId_map_get(manager->state->fm, id, &index) == 0) {
+    return false;
+  }
+  uint32_t *int_dev;
+  vector_borrow(manager->state->int_devices, index, (void **)&int_dev);
+  *internal_device = *int_dev;
+  vector_return(manager->state->int_devices, index, int_dev);
+  dchain_rejuvenate_index(manager->state->heap, index, time);
+  return true;
+}
+
+#ifdef FW_FLOW_HASH_KNOWN
+void flow_manager_allocate_or_refresh_flow_with_hash(
+    struct FlowManager *manager, struct FlowId *id, unsigned hash,
+    uint32_t internal_device, vigor_time_t time) {
+  int index;
+  if (FlowId_map_get_with_hash(manager->state->fm, id, hash, &index)) {
+    dchain_rejuvenate_index(manager->state->heap, index, time);
+    return;
+  }
+  if (!dchain_allocate_new_index(manager->state->heap, &index, time)) {
+    return;
+  }
+
+  struct FlowId *key = 0;
+  vector_borrow(manager->state->fv, index, (void **)&key);
+  memcpy((void *)key, (void *)id, sizeof(struct FlowId));
+  FlowId_map_put_with_hash(manager->state->fm, key, hash, index);
+  vector_return(manager->state->fv, index, key);
+  uint32_t *int_dev;
+  vector_borrow(manager->state->int_devices, index, (void **)&int_dev);
+  *int_dev = internal_device;
+  vector_return(manager->state->int_devices, index, int_dev);
+}
+
+bool flow_manager_get_refresh_flow_with_hash(struct FlowManager *manager,
+                                             struct FlowId *id, unsigned hash,
+                                             vigor_time_t time,
+                                             uint32_t *internal_device) {
+  int index;
+  if (FlowId_map_get_with_hash(manager->state->fm, id, hash, &index) == 0) {
     return false;
   }
   uint32_t *int_dev;
@@ -85,3 +138,15 @@ bool flow_manager_get_refresh_flow(struct FlowManager *manager,
   dchain_rejuvenate_index(manager->state->heap, index, time);
   return true;
 }
+#endif  // FW_FLOW_HASH_KNOWN
+
+#ifdef VIGOR_PREFETCH_DISTANCE
+unsigned flow_manager_prefetch(struct FlowManager *manager, struct FlowId *id) {
+  return map_prefetch(manager->state->fm, id);
+}
+
+void flow_manager_prefetch_with_hash(struct FlowManager *manager,
+                                     unsigned hash) {
+  map_prefetch_with_hash(manager->state->fm, hash);
+}
+#endif  // VIGOR_PREFETCH_DISTANCE
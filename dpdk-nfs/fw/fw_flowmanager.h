@@ -22,4 +22,27 @@ bool flow_manager_get_refresh_flow(struct FlowManager *manager,
                                    struct FlowId *id, vigor_time_t time,
                                    uint32_t *internal_device);
 
+#if defined(VIGOR_RSS_HASH) || defined(VIGOR_PREFETCH_DISTANCE)
+// The FlowId_hash of a packet's flow can be known before its lookup, from the
+// NIC or from nf_prefetch
+#define FW_FLOW_HASH_KNOWN
+
+// Same as above, with the FlowId_hash of the flow already known
+void flow_manager_allocate_or_refresh_flow_with_hash(
+    struct FlowManager *manager, struct FlowId *id, unsigned hash,
+    uint32_t internal_device, vigor_time_t time);
+bool flow_manager_get_refresh_flow_with_hash(struct FlowManager *manager,
+                                             struct FlowId *id, unsigned hash,
+                                             vigor_time_t time,
+                                             uint32_t *internal_device);
+#endif  // FW_FLOW_HASH_KNOWN
+
+#ifdef VIGOR_PREFETCH_DISTANCE
+// Prefetches what a later lookup of the flow will need, returns its hash
+unsigned flow_manager_prefetch(struct FlowManager *manager, struct FlowId *id);
+// Same as above, with the FlowId_hash of the flow already known
+void flow_manager_prefetch_with_hash(struct FlowManager *manager,
+                                     unsigned hash);
+#endif  // VIGOR_PREFETCH_DISTANCE
+
 #endif  //_FLOWMANAGER_H_INCLUDED_
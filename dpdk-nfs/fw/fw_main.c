@@ -9,20 +9,93 @@
 
 struct nf_config config;
 
-struct FlowManager *flow_manager;
+VIGOR_PER_LCORE struct FlowManager *flow_manager;
 
 bool nf_init(void) {
+#ifdef VIGOR_RSS_HASH
+  // More flows than hashes would make long probe chains in the flow table
+  if (config.max_flows > RSS_HASH_DISTINCT_VALUES) {
+    NF_INFO("RSS_HASH yields only %d distinct flow hashes, too few for %" PRIu32
+            " flows; build without RSS_HASH=true for larger tables.",
+            RSS_HASH_DISTINCT_VALUES, config.max_flows);
+    return false;
+  }
+#endif  // VIGOR_RSS_HASH
   flow_manager = flow_manager_allocate(
       config.wan_device, config.expiration_time, config.max_flows);
   return flow_manager != NULL;
 }
 
+#ifdef VIGOR_PREFETCH_DISTANCE
+bool nf_prefetch(uint16_t device, uint8_t *packet, uint16_t packet_length,
+                 struct rte_mbuf *mbuf, unsigned *hash) {
+  struct rte_ipv4_hdr *rte_ipv4_header;
+  struct tcpudp_hdr *tcpudp_header;
+  if (!nf_peek_rte_ipv4_tcpudp_headers(packet, packet_length, &rte_ipv4_header,
+                                       &tcpudp_header)) {
+    return false;
+  }
+
+#ifdef VIGOR_RSS_HASH
+  // Symmetric, so the same for the flow and its reply
+  *hash = nf_rss_hash(mbuf, rte_ipv4_header, tcpudp_header);
+  flow_manager_prefetch_with_hash(flow_manager, *hash);
+  return true;
+#else   // VIGOR_RSS_HASH
+  // Same flow as nf_process looks up
+  struct FlowId id;
+  if (device == config.wan_device) {
+    id = (struct FlowId){
+        .src_port = tcpudp_header->dst_port,
+        .dst_port = tcpudp_header->src_port,
+        .src_ip = rte_ipv4_header->dst_addr,
+        .dst_ip = rte_ipv4_header->src_addr,
+        .protocol = rte_ipv4_header->next_proto_id,
+    };
+  } else {
+    id = (struct FlowId){
+        .src_port = tcpudp_header->src_port,
+        .dst_port = tcpudp_header->dst_port,
+        .src_ip = rte_ipv4_header->src_addr,
+        .dst_ip = rte_ipv4_header->dst_addr,
+        .protocol = rte_ipv4_header->next_proto_id,
+    };
+  }
+  *hash = flow_manager_prefetch(flow_manager, &id);
+  return true;
+#endif  // VIGOR_RSS_HASH
+}
+#endif  // VIGOR_PREFETCH_DISTANCE
+
+#ifdef FW_FLOW_HASH_KNOWN
+// The FlowId_hash of the packet's flow, without hashing the id again if
+// nf_prefetch or the NIC already did
+static unsigned fw_flow_hash(struct FlowId *id, struct rte_mbuf *mbuf,
+                             struct rte_ipv4_hdr *rte_ipv4_header,
+                             struct tcpudp_hdr *tcpudp_header) {
+#ifdef VIGOR_PREFETCH_DISTANCE
+  unsigned hash;
+  if (nf_prefetched_hash(&hash)) {
+    return hash;
+  }
+#endif  // VIGOR_PREFETCH_DISTANCE
+#ifdef VIGOR_RSS_HASH
+  // The hash is symmetric, so the packet's is also that of the reply flow
+  return nf_rss_hash(mbuf, rte_ipv4_header, tcpudp_header);
+#else   // VIGOR_RSS_HASH
+  return FlowId_hash(id);
+#endif  // VIGOR_RSS_HASH
+}
+#endif  // FW_FLOW_HASH_KNOWN
+
 int nf_process(uint16_t device, uint8_t **buffer, uint16_t packet_length,
                vigor_time_t now, struct rte_mbuf *mbuf) {
   NF_DEBUG("It is %" PRId64, now);
 
+#ifndef VIGOR_EXPIRATION_BUDGET
   flow_manager_expire(flow_manager, now);
   NF_DEBUG("Flows have been expired");
+#endif  // VIGOR_EXPIRATION_BUDGET
 
   struct rte_ether_hdr *rte_ether_header = nf_then_get_rte_ether_header(buffer);
   struct rte_ipv4_hdr *rte_ipv4_header =
@@ -57,8 +130,15 @@ int nf_process(uint16_t device, uint8_t **buffer, uint16_t packet_length,
     };
 
     uint32_t dst_device_long;
+#ifdef FW_FLOW_HASH_KNOWN
+    if (!flow_manager_get_refresh_flow_with_hash(
+            flow_manager, &id,
+            fw_flow_hash(&id, mbuf, rte_ipv4_header, tcpudp_header), now,
+            &dst_device_long)) {
+#else   // FW_FLOW_HASH_KNOWN
     if (!flow_manager_get_refresh_flow(flow_manager, &id, now,
                                        &dst_device_long)) {
+#endif  // FW_FLOW_HASH_KNOWN
       NF_DEBUG("Unknown external flow, dropping");
       return device;
     }
@@ -71,7 +151,13 @@ int nf_process(uint16_t device, uint8_t **buffer, uint16_t packet_length,
         .dst_ip = rte_ipv4_header->dst_addr,
         .protocol = rte_ipv4_header->next_proto_id,
     };
+#ifdef FW_FLOW_HASH_KNOWN
+    flow_manager_allocate_or_refresh_flow_with_hash(
+        flow_manager, &id,
+        fw_flow_hash(&id, mbuf, rte_ipv4_header, tcpudp_header), device, now);
+#else   // FW_FLOW_HASH_KNOWN
     flow_manager_allocate_or_refresh_flow(flow_manager, &id, device, now);
+#endif  // FW_FLOW_HASH_KNOWN
     dst_device = config.wan_device;
   }
 
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 
 #include "lib/verified/boilerplate-util.h"
+#include "lib/verified/vigor-alloc.h"
 
 #ifdef KLEE_VERIFICATION
 #include "lib/models/verified/double-chain-control.h"
@@ -11,7 +12,7 @@
 #include "lib/models/verified/lpm-dir-24-8-control.h"
 #endif  // KLEE_VERIFICATION
 
-struct State* allocated_nf_state = NULL;
+VIGOR_PER_LCORE struct State* allocated_nf_state = NULL;
 
 bool int_dev_bounds(void* value, int index, void* state) {
   uint32_t v = *(uint32_t*)value;
@@ -20,7 +21,7 @@ bool int_dev_bounds(void* value, int index, void* state) {
 
 struct State* alloc_state(int max_flows, uint32_t fw_device) {
   if (allocated_nf_state != NULL) return allocated_nf_state;
-  struct State* ret = malloc(sizeof(struct State));
+  struct State* ret = vigor_malloc(sizeof(struct State));
   if (ret == NULL) return NULL;
   ret->fm = NULL;
   if (map_allocate(FlowId_eq, FlowId_hash, max_flows, &(ret->fm)) == 0)
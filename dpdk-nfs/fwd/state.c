@@ -12,7 +12,7 @@
 #include "lib/models/verified/lpm-dir-24-8-control.h"
 #endif  // KLEE_VERIFICATION
 
-struct State* allocated_nf_state = NULL;
+VIGOR_PER_LCORE struct State* allocated_nf_state = NULL;
 
 struct State* alloc_state() {
   return NULL;
@@ -93,9 +93,10 @@ void fill_table_from_file(struct State *state, struct nf_config *config) {
       goto finally;
     }
 
-    struct Flow *flow = 0;
-
-    vector_borrow(state->entries, n_entries, (void **)&flow);
+    // Every field of the key is set below; struct Flow has no padding
+    // before proto, and INLINE_MAP_KEY_SIZE leaves out the one after it
+    struct Flow parsed;
+    struct Flow *flow = &parsed;
 
     if (!nf_parse_device(device, &flow->device)) {
       NF_INFO("Invalid device: %s, skip", device);
@@ -130,8 +131,7 @@ void fill_table_from_file(struct State *state, struct nf_config *config) {
       continue;
     }
 
-    map_put(state->table, flow, n_entries);
-    vector_return(state->entries, n_entries, flow);
+    inline_map_put(state->table, flow, n_entries);
 
     n_entries++;
 
@@ -22,7 +22,11 @@ bool nf_init() {
 
 bool is_flow_allowed(struct Flow *flow) {
   int index;
+#ifdef KLEE_VERIFICATION
   return map_get(state->table, flow, &index);
+#else   // KLEE_VERIFICATION
+  return inline_map_get(state->table, flow, &index);
+#endif  // KLEE_VERIFICATION
 }
 
 int nf_process(uint16_t device, uint8_t **buffer, uint16_t packet_length,
@@ -3,6 +3,7 @@
 #include "lib/verified/boilerplate-util.h"
 
 #include <stdlib.h>
+#include "lib/verified/vigor-alloc.h"
 
 #ifdef KLEE_VERIFICATION
 #include "lib/models/verified/map-control.h"
@@ -16,13 +17,14 @@ struct State *alloc_state(uint32_t capacity) {
     return allocated_nf_state;
   }
 
-  struct State *ret = malloc(sizeof(struct State));
+  struct State *ret = vigor_malloc(sizeof(struct State));
 
   if (ret == NULL) {
     return NULL;
   }
 
   ret->table = NULL;
+#ifdef KLEE_VERIFICATION
   if (map_allocate(flow_eq, flow_hash, capacity, &(ret->table)) == 0) {
     return NULL;
   }
@@ -33,13 +35,17 @@ struct State *alloc_state(uint32_t capacity) {
     return NULL;
   }
 
-#ifdef KLEE_VERIFICATION
   map_set_layout(ret->table, flow_descrs,
                  sizeof(flow_descrs) / sizeof(flow_descrs[0]), flow_nests,
                  sizeof(flow_nests) / sizeof(flow_nests[0]), "Flow");
   vector_set_layout(ret->entries, flow_descrs,
                     sizeof(flow_descrs) / sizeof(flow_descrs[0]), flow_nests,
                     sizeof(flow_nests) / sizeof(flow_nests[0]), "Flow");
+#else   // KLEE_VERIFICATION
+  if (inline_map_allocate(INLINE_MAP_KEY_SIZE(struct Flow, proto), capacity,
+                          &(ret->table)) == 0) {
+    return NULL;
+  }
 #endif  // KLEE_VERIFICATION
 
   allocated_nf_state = ret;
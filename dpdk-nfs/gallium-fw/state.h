@@ -4,9 +4,19 @@
 #include "loop.h"
 #include "flow.h"
 
+#ifndef KLEE_VERIFICATION
+#include "lib/unverified/inline-map.h"
+#endif  // KLEE_VERIFICATION
+
+// At runtime, the rules live in an inline-key map, which keeps its own copy
+// of every flow; symbex has no model for it, so it sees a map and a vector.
 struct State {
+#ifdef KLEE_VERIFICATION
   struct Map *table;
   struct Vector *entries;
+#else   // KLEE_VERIFICATION
+  struct InlineMap *table;
+#endif  // KLEE_VERIFICATION
 };
 
 struct State *alloc_state(uint32_t capacity);
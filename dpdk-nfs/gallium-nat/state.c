@@ -3,6 +3,7 @@
 #include <stdlib.h>
 
 #include "lib/verified/boilerplate-util.h"
+#include "lib/verified/vigor-alloc.h"
 
 #ifdef KLEE_VERIFICATION
 #include "lib/models/verified/map-control.h"
@@ -16,7 +17,7 @@ struct State *alloc_state(int max_flows, uint32_t ext_ip) {
     return allocated_nf_state;
   }
 
-  struct State *ret = malloc(sizeof(struct State));
+  struct State *ret = vigor_malloc(sizeof(struct State));
 
   if (ret == NULL) {
     return NULL;
@@ -3,6 +3,7 @@
 #include "lib/verified/boilerplate-util.h"
 
 #include <stdlib.h>
+#include "lib/verified/vigor-alloc.h"
 
 #ifdef KLEE_VERIFICATION
 #include "lib/models/verified/map-control.h"
@@ -16,7 +17,7 @@ struct State *alloc_state(uint32_t capacity) {
     return allocated_nf_state;
   }
 
-  struct State *ret = malloc(sizeof(struct State));
+  struct State *ret = vigor_malloc(sizeof(struct State));
 
   if (ret == NULL) {
     return NULL;
@@ -4,6 +4,9 @@
 #include <rte_byteorder.h>
 
 #include "lib/verified/expirator.h"
+#ifdef VIGOR_EXPIRATION_BUDGET
+#include "lib/unverified/expirator.h"
+#endif  // VIGOR_EXPIRATION_BUDGET
 
 #include "nf.h"
 #include "nf-log.h"
@@ -28,8 +31,24 @@ bool nf_init(void) {
 
   state =
       alloc_state(link_capacity, threshold, subnets_mask, capacity, dev_count);
+  if (state == NULL) {
+    return false;
+  }
 
-  return state != NULL;
+#ifdef VIGOR_EXPIRATION_BUDGET
+  // Subnets are expired by the runtime instead of expire_entries, which
+  // would otherwise sweep every subnet table on every packet
+  vigor_time_t exp_time =
+      VIGOR_TIME_SECONDS_MULTIPLIER * config.burst / state->threshold_rate;
+  for (int i = 0; i < state->n_subnets; i++) {
+    if (!expirator_register(state->allocators[i], state->subnets[i],
+                            state->subnet_indexers[i], exp_time)) {
+      return false;
+    }
+  }
+#endif  // VIGOR_EXPIRATION_BUDGET
+
+  return true;
 }
 
 int64_t expire_entries(vigor_time_t time) {
@@ -188,7 +207,9 @@ int nf_process(uint16_t device, uint8_t **buffer, uint16_t packet_length,
     return device;
   }
 
+#ifndef VIGOR_EXPIRATION_BUDGET
   expire_entries(now);
+#endif  // VIGOR_EXPIRATION_BUDGET
 
   if (device == config.lan_device) {
     // Simply forward outgoing packets.
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 
 #include "lib/verified/boilerplate-util.h"
+#include "lib/verified/vigor-alloc.h"
 #ifdef KLEE_VERIFICATION
 #include "lib/models/verified/double-chain-control.h"
 #include "lib/models/verified/ether.h"
@@ -38,7 +39,7 @@ struct State *alloc_state(uint64_t link_capacity, uint8_t threshold,
                           uint32_t dev_count) {
   if (allocated_nf_state != NULL) return allocated_nf_state;
 
-  struct State *ret = malloc(sizeof(struct State));
+  struct State *ret = vigor_malloc(sizeof(struct State));
 
   if (ret == NULL) return NULL;
 
@@ -49,12 +50,14 @@ struct State *alloc_state(uint64_t link_capacity, uint8_t threshold,
   ret->threshold_rate = threshold_rate;
 
   ret->subnet_indexers =
-      (struct Map **)malloc(sizeof(struct Map *) * n_subnets);
+      (struct Map **)vigor_malloc(sizeof(struct Map *) * n_subnets);
   ret->allocators =
-      (struct DoubleChain **)malloc(sizeof(struct DoubleChain *) * n_subnets);
+      (struct DoubleChain **)vigor_malloc(sizeof(struct DoubleChain *) *
+                                          n_subnets);
   ret->subnet_buckets =
-      (struct Vector **)malloc(sizeof(struct Vector *) * n_subnets);
-  ret->subnets = (struct Vector **)malloc(sizeof(struct Vector *) * n_subnets);
+      (struct Vector **)vigor_malloc(sizeof(struct Vector *) * n_subnets);
+  ret->subnets =
+      (struct Vector **)vigor_malloc(sizeof(struct Vector *) * n_subnets);
 
   for (uint8_t i = 0; i < n_subnets; i++) {
     ret->subnet_indexers[i] = NULL;
@@ -49,4 +49,6 @@ unsigned ip_addr_hash(void* obj) {
   return hash;
 }
 
+MAP_SPECIALIZE_DEFINE(ip_addr, uint32_t, ip_addr_hash, ip_addr_eq)
+
 #endif  // KLEE_VERIFICATION
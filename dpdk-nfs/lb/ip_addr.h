@@ -6,6 +6,7 @@
 
 #include "lib/verified/boilerplate-util.h"
 #include "lib/verified/ether.h"
+#include "lib/unverified/map-specialize.h"
 
 #define DEFAULT_IP_ADDR ip_addrc(0)
 
@@ -23,6 +24,9 @@ void ip_addr_allocate(void* obj);
   p("addr: %d", (obj)->addr); \
   p("}");
 
+// ip_to_backend_id is keyed by the bare uint32_t of backend_ips
+MAP_SPECIALIZE_DECLARE(ip_addr, uint32_t)
+
 #ifdef KLEE_VERIFICATION
 #include <klee/klee.h>
 #include "lib/models/str-descr.h"
@@ -3,6 +3,12 @@
 
 #include "lib/verified/map.h"
 #include "lib/verified/expirator.h"
+#ifdef VIGOR_EXPIRATION_BUDGET
+#include "lib/unverified/expirator.h"
+#endif  // VIGOR_EXPIRATION_BUDGET
+#ifdef VIGOR_CHT_LOOKUP
+#include "lib/unverified/cht-lookup.h"
+#endif  // VIGOR_CHT_LOOKUP
 
 #include <rte_ethdev.h>
 
@@ -16,6 +22,9 @@ struct LoadBalancer {
 
   vigor_time_t backend_expiration_time;
   struct State *state;
+#ifdef VIGOR_CHT_LOOKUP
+  struct ChtLookup *cht_lookup;
+#endif  // VIGOR_CHT_LOOKUP
 };
 
 struct LoadBalancer *lb_allocate_balancer(uint32_t flow_capacity,
@@ -32,21 +41,71 @@ struct LoadBalancer *lb_allocate_balancer(uint32_t flow_capacity,
     return NULL;
   }
 
+#ifdef VIGOR_CHT_LOOKUP
+  if (!cht_lookup_allocate(balancer->state->cht, cht_height, backend_capacity,
+                           &balancer->cht_lookup)) {
+    return NULL;
+  }
+#endif  // VIGOR_CHT_LOOKUP
+
+#ifdef VIGOR_EXPIRATION_BUDGET
+  // Flows and backends are expired by the runtime instead of
+  // lb_expire_flows/lb_expire_backends
+  if (!expirator_register(balancer->state->flow_chain,
+                          balancer->state->flow_heap,
+                          balancer->state->flow_to_flow_id,
+                          flow_expiration_time * 1000) ||  // us to ns
+      !expirator_register(balancer->state->active_backends,
+                          balancer->state->backend_ips,
+                          balancer->state->ip_to_backend_id,
+                          backend_expiration_time * 1000)) {  // us to ns
+    return NULL;
+  }
+#endif  // VIGOR_EXPIRATION_BUDGET
+
   return balancer;
 }
 
+#ifdef LB_FLOW_HASH_KNOWN
+struct LoadBalancedBackend lb_get_backend(struct LoadBalancer *balancer,
+                                          struct LoadBalancedFlow *flow,
+                                          vigor_time_t now,
+                                          uint16_t wan_device) {
+  return lb_get_backend_with_hash(balancer, flow, LoadBalancedFlow_hash(flow),
+                                  now, wan_device);
+}
+
+struct LoadBalancedBackend lb_get_backend_with_hash(
+    struct LoadBalancer *balancer, struct LoadBalancedFlow *flow,
+    unsigned flow_hash, vigor_time_t now, uint16_t wan_device) {
+#else   // LB_FLOW_HASH_KNOWN
 struct LoadBalancedBackend lb_get_backend(struct LoadBalancer *balancer,
                                           struct LoadBalancedFlow *flow,
                                           vigor_time_t now,
                                           uint16_t wan_device) {
+#endif  // LB_FLOW_HASH_KNOWN
   int flow_index;
   struct LoadBalancedBackend backend;
+#ifdef LB_FLOW_HASH_KNOWN
+  if (map_get_with_hash(balancer->state->flow_to_flow_id, flow, flow_hash,
+                        &flow_index) == 0) {
+    uint64_t cht_hash = flow_hash;
+#else   // LB_FLOW_HASH_KNOWN
   if (map_get(balancer->state->flow_to_flow_id, flow, &flow_index) == 0) {
+    uint64_t cht_hash = (uint64_t)LoadBalancedFlow_hash(flow);
+#endif  // LB_FLOW_HASH_KNOWN
     int backend_index = 0;
+#ifdef VIGOR_CHT_LOOKUP
+    cht_lookup_sweep(balancer->cht_lookup, balancer->state->active_backends);
+    int found = cht_lookup_find_backend(balancer->cht_lookup, cht_hash,
+                                        balancer->state->active_backends,
+                                        &backend_index);
+#else   // VIGOR_CHT_LOOKUP
     int found = cht_find_preferred_available_backend(
-        (uint64_t)LoadBalancedFlow_hash(flow), balancer->state->cht,
+        cht_hash, balancer->state->cht,
         balancer->state->active_backends, balancer->state->cht_height,
         balancer->state->backend_capacity, &backend_index);
+#endif  // VIGOR_CHT_LOOKUP
     if (found) {
       if (dchain_allocate_new_index(balancer->state->flow_chain, &flow_index,
                                     now) != 0) {
@@ -60,7 +119,12 @@ struct LoadBalancedBackend lb_get_backend(struct LoadBalancer *balancer,
         *vec_flow_id_to_backend_id = backend_index;
         vector_return(balancer->state->flow_id_to_backend_id, flow_index,
                       (void *)vec_flow_id_to_backend_id);
+#ifdef LB_FLOW_HASH_KNOWN
+        map_put_with_hash(balancer->state->flow_to_flow_id, vec_flow,
+                          flow_hash, flow_index);
+#else   // LB_FLOW_HASH_KNOWN
         map_put(balancer->state->flow_to_flow_id, vec_flow, flow_index);
+#endif  // LB_FLOW_HASH_KNOWN
         vector_return(balancer->state->flow_heap, flow_index,
                       vec_flow);  // another half is in the map
 
@@ -96,7 +160,12 @@ struct LoadBalancedBackend lb_get_backend(struct LoadBalancer *balancer,
 
       dchain_free_index(balancer->state->flow_chain, flow_index);
       vector_return(balancer->state->flow_heap, flow_index, (void *)flow_key);
+#ifdef LB_FLOW_HASH_KNOWN
+      return lb_get_backend_with_hash(balancer, flow, flow_hash, now,
+                                      wan_device);
+#else   // LB_FLOW_HASH_KNOWN
       return lb_get_backend(balancer, flow, now, wan_device);
+#endif  // LB_FLOW_HASH_KNOWN
     } else {
       dchain_rejuvenate_index(balancer->state->flow_chain, flow_index, now);
 
@@ -117,8 +186,8 @@ void lb_process_heartbit(struct LoadBalancer *balancer,
                          struct rte_ether_addr mac_addr, int nic,
                          vigor_time_t now) {
   int backend_index;
-  if (map_get(balancer->state->ip_to_backend_id, &flow->src_ip,
-              &backend_index) == 0) {
+  if (ip_addr_map_get(balancer->state->ip_to_backend_id, &flow->src_ip,
+                      &backend_index) == 0) {
     if (0 != dchain_allocate_new_index(balancer->state->active_backends,
                                        &backend_index, now)) {
       struct LoadBalancedBackend *new_backend;
@@ -133,8 +202,11 @@ void lb_process_heartbit(struct LoadBalancer *balancer,
       uint32_t *ip;
       vector_borrow(balancer->state->backend_ips, backend_index, (void **)&ip);
       *ip = flow->src_ip;
-      map_put(balancer->state->ip_to_backend_id, ip, backend_index);
+      ip_addr_map_put(balancer->state->ip_to_backend_id, ip, backend_index);
       vector_return(balancer->state->backend_ips, backend_index, (void *)ip);
+#ifdef VIGOR_CHT_LOOKUP
+      cht_lookup_backend_added(balancer->cht_lookup);
+#endif  // VIGOR_CHT_LOOKUP
     }
     // Otherwise ignore this backend, we are full.
   } else {
@@ -169,3 +241,15 @@ void lb_expire_backends(struct LoadBalancer *balancer, vigor_time_t time) {
                           balancer->state->backend_ips,
                           balancer->state->ip_to_backend_id, last_time);
 }
+
+#ifdef VIGOR_PREFETCH_DISTANCE
+unsigned lb_prefetch_flow(struct LoadBalancer *balancer,
+                          struct LoadBalancedFlow *flow) {
+  return map_prefetch(balancer->state->flow_to_flow_id, flow);
+}
+
+void lb_prefetch_flow_with_hash(struct LoadBalancer *balancer,
+                                unsigned flow_hash) {
+  map_prefetch_with_hash(balancer->state->flow_to_flow_id, flow_hash);
+}
+#endif  // VIGOR_PREFETCH_DISTANCE
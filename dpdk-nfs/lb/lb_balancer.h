@@ -22,6 +22,17 @@ struct LoadBalancedBackend lb_get_backend(struct LoadBalancer *balancer,
                                           struct LoadBalancedFlow *flow,
                                           vigor_time_t now,
                                           uint16_t wan_device);
+#if defined(VIGOR_RSS_HASH) || defined(VIGOR_PREFETCH_DISTANCE)
+// The LoadBalancedFlow_hash of a packet's flow can be known before its lookup,
+// from the NIC or from nf_prefetch
+#define LB_FLOW_HASH_KNOWN
+
+// Same as lb_get_backend, with the LoadBalancedFlow_hash of the flow already
+// known
+struct LoadBalancedBackend lb_get_backend_with_hash(
+    struct LoadBalancer *balancer, struct LoadBalancedFlow *flow,
+    unsigned flow_hash, vigor_time_t now, uint16_t wan_device);
+#endif  // LB_FLOW_HASH_KNOWN
 void lb_expire_flows(struct LoadBalancer *balancer, vigor_time_t now);
 void lb_expire_backends(struct LoadBalancer *balancer, vigor_time_t now);
 void lb_process_heartbit(struct LoadBalancer *balancer,
@@ -29,4 +40,15 @@ void lb_process_heartbit(struct LoadBalancer *balancer,
                          struct rte_ether_addr mac_addr, int nic,
                          vigor_time_t now);
 
+#ifdef VIGOR_PREFETCH_DISTANCE
+// Prefetches what a later lb_get_backend call for the flow will need, returns
+// its hash
+unsigned lb_prefetch_flow(struct LoadBalancer *balancer,
+                          struct LoadBalancedFlow *flow);
+// Same as lb_prefetch_flow, with the LoadBalancedFlow_hash of the flow already
+// known
+void lb_prefetch_flow_with_hash(struct LoadBalancer *balancer,
+                                unsigned flow_hash);
+#endif  // VIGOR_PREFETCH_DISTANCE
+
 #endif  // _LB_BALANCER_H_INCLUDED_
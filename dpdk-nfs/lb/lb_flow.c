@@ -2,6 +2,10 @@
 
 #include <stdint.h>
 
+#ifdef VIGOR_RSS_HASH
+#include "lib/unverified/rss-hash.h"
+#endif  // VIGOR_RSS_HASH
+
 bool LoadBalancedFlow_eq(void* a, void* b) {
   struct LoadBalancedFlow* id1 = (struct LoadBalancedFlow*)a;
   struct LoadBalancedFlow* id2 = (struct LoadBalancedFlow*)b;
@@ -63,6 +67,11 @@ unsigned LoadBalancedFlow_hash(void* obj) {
 unsigned LoadBalancedFlow_hash(void* obj) {
   struct LoadBalancedFlow* id = (struct LoadBalancedFlow*)obj;
 
+#ifdef VIGOR_RSS_HASH
+  // The hash the NICs compute for the flow's packets, see nf_rss_hash
+  return rss_hash_ipv4_tcpudp(id->src_ip, id->dst_ip, id->src_port,
+                              id->dst_port);
+#else   // VIGOR_RSS_HASH
   unsigned hash = 0;
   hash = __builtin_ia32_crc32si(hash, id->src_ip);
   hash = __builtin_ia32_crc32si(hash, id->dst_ip);
@@ -70,6 +79,7 @@ unsigned LoadBalancedFlow_hash(void* obj) {
   hash = __builtin_ia32_crc32si(hash, id->dst_port);
   hash = __builtin_ia32_crc32si(hash, id->protocol);
   return hash;
+#endif  // VIGOR_RSS_HASH
 }
 
 #endif  // KLEE_VERIFICATION
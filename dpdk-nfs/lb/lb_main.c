@@ -11,16 +11,78 @@ struct nf_config config;
 struct LoadBalancer *balancer;
 
 bool nf_init(void) {
+#ifdef VIGOR_RSS_HASH
+  // More flows than hashes would make long probe chains in the flow table
+  if (config.flow_capacity > RSS_HASH_DISTINCT_VALUES) {
+    NF_INFO("RSS_HASH yields only %d distinct flow hashes, too few for %" PRIu32
+            " flows; build without RSS_HASH=true for larger tables.",
+            RSS_HASH_DISTINCT_VALUES, config.flow_capacity);
+    return false;
+  }
+#endif  // VIGOR_RSS_HASH
   balancer = lb_allocate_balancer(
       config.flow_capacity, config.backend_capacity, config.cht_height,
       config.backend_expiration_time, config.flow_expiration_time);
   return balancer != NULL;
 }
 
+#ifdef VIGOR_PREFETCH_DISTANCE
+bool nf_prefetch(uint16_t device, uint8_t *packet, uint16_t packet_length,
+                 struct rte_mbuf *mbuf, unsigned *hash) {
+  // Heartbeats are rare, only prefetch for load-balanced packets
+  if (device != config.wan_device) {
+    return false;
+  }
+
+  struct rte_ipv4_hdr *rte_ipv4_header;
+  struct tcpudp_hdr *tcpudp_header;
+  if (!nf_peek_rte_ipv4_tcpudp_headers(packet, packet_length, &rte_ipv4_header,
+                                       &tcpudp_header)) {
+    return false;
+  }
+
+#ifdef VIGOR_RSS_HASH
+  *hash = nf_rss_hash(mbuf, rte_ipv4_header, tcpudp_header);
+  lb_prefetch_flow_with_hash(balancer, *hash);
+#else   // VIGOR_RSS_HASH
+  struct LoadBalancedFlow flow = {.src_ip = rte_ipv4_header->src_addr,
+                                  .dst_ip = rte_ipv4_header->dst_addr,
+                                  .src_port = tcpudp_header->src_port,
+                                  .dst_port = tcpudp_header->dst_port,
+                                  .protocol = rte_ipv4_header->next_proto_id};
+  *hash = lb_prefetch_flow(balancer, &flow);
+#endif  // VIGOR_RSS_HASH
+  return true;
+}
+#endif  // VIGOR_PREFETCH_DISTANCE
+
+#ifdef LB_FLOW_HASH_KNOWN
+// The LoadBalancedFlow_hash of the packet's flow, without hashing the flow
+// again if nf_prefetch or the NIC already did
+static unsigned lb_flow_hash(struct LoadBalancedFlow *flow,
+                             struct rte_mbuf *mbuf,
+                             struct rte_ipv4_hdr *rte_ipv4_header,
+                             struct tcpudp_hdr *tcpudp_header) {
+#ifdef VIGOR_PREFETCH_DISTANCE
+  unsigned hash;
+  if (nf_prefetched_hash(&hash)) {
+    return hash;
+  }
+#endif  // VIGOR_PREFETCH_DISTANCE
+#ifdef VIGOR_RSS_HASH
+  return nf_rss_hash(mbuf, rte_ipv4_header, tcpudp_header);
+#else   // VIGOR_RSS_HASH
+  return LoadBalancedFlow_hash(flow);
+#endif  // VIGOR_RSS_HASH
+}
+#endif  // LB_FLOW_HASH_KNOWN
+
 int nf_process(uint16_t device, uint8_t **buffer, uint16_t packet_length,
                vigor_time_t now, struct rte_mbuf *mbuf) {
+#ifndef VIGOR_EXPIRATION_BUDGET
   lb_expire_flows(balancer, now);
   lb_expire_backends(balancer, now);
+#endif  // VIGOR_EXPIRATION_BUDGET
 
   struct rte_ether_hdr *rte_ether_header = nf_then_get_rte_ether_header(buffer);
   struct rte_ipv4_hdr *rte_ipv4_header =
@@ -49,8 +111,15 @@ int nf_process(uint16_t device, uint8_t **buffer, uint16_t packet_length,
     return device;
   }
 
+#ifdef LB_FLOW_HASH_KNOWN
+  struct LoadBalancedBackend backend = lb_get_backend_with_hash(
+      balancer, &flow,
+      lb_flow_hash(&flow, mbuf, rte_ipv4_header, tcpudp_header), now,
+      config.wan_device);
+#else   // LB_FLOW_HASH_KNOWN
   struct LoadBalancedBackend backend =
       lb_get_backend(balancer, &flow, now, config.wan_device);
+#endif  // LB_FLOW_HASH_KNOWN
 
   NF_DEBUG("Processing packet from %" PRIu16 " to %" PRIu16, device,
            backend.nic);
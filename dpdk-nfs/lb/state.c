@@ -3,6 +3,7 @@
 #include <stdlib.h>
 
 #include "lib/verified/boilerplate-util.h"
+#include "lib/verified/vigor-alloc.h"
 
 #ifdef KLEE_VERIFICATION
 #include "lib/models/verified/double-chain-control.h"
@@ -33,7 +34,7 @@ bool lb_flow_id2backend_id_cond(void* value, int index, void* state) {
 struct State* alloc_state(uint32_t backend_capacity, uint32_t flow_capacity,
                           uint32_t cht_height) {
   if (allocated_nf_state != NULL) return allocated_nf_state;
-  struct State* ret = malloc(sizeof(struct State));
+  struct State* ret = vigor_malloc(sizeof(struct State));
   if (ret == NULL) return NULL;
   ret->flow_to_flow_id = NULL;
   if (map_allocate(LoadBalancedFlow_eq, LoadBalancedFlow_hash, flow_capacity,
@@ -0,0 +1,116 @@
+#ifdef VIGOR_CHT_LOOKUP
+
+#include "cht-lookup.h"
+
+#include "../verified/vigor-alloc.h"
+
+// Rows looked at by every cht_lookup_sweep
+#define CHT_LOOKUP_SWEEP_BUDGET 4
+
+// Every row remembers its backend and the backend's position in the row,
+// which is also where the sweep stops looking for a preferred one.
+// A row without backend has rank backend_capacity.
+struct cht_row {
+  int backend;  // -1 if none
+  uint32_t rank;
+};
+
+struct ChtLookup {
+  struct cht_row *rows;
+  struct Vector *cht;
+  uint32_t cht_height;
+  uint32_t backend_capacity;
+
+  uint32_t sweep;            // next row cht_lookup_sweep fixes
+  uint32_t sweep_remaining;  // rows until the sweep is done
+};
+
+static inline uint32_t row_candidate(struct ChtLookup *lookup, uint32_t row,
+                                     uint32_t rank) {
+  int index = (int)(row * lookup->backend_capacity + rank);
+  uint32_t *candidate;
+  vector_borrow(lookup->cht, index, (void **)&candidate);
+  uint32_t backend = *candidate;
+  vector_return(lookup->cht, index, candidate);
+  return backend;
+}
+
+// Looks for the first active backend among the first end ones of the row
+static void row_update(struct ChtLookup *lookup, uint32_t row, uint32_t end,
+                       struct DoubleChain *active_backends) {
+  for (uint32_t rank = 0; rank < end; rank++) {
+    uint32_t backend = row_candidate(lookup, row, rank);
+    if (dchain_is_index_allocated(active_backends, (int)backend)) {
+      lookup->rows[row].backend = (int)backend;
+      lookup->rows[row].rank = rank;
+      return;
+    }
+  }
+  if (end == lookup->backend_capacity) {
+    lookup->rows[row].backend = -1;
+    lookup->rows[row].rank = lookup->backend_capacity;
+  }
+}
+
+int cht_lookup_allocate(struct Vector *cht, uint32_t cht_height,
+                        uint32_t backend_capacity,
+                        struct ChtLookup **lookup_out) {
+  struct ChtLookup *lookup =
+      (struct ChtLookup *)vigor_malloc(sizeof(struct ChtLookup));
+  if (lookup == NULL) {
+    return 0;
+  }
+  lookup->rows =
+      (struct cht_row *)vigor_malloc(sizeof(struct cht_row) * cht_height);
+  if (lookup->rows == NULL) {
+    vigor_free(lookup);
+    return 0;
+  }
+
+  for (uint32_t row = 0; row < cht_height; row++) {
+    lookup->rows[row].backend = -1;
+    lookup->rows[row].rank = backend_capacity;
+  }
+  lookup->cht = cht;
+  lookup->cht_height = cht_height;
+  lookup->backend_capacity = backend_capacity;
+  lookup->sweep = 0;
+  lookup->sweep_remaining = 0;
+  *lookup_out = lookup;
+  return 1;
+}
+
+int cht_lookup_find_backend(struct ChtLookup *lookup, uint64_t hash,
+                            struct DoubleChain *active_backends,
+                            int *chosen_backend) {
+  uint32_t row = (uint32_t)(hash % lookup->cht_height);
+  int backend = lookup->rows[row].backend;
+  if (backend < 0 || !dchain_is_index_allocated(active_backends, backend)) {
+    row_update(lookup, row, lookup->backend_capacity, active_backends);
+    backend = lookup->rows[row].backend;
+    if (backend < 0) {
+      return 0;
+    }
+  }
+  *chosen_backend = backend;
+  return 1;
+}
+
+void cht_lookup_backend_added(struct ChtLookup *lookup) {
+  lookup->sweep_remaining = lookup->cht_height;
+}
+
+// Rows only need to look before their backend: if it is gone, the next
+// lookup fixes the row anyway
+void cht_lookup_sweep(struct ChtLookup *lookup,
+                      struct DoubleChain *active_backends) {
+  for (int n = 0; n < CHT_LOOKUP_SWEEP_BUDGET && lookup->sweep_remaining != 0;
+       n++) {
+    uint32_t row = lookup->sweep;
+    row_update(lookup, row, lookup->rows[row].rank, active_backends);
+    lookup->sweep = row + 1 == lookup->cht_height ? 0 : row + 1;
+    lookup->sweep_remaining--;
+  }
+}
+
+#endif  // VIGOR_CHT_LOOKUP
@@ -0,0 +1,43 @@
+#ifndef _UNVERIFIED_CHT_LOOKUP_H_INCLUDED_
+#define _UNVERIFIED_CHT_LOOKUP_H_INCLUDED_
+
+#include <stdint.h>
+
+#include "../verified/double-chain.h"
+#include "../verified/vector.h"
+
+// Unverified lookup table over a consistent hashing table filled by
+// cht_fill_cht, used by NFs built with CHT_LOOKUP=true: it remembers, for
+// every row of the CHT, the backend cht_find_preferred_available_backend
+// found there, so that choosing a backend is a single read while that
+// backend stays active.
+// Rows whose backend is gone are scanned again, and fixed, by the next
+// lookup; rows where a newly active backend now comes first are fixed by a
+// background sweep, CHT_LOOKUP_SWEEP_BUDGET rows per cht_lookup_sweep.
+// Until then, the row keeps its previous backend, which is still active.
+// There is no symbex model for it, so verified NFs cannot use it.
+
+struct ChtLookup;
+
+// @param cht - Filled by cht_fill_cht with the same dimensions; not copied,
+//              and must outlive the lookup table.
+// @returns 1 on success, 0 otherwise.
+int cht_lookup_allocate(struct Vector *cht, uint32_t cht_height,
+                        uint32_t backend_capacity,
+                        struct ChtLookup **lookup_out);
+
+// Same result as cht_find_preferred_available_backend, once the sweep is
+// done.
+// @returns 1 and the chosen backend if there is an active one, 0 otherwise.
+int cht_lookup_find_backend(struct ChtLookup *lookup, uint64_t hash,
+                            struct DoubleChain *active_backends,
+                            int *chosen_backend);
+
+// Called when a backend becomes active: restarts the sweep.
+void cht_lookup_backend_added(struct ChtLookup *lookup);
+
+// Fixes the next few rows of the sweep, if any.
+void cht_lookup_sweep(struct ChtLookup *lookup,
+                      struct DoubleChain *active_backends);
+
+#endif  //_UNVERIFIED_CHT_LOOKUP_H_INCLUDED_
@@ -0,0 +1,222 @@
+#ifdef VIGOR_CONCURRENT_MAP
+
+#include "concurrent-map.h"
+
+#include <rte_rcu_qsbr.h>
+
+#include "../verified/vigor-alloc.h"
+
+// Slot states; readers only look at busy slots, and the writer does not
+// reuse retired ones, erased while readers may still be looking at them,
+// until the next grace period
+#define SLOT_FREE 0
+#define SLOT_BUSY 1
+#define SLOT_RETIRED 2
+
+struct ConcurrentMap {
+  // Same arrays as struct Map in lib/verified/map.c
+  int* busybits;
+  void** keyps;
+  unsigned* khs;
+  int* chns;
+  int* vals;
+  unsigned capacity;
+  unsigned size;
+  map_keys_equality* keys_eq;
+  map_key_hash* khash;
+
+  // Writer-only
+  unsigned* retired;  // slots retired since the last grace period
+  unsigned retired_count;
+  unsigned writer_reader_id;
+
+  struct rte_rcu_qsbr* qsbr;
+};
+
+static inline unsigned start_index(struct ConcurrentMap* map, unsigned hash) {
+#ifdef CAPACITY_POW2
+  return hash & (map->capacity - 1);
+#else
+  return hash % map->capacity;
+#endif
+}
+
+static inline unsigned next_index(struct ConcurrentMap* map, unsigned index) {
+  return index + 1 == map->capacity ? 0 : index + 1;
+}
+
+int concurrent_map_allocate(map_keys_equality* keys_eq, map_key_hash* khash,
+                            unsigned capacity, unsigned max_readers,
+                            struct ConcurrentMap** map_out) {
+#ifdef CAPACITY_POW2
+  if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+    return 0;
+  }
+#else
+  if (capacity == 0) {
+    return 0;
+  }
+#endif
+  if (max_readers == 0) {
+    return 0;
+  }
+
+  struct ConcurrentMap* map = vigor_malloc(sizeof(struct ConcurrentMap));
+  if (map == NULL) {
+    return 0;
+  }
+  map->busybits = vigor_malloc(sizeof(int) * capacity);
+  map->keyps = vigor_malloc(sizeof(void*) * capacity);
+  map->khs = vigor_malloc(sizeof(unsigned) * capacity);
+  map->chns = vigor_malloc(sizeof(int) * capacity);
+  map->vals = vigor_malloc(sizeof(int) * capacity);
+  map->retired = vigor_malloc(sizeof(unsigned) * capacity);
+  // QSBR variables must be cache-aligned, which vigor_malloc guarantees
+  map->qsbr = vigor_malloc(rte_rcu_qsbr_get_memsize(max_readers));
+  if (map->busybits == NULL || map->keyps == NULL || map->khs == NULL ||
+      map->chns == NULL || map->vals == NULL || map->retired == NULL ||
+      map->qsbr == NULL || rte_rcu_qsbr_init(map->qsbr, max_readers) != 0) {
+    vigor_free(map->qsbr);
+    vigor_free(map->retired);
+    vigor_free(map->vals);
+    vigor_free(map->chns);
+    vigor_free(map->khs);
+    vigor_free(map->keyps);
+    vigor_free(map->busybits);
+    vigor_free(map);
+    return 0;
+  }
+
+  for (unsigned index = 0; index < capacity; index++) {
+    map->busybits[index] = SLOT_FREE;
+    map->chns[index] = 0;
+  }
+  map->capacity = capacity;
+  map->size = 0;
+  map->keys_eq = keys_eq;
+  map->khash = khash;
+  map->retired_count = 0;
+  map->writer_reader_id = RTE_QSBR_THRID_INVALID;
+  *map_out = map;
+  return 1;
+}
+
+int concurrent_map_reader_register(struct ConcurrentMap* map,
+                                   unsigned reader_id) {
+  if (rte_rcu_qsbr_thread_register(map->qsbr, reader_id) != 0) {
+    return 0;
+  }
+  rte_rcu_qsbr_thread_online(map->qsbr, reader_id);
+  return 1;
+}
+
+void concurrent_map_reader_unregister(struct ConcurrentMap* map,
+                                      unsigned reader_id) {
+  rte_rcu_qsbr_thread_offline(map->qsbr, reader_id);
+  rte_rcu_qsbr_thread_unregister(map->qsbr, reader_id);
+}
+
+void concurrent_map_quiescent(struct ConcurrentMap* map, unsigned reader_id) {
+  rte_rcu_qsbr_quiescent(map->qsbr, reader_id);
+}
+
+// Same probing as find_key in lib/verified/map-impl.c; the acquire load of
+// the busy bit orders the loads of the slot after the writer's stores
+int concurrent_map_get(struct ConcurrentMap* map, void* key, int* value_out) {
+  unsigned hash = map->khash(key);
+  unsigned index = start_index(map, hash);
+  for (unsigned i = 0; i < map->capacity; ++i) {
+    if (__atomic_load_n(&map->busybits[index], __ATOMIC_ACQUIRE) ==
+            SLOT_BUSY &&
+        map->khs[index] == hash) {
+      if (map->keys_eq(map->keyps[index], key)) {
+        *value_out = map->vals[index];
+        return 1;
+      }
+    } else if (__atomic_load_n(&map->chns[index], __ATOMIC_RELAXED) == 0) {
+      return 0;
+    }
+    index = next_index(map, index);
+  }
+  return 0;
+}
+
+void concurrent_map_writer_is_reader(struct ConcurrentMap* map,
+                                     unsigned reader_id) {
+  map->writer_reader_id = reader_id;
+}
+
+void concurrent_map_synchronize(struct ConcurrentMap* map) {
+  rte_rcu_qsbr_synchronize(map->qsbr, map->writer_reader_id);
+  for (unsigned n = 0; n < map->retired_count; n++) {
+    __atomic_store_n(&map->busybits[map->retired[n]], SLOT_FREE,
+                     __ATOMIC_RELAXED);
+  }
+  map->retired_count = 0;
+}
+
+void concurrent_map_put(struct ConcurrentMap* map, void* key, int value) {
+  if (map->size + map->retired_count == map->capacity) {
+    concurrent_map_synchronize(map);
+  }
+
+  // Chain counters grow before the key is published, so that readers never
+  // stop probing before it
+  unsigned hash = map->khash(key);
+  unsigned index = start_index(map, hash);
+  while (map->busybits[index] != SLOT_FREE) {
+    __atomic_store_n(&map->chns[index], map->chns[index] + 1,
+                     __ATOMIC_RELAXED);
+    index = next_index(map, index);
+  }
+  map->keyps[index] = key;
+  map->khs[index] = hash;
+  map->vals[index] = value;
+  __atomic_store_n(&map->busybits[index], SLOT_BUSY, __ATOMIC_RELEASE);
+  map->size++;
+}
+
+// Same probing as find_key_remove_chain in lib/verified/map-impl.c; the key
+// is unpublished before the chain counters shrink, and the other keys that
+// probed past them still count in them
+void concurrent_map_erase(struct ConcurrentMap* map, void* key,
+                          void** trash) {
+  unsigned hash = map->khash(key);
+  unsigned start = start_index(map, hash);
+  unsigned index = start;
+  while (map->busybits[index] != SLOT_BUSY || map->khs[index] != hash ||
+         !map->keys_eq(map->keyps[index], key)) {
+    index = next_index(map, index);
+  }
+  __atomic_store_n(&map->busybits[index], SLOT_RETIRED, __ATOMIC_RELEASE);
+  for (unsigned passed = start; passed != index;
+       passed = next_index(map, passed)) {
+    __atomic_store_n(&map->chns[passed], map->chns[passed] - 1,
+                     __ATOMIC_RELAXED);
+  }
+  map->retired[map->retired_count] = index;
+  map->retired_count++;
+  *trash = map->keyps[index];
+  map->size--;
+}
+
+unsigned concurrent_map_size(struct ConcurrentMap* map) { return map->size; }
+
+int concurrent_map_expire(struct DoubleChain* chain, struct Vector* vector,
+                          struct ConcurrentMap* map, vigor_time_t time) {
+  int count = 0;
+  int index = -1;
+  while (dchain_expire_one_index(chain, &index, time)) {
+    void* key;
+    vector_borrow(vector, index, &key);
+    concurrent_map_erase(map, key, &key);
+    vector_return(vector, index, key);
+    ++count;
+  }
+  if (count != 0) {
+    concurrent_map_synchronize(map);
+  }
+  return count;
+}
+
+#endif  // VIGOR_CONCURRENT_MAP
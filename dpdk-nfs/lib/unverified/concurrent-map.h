@@ -0,0 +1,74 @@
+#ifndef _UNVERIFIED_CONCURRENT_MAP_H_INCLUDED_
+#define _UNVERIFIED_CONCURRENT_MAP_H_INCLUDED_
+
+#include "../verified/double-chain.h"
+#include "../verified/map.h"
+#include "../verified/vector.h"
+#include "../verified/vigor-time.h"
+
+// Unverified map for read-mostly state shared by the lcores, built with
+// CONCURRENT_MAP=true: any number of readers look keys up without locks,
+// while a single writer puts and erases them.
+// The table has the layout and the probing of lib/verified/map.c; the writer
+// publishes a key only once its slot and chain counters are written, and an
+// erased slot is not reused until every reader went through a quiescent
+// state (DPDK's QSBR flavor of RCU) since the erasure.
+//
+// Readers register with an id in [0, max_readers) and report a quiescent
+// state, in which they hold no pointers obtained from the map, between
+// bursts. Keys are owned by the writer like with map.h; the memory of an
+// erased key may only be reused after the next concurrent_map_synchronize.
+// There is no symbex model for it, so verified NFs cannot use it.
+
+struct ConcurrentMap;
+
+// @returns 1 on success, 0 otherwise.
+int concurrent_map_allocate(map_keys_equality* keys_eq, map_key_hash* khash,
+                            unsigned capacity, unsigned max_readers,
+                            struct ConcurrentMap** map_out);
+
+// Called by every reader before its first lookup.
+// @returns 1 on success, 0 otherwise.
+int concurrent_map_reader_register(struct ConcurrentMap* map,
+                                   unsigned reader_id);
+
+// Called by a reader that stops looking keys up, so that the writer does not
+// wait for it anymore.
+void concurrent_map_reader_unregister(struct ConcurrentMap* map,
+                                      unsigned reader_id);
+
+// Reports that the reader holds no pointers obtained from the map.
+void concurrent_map_quiescent(struct ConcurrentMap* map, unsigned reader_id);
+
+// Lock-free lookup, for registered readers.
+// @returns 1 and the key's value if the key is in the map, 0 otherwise.
+int concurrent_map_get(struct ConcurrentMap* map, void* key, int* value_out);
+
+// When the writer also looks keys up, as the given reader, it must say so:
+// waiting for readers then does not wait for itself.
+void concurrent_map_writer_is_reader(struct ConcurrentMap* map,
+                                     unsigned reader_id);
+
+// Writer only; the key must not be in the map, and the map not full.
+// May wait for readers if erased slots fill the rest of the map.
+void concurrent_map_put(struct ConcurrentMap* map, void* key, int value);
+
+// Writer only; the key must be in the map. Readers may still see the key,
+// and trash, until the next concurrent_map_synchronize.
+void concurrent_map_erase(struct ConcurrentMap* map, void* key, void** trash);
+
+// Writer only: waits until no reader can see the keys erased so far,
+// whose slots and memory can then be reused.
+void concurrent_map_synchronize(struct ConcurrentMap* map);
+
+unsigned concurrent_map_size(struct ConcurrentMap* map);
+
+// Like expire_items_single_map, for the writer: erases the keys of the
+// indexes that expire from the chain, then waits for readers before
+// returning, since the indexes, and thus the keys in the vector, may be
+// reused right after.
+// @returns the number of expired items.
+int concurrent_map_expire(struct DoubleChain* chain, struct Vector* vector,
+                          struct ConcurrentMap* map, vigor_time_t time);
+
+#endif  //_UNVERIFIED_CONCURRENT_MAP_H_INCLUDED_
@@ -0,0 +1,239 @@
+#ifdef VIGOR_DCHAIN_WHEEL
+
+// Unverified implementation of double-chain.h, built with DCHAIN_LAYOUT=wheel
+// instead of lib/verified/double-chain.c.
+// The verified chain keeps allocated indexes in exact LRU order, so every
+// rejuvenation unlinks the index, appends it to the list and writes its
+// timestamp, i.e. four scattered writes per packet.
+// Here, time is cut into epochs of 2^DCHAIN_WHEEL_EPOCH_SHIFT nanoseconds, and
+// rejuvenating an index only stores the current epoch in its stamp.
+// Allocated indexes sit in the bucket of a timer wheel for the epoch in which
+// they were allocated, or in which expiration last looked at them.
+// Expiration sweeps whole buckets, oldest epoch first: indexes whose stamp is
+// older than the given time expire, the others were rejuvenated in the
+// meantime and move to the bucket of their stamp.
+// Expiration is thus coarse: an index expires once the whole epoch of its last
+// rejuvenation is older than the given time, i.e. up to one epoch late, and
+// indexes rejuvenated in the same epoch expire in no particular order.
+// The wheel may span less time than the indexes' ages; buckets then hold
+// indexes of several epochs, which are checked against their stamp anyway.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "../verified/double-chain.h"
+#include "../verified/vigor-alloc.h"
+
+#ifdef VIGOR_TELEMETRY
+#include "telemetry.h"
+#endif  // VIGOR_TELEMETRY
+
+// 2^24ns is about 17ms
+#ifndef DCHAIN_WHEEL_EPOCH_SHIFT
+#define DCHAIN_WHEEL_EPOCH_SHIFT 24
+#endif  // DCHAIN_WHEEL_EPOCH_SHIFT
+
+// Must be a power of 2; with the default epochs, the wheel spans about 70s
+#ifndef DCHAIN_WHEEL_BUCKETS
+#define DCHAIN_WHEEL_BUCKETS 4096
+#endif  // DCHAIN_WHEEL_BUCKETS
+
+_Static_assert((DCHAIN_WHEEL_BUCKETS & (DCHAIN_WHEEL_BUCKETS - 1)) == 0,
+               "The number of buckets must be a power of 2");
+
+// Links of circular lists; the lists of the buckets, and the one being swept,
+// start at sentinel cells that follow the cells of the indexes
+struct wheel_cell {
+  int prev;
+  int next;
+};
+
+struct DoubleChain {
+  // Epoch of the last rejuvenation of every index, 0 if it is free.
+  // Epochs wrap around, and are compared accordingly.
+  uint32_t* stamps;
+  struct wheel_cell* cells;
+  int index_range;
+  int free_head;    // free indexes, linked through their next
+  uint32_t cursor;  // epoch of the next bucket to sweep
+  bool cursor_set;  // unset until the first allocation
+};
+
+static inline uint32_t epoch_of(vigor_time_t time) {
+  uint32_t epoch = (uint32_t)((uint64_t)time >> DCHAIN_WHEEL_EPOCH_SHIFT);
+  return epoch == 0 ? 1 : epoch;
+}
+
+static inline bool epoch_before(uint32_t a, uint32_t b) {
+  return (int32_t)(a - b) < 0;
+}
+
+static inline int bucket_sentinel(struct DoubleChain* chain, uint32_t epoch) {
+  return chain->index_range + (epoch & (DCHAIN_WHEEL_BUCKETS - 1));
+}
+
+static inline int sweep_sentinel(struct DoubleChain* chain) {
+  return chain->index_range + DCHAIN_WHEEL_BUCKETS;
+}
+
+static inline void list_init(struct DoubleChain* chain, int sentinel) {
+  chain->cells[sentinel].prev = sentinel;
+  chain->cells[sentinel].next = sentinel;
+}
+
+static inline void list_append(struct DoubleChain* chain, int sentinel,
+                               int index) {
+  int tail = chain->cells[sentinel].prev;
+  chain->cells[index].prev = tail;
+  chain->cells[index].next = sentinel;
+  chain->cells[tail].next = index;
+  chain->cells[sentinel].prev = index;
+}
+
+static inline void list_remove(struct DoubleChain* chain, int index) {
+  int prev = chain->cells[index].prev;
+  int next = chain->cells[index].next;
+  chain->cells[prev].next = next;
+  chain->cells[next].prev = prev;
+}
+
+// Moves the whole list to an empty one
+static inline void list_move(struct DoubleChain* chain, int from, int to) {
+  int head = chain->cells[from].next;
+  if (head == from) {
+    return;
+  }
+  int tail = chain->cells[from].prev;
+  chain->cells[to].next = head;
+  chain->cells[to].prev = tail;
+  chain->cells[head].prev = to;
+  chain->cells[tail].next = to;
+  list_init(chain, from);
+}
+
+static inline void free_push(struct DoubleChain* chain, int index) {
+  chain->stamps[index] = 0;
+  chain->cells[index].next = chain->free_head;
+  chain->free_head = index;
+}
+
+int dchain_allocate(int index_range, struct DoubleChain** chain_out) {
+  if (index_range <= 0) {
+    return 0;
+  }
+
+  struct DoubleChain* chain = vigor_malloc(sizeof(struct DoubleChain));
+  if (chain == NULL) {
+    return 0;
+  }
+  chain->stamps = vigor_malloc(sizeof(uint32_t) * index_range);
+  if (chain->stamps == NULL) {
+    vigor_free(chain);
+    return 0;
+  }
+  chain->cells = vigor_malloc(sizeof(struct wheel_cell) *
+                              (index_range + DCHAIN_WHEEL_BUCKETS + 1));
+  if (chain->cells == NULL) {
+    vigor_free(chain->stamps);
+    vigor_free(chain);
+    return 0;
+  }
+
+  chain->index_range = index_range;
+  // Hand out low indexes first, like the verified chain
+  chain->free_head = -1;
+  for (int index = index_range - 1; index >= 0; index--) {
+    free_push(chain, index);
+  }
+  for (int bucket = 0; bucket <= DCHAIN_WHEEL_BUCKETS; bucket++) {
+    list_init(chain, index_range + bucket);
+  }
+  chain->cursor = 0;
+  chain->cursor_set = false;
+  *chain_out = chain;
+  return 1;
+}
+
+int dchain_allocate_new_index(struct DoubleChain* chain, int* index_out,
+                              vigor_time_t time) {
+  int index = chain->free_head;
+  if (index < 0) {
+#ifdef VIGOR_TELEMETRY
+    telemetry_chain_allocation_failed();
+#endif  // VIGOR_TELEMETRY
+    return 0;
+  }
+  chain->free_head = chain->cells[index].next;
+
+  uint32_t epoch = epoch_of(time);
+  if (!chain->cursor_set) {
+    chain->cursor = epoch;
+    chain->cursor_set = true;
+  }
+  chain->stamps[index] = epoch;
+  list_append(chain, bucket_sentinel(chain, epoch), index);
+  *index_out = index;
+  return 1;
+}
+
+int dchain_rejuvenate_index(struct DoubleChain* chain, int index,
+                            vigor_time_t time) {
+  if (chain->stamps[index] == 0) {
+    return 0;
+  }
+  chain->stamps[index] = epoch_of(time);
+  return 1;
+}
+
+int dchain_expire_one_index(struct DoubleChain* chain, int* index_out,
+                            vigor_time_t time) {
+  if (!chain->cursor_set) {
+    return 0;
+  }
+
+  uint32_t border = epoch_of(time);
+  int sweep = sweep_sentinel(chain);
+  for (;;) {
+    // Finish the bucket being swept; indexes that move back to the same
+    // bucket land after the sentinel, so this terminates
+    for (int index = chain->cells[sweep].next; index != sweep;
+         index = chain->cells[sweep].next) {
+      list_remove(chain, index);
+      if (epoch_before(chain->stamps[index], border)) {
+        free_push(chain, index);
+        *index_out = index;
+#ifdef VIGOR_TELEMETRY
+        telemetry_chain_expired();
+#endif  // VIGOR_TELEMETRY
+        return 1;
+      }
+      list_append(chain, bucket_sentinel(chain, chain->stamps[index]), index);
+    }
+
+    if (!epoch_before(chain->cursor, border)) {
+      return 0;
+    }
+    // Sweeping every bucket once is enough to find all expired indexes
+    if ((uint32_t)(border - chain->cursor) > DCHAIN_WHEEL_BUCKETS) {
+      chain->cursor = border - DCHAIN_WHEEL_BUCKETS;
+    }
+    list_move(chain, bucket_sentinel(chain, chain->cursor), sweep);
+    chain->cursor++;
+  }
+}
+
+int dchain_is_index_allocated(struct DoubleChain* chain, int index) {
+  return chain->stamps[index] != 0;
+}
+
+int dchain_free_index(struct DoubleChain* chain, int index) {
+  if (chain->stamps[index] == 0) {
+    return 0;
+  }
+  list_remove(chain, index);
+  free_push(chain, index);
+  return 1;
+}
+
+#endif  // VIGOR_DCHAIN_WHEEL
@@ -0,0 +1,4 @@
+#include "ether-map.h"
+
+MAP_SPECIALIZE_DEFINE(rte_ether_addr, struct rte_ether_addr,
+                      rte_ether_addr_hash, rte_ether_addr_eq)
@@ -0,0 +1,11 @@
+#ifndef _UNVERIFIED_ETHER_MAP_H_INCLUDED_
+#define _UNVERIFIED_ETHER_MAP_H_INCLUDED_
+
+#include "../verified/ether.h"
+#include "map-specialize.h"
+
+// Map instance keyed by MAC addresses, see map-specialize.h; kept out of
+// lib/verified/ether.h so that the verified code does not depend on it
+MAP_SPECIALIZE_DECLARE(rte_ether_addr, struct rte_ether_addr)
+
+#endif  //_UNVERIFIED_ETHER_MAP_H_INCLUDED_
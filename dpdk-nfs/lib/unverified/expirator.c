@@ -1,4 +1,5 @@
 #include "expirator.h"
+#include "../verified/boilerplate-util.h"
 #include <assert.h>
 
 int expire_items_single_map_iteratively(struct Vector *vector, struct Map *map,
@@ -12,3 +13,97 @@ int expire_items_single_map_iteratively(struct Vector *vector, struct Map *map,
     vector_return(vector, i, key);
   }
 }
+
+struct ExpirationTable {
+  struct DoubleChain *chain;
+  struct Vector *vector;
+  struct Map *map;
+  vigor_time_t expiration_time;
+  // Time border of the last sweep that ran out of budget; items older than it
+  // are overdue. -1 if the table is up to date.
+  vigor_time_t backlog_time;
+};
+
+struct Expirator {
+  struct ExpirationTable tables[EXPIRATOR_MAX_TABLES];
+  int tables_count;
+  // Table at which the next run starts: the one after the table that used up
+  // the budget last, so that a busy table cannot starve the ones after it
+  int next_table;
+  uint64_t overdue_count;
+};
+
+static VIGOR_PER_LCORE struct Expirator expirator;
+
+bool expirator_register(struct DoubleChain *chain, struct Vector *vector,
+                        struct Map *map, vigor_time_t expiration_time) {
+  if (expirator.tables_count == EXPIRATOR_MAX_TABLES) {
+    return false;
+  }
+
+  struct ExpirationTable *table = &expirator.tables[expirator.tables_count];
+  table->chain = chain;
+  table->vector = vector;
+  table->map = map;
+  table->expiration_time = expiration_time;
+  table->backlog_time = -1;
+  expirator.tables_count++;
+  return true;
+}
+
+// Same as expire_items_single_map, but stops after `budget` items
+static int expire_items_bounded(struct ExpirationTable *table,
+                                vigor_time_t time, int budget) {
+  int count = 0;
+  int index = -1;
+  while (count < budget &&
+         dchain_expire_one_index(table->chain, &index, time)) {
+    void *key;
+    vector_borrow(table->vector, index, &key);
+    map_erase(table->map, key, &key);
+    vector_return(table->vector, index, key);
+    count++;
+  }
+  return count;
+}
+
+int expirator_run(vigor_time_t now, int budget) {
+  assert(budget >= 0);
+  if (budget == 0) {
+    return 0;
+  }
+
+  int expired = 0;
+
+  for (int n = 0; n < expirator.tables_count; n++) {
+    int table_index = (expirator.next_table + n) % expirator.tables_count;
+    struct ExpirationTable *table = &expirator.tables[table_index];
+
+    // Leftovers first: everything older than the backlog border is overdue
+    if (table->backlog_time >= 0) {
+      int overdue =
+          expire_items_bounded(table, table->backlog_time, budget - expired);
+      expirator.overdue_count += overdue;
+      expired += overdue;
+      if (expired == budget) {
+        // The backlog border stays, this table resumes from it in its turn
+        expirator.next_table = (table_index + 1) % expirator.tables_count;
+        return expired;
+      }
+      table->backlog_time = -1;
+    }
+
+    vigor_time_t min_time = now - table->expiration_time;
+    expired += expire_items_bounded(table, min_time, budget - expired);
+    if (expired == budget) {
+      // There may be more expired items, resume from them in this table's turn
+      table->backlog_time = min_time;
+      expirator.next_table = (table_index + 1) % expirator.tables_count;
+      return expired;
+    }
+  }
+
+  return expired;
+}
+
+uint64_t expirator_overdue_count(void) { return expirator.overdue_count; }
@@ -1,8 +1,13 @@
 #ifndef _UNVERIFIED_EXPIRATOR_H_INCLUDED_
 #define _UNVERIFIED_EXPIRATOR_H_INCLUDED_
 
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../verified/double-chain.h"
 #include "../verified/map.h"
 #include "../verified/vector.h"
+#include "../verified/vigor-time.h"
 
 // The function takes "coherent" chain vector and hash map,
 // and a given number of elements.
@@ -11,4 +16,34 @@
 int expire_items_single_map_iteratively(struct Vector *vector, struct Map *map,
                                         int start, int n_elems);
 
+// Bounded expiration scheduler, used instead of the per-packet
+// expire_items_single_map sweeps when building with EXPIRATION_BUDGET.
+// NFs register their tables once; the runtime then expires at most a given
+// number of items at a time, resuming where it stopped, and catches up when
+// there are no packets to process.
+// Every lcore has its own scheduler, like it has its own NF state.
+
+// Maximum number of tables one NF instance can register
+#define EXPIRATOR_MAX_TABLES 64
+
+// Registers a "coherent" chain, vector and hash map, like the ones
+// expire_items_single_map takes.
+// @param expiration_time - Nanoseconds after which an item that has not been
+//                          rejuvenated expires.
+// @returns true on success, false if there are too many tables.
+bool expirator_register(struct DoubleChain *chain, struct Vector *vector,
+                        struct Map *map, vigor_time_t expiration_time);
+
+// Expires at most `budget` items from the registered tables, oldest
+// leftovers of a table first. Calls start at the table after the one that
+// used up the budget of the previous call, so every table gets its turn.
+// @param now - Current time.
+// @param budget - Maximum number of items to expire.
+// @returns the number of expired items.
+int expirator_run(vigor_time_t now, int budget);
+
+// Number of items that stayed resident after they expired, because the
+// budget ran out before they could be removed.
+uint64_t expirator_overdue_count(void);
+
 #endif  //_UNVERIFIED_EXPIRATOR_H_INCLUDED_
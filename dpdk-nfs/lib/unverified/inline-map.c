@@ -0,0 +1,259 @@
+#include "inline-map.h"
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif  // __SSE2__
+
+#include "../verified/vigor-alloc.h"
+
+// Same bucket layout as map-bucketized.c: the busy bits, hash tags and values
+// of 8 slots share a cache line with a chain counter, which counts the keys
+// that had to probe past the bucket. Keys of the bucket are in a parallel
+// array, INLINE_MAP_MAX_KEY_SIZE bytes per slot.
+#define INLINE_MAP_BUCKET_SLOTS 8
+#define INLINE_MAP_BUCKET_FULL \
+  ((uint8_t)((1 << INLINE_MAP_BUCKET_SLOTS) - 1))
+
+struct inline_map_bucket {
+  uint32_t chain;
+  uint8_t busy;  // bit n set if slot n holds a key
+  uint16_t tags[INLINE_MAP_BUCKET_SLOTS] __attribute__((aligned(16)));
+  int values[INLINE_MAP_BUCKET_SLOTS];
+} __attribute__((aligned(64)));
+
+_Static_assert(sizeof(struct inline_map_bucket) == 64,
+               "A bucket must fill exactly one cache line");
+
+// Keys are zero-padded, so that they can always be compared as a whole
+struct inline_map_key {
+  uint64_t words[INLINE_MAP_MAX_KEY_SIZE / sizeof(uint64_t)];
+} __attribute__((aligned(INLINE_MAP_MAX_KEY_SIZE)));
+
+struct InlineMap {
+  struct inline_map_bucket *buckets;
+  struct inline_map_key *keys;  // INLINE_MAP_BUCKET_SLOTS per bucket
+  int *positions;               // slot of every value, -1 if not mapped
+  unsigned bucket_mask;
+  unsigned key_size;
+  unsigned key_words;  // words of the key that are not padding
+  unsigned capacity;
+  unsigned size;
+};
+
+static inline void key_load(struct InlineMap *map, const void *key,
+                            struct inline_map_key *out) {
+  memset(out, 0, sizeof(struct inline_map_key));
+  memcpy(out, key, map->key_size);
+}
+
+static inline unsigned key_hash(struct InlineMap *map,
+                                const struct inline_map_key *key) {
+  uint64_t hash = 0;
+  for (unsigned n = 0; n < map->key_words; n++) {
+#ifdef __SSE4_2__
+    hash = __builtin_ia32_crc32di(hash, key->words[n]);
+#else   // __SSE4_2__
+    hash = (hash ^ key->words[n]) * 0x9e3779b97f4a7c15ULL;
+    hash ^= hash >> 32;
+#endif  // __SSE4_2__
+  }
+  return hash;
+}
+
+static inline int key_equal(const struct inline_map_key *a,
+                            const struct inline_map_key *b) {
+#ifdef __SSE2__
+  const __m128i *va = (const __m128i *)a;
+  const __m128i *vb = (const __m128i *)b;
+  __m128i low = _mm_cmpeq_epi8(_mm_load_si128(&va[0]), _mm_load_si128(&vb[0]));
+  __m128i high =
+      _mm_cmpeq_epi8(_mm_load_si128(&va[1]), _mm_load_si128(&vb[1]));
+  return _mm_movemask_epi8(_mm_and_si128(low, high)) == 0xffff;
+#else   // __SSE2__
+  return memcmp(a, b, sizeof(struct inline_map_key)) == 0;
+#endif  // __SSE2__
+}
+
+// The low bits of the hash pick the bucket, the high ones are the tag
+static inline uint16_t hash_tag(unsigned hash) { return hash >> 16; }
+
+// Busy slots of the bucket whose tag matches
+static inline unsigned bucket_match(struct inline_map_bucket *bucket,
+                                    uint16_t tag) {
+#ifdef __SSE2__
+  __m128i tags = _mm_load_si128((__m128i *)bucket->tags);
+  __m128i equal = _mm_cmpeq_epi16(tags, _mm_set1_epi16(tag));
+  unsigned matches =
+      _mm_movemask_epi8(_mm_packs_epi16(equal, _mm_setzero_si128()));
+#else   // __SSE2__
+  unsigned matches = 0;
+  for (unsigned slot = 0; slot < INLINE_MAP_BUCKET_SLOTS; slot++) {
+    matches |= (unsigned)(bucket->tags[slot] == tag) << slot;
+  }
+#endif  // __SSE2__
+  return matches & bucket->busy;
+}
+
+// @returns the slot of the key, or -1 if it is not in the map
+static int find_key(struct InlineMap *map, const struct inline_map_key *key,
+                    unsigned hash) {
+  uint16_t tag = hash_tag(hash);
+  unsigned index = hash & map->bucket_mask;
+  for (unsigned distance = 0; distance <= map->bucket_mask; distance++) {
+    struct inline_map_bucket *bucket = &map->buckets[index];
+    unsigned matches = bucket_match(bucket, tag);
+    while (matches != 0) {
+      int position = index * INLINE_MAP_BUCKET_SLOTS + __builtin_ctz(matches);
+      if (key_equal(&map->keys[position], key)) {
+        return position;
+      }
+      matches &= matches - 1;
+    }
+    if (bucket->chain == 0) {
+      return -1;
+    }
+    index = (index + 1) & map->bucket_mask;
+  }
+  return -1;
+}
+
+static void erase_position(struct InlineMap *map, int position,
+                           unsigned hash) {
+  unsigned key_index = position / INLINE_MAP_BUCKET_SLOTS;
+  struct inline_map_bucket *bucket = &map->buckets[key_index];
+  bucket->busy &= ~(1 << (position % INLINE_MAP_BUCKET_SLOTS));
+  map->positions[bucket->values[position % INLINE_MAP_BUCKET_SLOTS]] = -1;
+
+  // The key no longer probes past the buckets before its own
+  for (unsigned index = hash & map->bucket_mask; index != key_index;
+       index = (index + 1) & map->bucket_mask) {
+    map->buckets[index].chain--;
+  }
+  map->size--;
+}
+
+int inline_map_allocate(unsigned key_size, unsigned capacity,
+                        struct InlineMap **map_out) {
+  if (key_size == 0 || key_size > INLINE_MAP_MAX_KEY_SIZE || capacity == 0) {
+    return 0;
+  }
+
+  // Twice as many slots as needed, so that a full map is only half-full
+  // and probes rarely leave the home bucket
+  unsigned bucket_count = 1;
+  while (bucket_count * INLINE_MAP_BUCKET_SLOTS < 2 * (uint64_t)capacity) {
+    bucket_count *= 2;
+  }
+
+  struct InlineMap *map = vigor_malloc(sizeof(struct InlineMap));
+  if (map == NULL) {
+    return 0;
+  }
+  map->buckets =
+      vigor_malloc(sizeof(struct inline_map_bucket) * bucket_count);
+  if (map->buckets == NULL) {
+    vigor_free(map);
+    return 0;
+  }
+  map->keys = vigor_malloc(sizeof(struct inline_map_key) * bucket_count *
+                           INLINE_MAP_BUCKET_SLOTS);
+  if (map->keys == NULL) {
+    vigor_free(map->buckets);
+    vigor_free(map);
+    return 0;
+  }
+  map->positions = vigor_malloc(sizeof(int) * capacity);
+  if (map->positions == NULL) {
+    vigor_free(map->keys);
+    vigor_free(map->buckets);
+    vigor_free(map);
+    return 0;
+  }
+
+  for (unsigned index = 0; index < bucket_count; index++) {
+    map->buckets[index].chain = 0;
+    map->buckets[index].busy = 0;
+  }
+  for (unsigned value = 0; value < capacity; value++) {
+    map->positions[value] = -1;
+  }
+  map->bucket_mask = bucket_count - 1;
+  map->key_size = key_size;
+  map->key_words = (key_size + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+  map->capacity = capacity;
+  map->size = 0;
+  *map_out = map;
+  return 1;
+}
+
+int inline_map_get(struct InlineMap *map, const void *key, int *value_out) {
+  struct inline_map_key padded;
+  key_load(map, key, &padded);
+  int position = find_key(map, &padded, key_hash(map, &padded));
+  if (position < 0) {
+    return 0;
+  }
+
+  *value_out = map->buckets[position / INLINE_MAP_BUCKET_SLOTS]
+                   .values[position % INLINE_MAP_BUCKET_SLOTS];
+  return 1;
+}
+
+void inline_map_put(struct InlineMap *map, const void *key, int value) {
+  struct inline_map_key padded;
+  key_load(map, key, &padded);
+  unsigned hash = key_hash(map, &padded);
+  unsigned index = hash & map->bucket_mask;
+  while (map->buckets[index].busy == INLINE_MAP_BUCKET_FULL) {
+    map->buckets[index].chain++;
+    index = (index + 1) & map->bucket_mask;
+  }
+
+  struct inline_map_bucket *bucket = &map->buckets[index];
+  unsigned slot = __builtin_ctz(~bucket->busy);
+  int position = index * INLINE_MAP_BUCKET_SLOTS + slot;
+  bucket->busy |= 1 << slot;
+  bucket->tags[slot] = hash_tag(hash);
+  bucket->values[slot] = value;
+  map->keys[position] = padded;
+  map->positions[value] = position;
+  map->size++;
+}
+
+void inline_map_erase(struct InlineMap *map, const void *key) {
+  struct inline_map_key padded;
+  key_load(map, key, &padded);
+  unsigned hash = key_hash(map, &padded);
+  erase_position(map, find_key(map, &padded, hash), hash);
+}
+
+void inline_map_erase_value(struct InlineMap *map, int value) {
+  int position = map->positions[value];
+  erase_position(map, position, key_hash(map, &map->keys[position]));
+}
+
+const void *inline_map_get_key(struct InlineMap *map, int value) {
+  return &map->keys[map->positions[value]];
+}
+
+unsigned inline_map_size(struct InlineMap *map) { return map->size; }
+
+void inline_map_prefetch(struct InlineMap *map, const void *key) {
+  struct inline_map_key padded;
+  key_load(map, key, &padded);
+  __builtin_prefetch(
+      &map->buckets[key_hash(map, &padded) & map->bucket_mask]);
+}
+
+int inline_map_expire(struct DoubleChain *chain, struct InlineMap *map,
+                      vigor_time_t time) {
+  int count = 0;
+  int index = -1;
+  while (dchain_expire_one_index(chain, &index, time)) {
+    inline_map_erase_value(map, index);
+    ++count;
+  }
+  return count;
+}
@@ -0,0 +1,64 @@
+#ifndef _UNVERIFIED_INLINE_MAP_H_INCLUDED_
+#define _UNVERIFIED_INLINE_MAP_H_INCLUDED_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../verified/double-chain.h"
+#include "../verified/vigor-time.h"
+
+// Unverified map that keeps fixed-size keys inline, in its own table, instead
+// of pointing to keys in a separate vector like lib/verified/map.h.
+// Keys are compared bytewise with SIMD instead of through map_keys_equality,
+// and hashed by the map itself, so NFs need neither a key vector nor
+// eq/hash callbacks.
+//
+// Values are indexes in [0, capacity), each mapped by at most one key, which
+// is how NFs use dchain indexes; that lets the map look keys up by value,
+// e.g. to expire them.
+// There is no symbex model for it, so verified NFs cannot use it.
+
+#define INLINE_MAP_MAX_KEY_SIZE 32
+
+// Size of a key made of the fields of a struct up to and including the given
+// one, which excludes its trailing padding; padding between fields must be
+// zeroed by the NF, since it is compared too.
+#define INLINE_MAP_KEY_SIZE(type, last_field) \
+  (offsetof(type, last_field) + sizeof(((type *)0)->last_field))
+
+struct InlineMap;
+
+// @param key_size - Bytes of every key, at most INLINE_MAP_MAX_KEY_SIZE.
+// @returns 1 on success, 0 otherwise.
+int inline_map_allocate(unsigned key_size, unsigned capacity,
+                        struct InlineMap **map_out);
+
+// @returns 1 and the key's value if the key is in the map, 0 otherwise.
+int inline_map_get(struct InlineMap *map, const void *key, int *value_out);
+
+// Copies the key into the map. The key must not be in the map, and the value
+// must not be mapped yet.
+void inline_map_put(struct InlineMap *map, const void *key, int value);
+
+// The key must be in the map.
+void inline_map_erase(struct InlineMap *map, const void *key);
+
+// Removes the key mapped to the given value, which must be mapped.
+void inline_map_erase_value(struct InlineMap *map, int value);
+
+// @returns the key mapped to the given value, which must be mapped; valid
+// until that key is erased.
+const void *inline_map_get_key(struct InlineMap *map, int value);
+
+unsigned inline_map_size(struct InlineMap *map);
+
+// Prefetches the bucket where a lookup of the key starts.
+void inline_map_prefetch(struct InlineMap *map, const void *key);
+
+// Like expire_items_single_map, without the vector: erases the keys mapped
+// to the indexes that expire from the chain.
+// @returns the number of expired items.
+int inline_map_expire(struct DoubleChain *chain, struct InlineMap *map,
+                      vigor_time_t time);
+
+#endif  //_UNVERIFIED_INLINE_MAP_H_INCLUDED_
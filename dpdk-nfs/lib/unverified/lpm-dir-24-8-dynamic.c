@@ -0,0 +1,382 @@
+#ifdef VIGOR_LPM_DYNAMIC
+
+// Unverified implementation of lpm-dir-24-8.h, built with LPM_LAYOUT=dynamic
+// instead of lib/verified/lpm-dir-24-8.c.
+// The verified table only knows the value of its entries, so rules must be
+// added shortest first, cannot be removed, and at most lpm_LONG_OFFSET_MAX
+// /24s may have longer rules.
+// Here, entries are 32 bits and also hold the prefix length of the rule they
+// come from, so that a rule only overwrites the entries of shorter rules,
+// in any order; the rules themselves are kept in a hash table, so that
+// deleting one restores the next longest rule in its entries.
+// Groups of lpm_LONG_FACTOR entries for /24s with longer rules are
+// allocated from a pool of LPM_LONG_GROUPS, and freed once all their entries
+// are equal again and come from rules of at most 24 bits.
+//
+// Entries are:
+//   bit31: valid
+//   bit30: 1->index of a group in lpm_long, 0->next hop
+//   bit29-24: prefix length of the rule (next hops only)
+//   bit23-0: next hop or group index
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif  // __AVX2__
+
+#include "../verified/lpm-dir-24-8.h"
+#include "../verified/vigor-alloc.h"
+
+// 8192 groups take 8MB
+#ifndef LPM_LONG_GROUPS
+#define LPM_LONG_GROUPS (1 << 13)
+#endif  // LPM_LONG_GROUPS
+
+// Enough for a full BGP table; the rule table takes 16 bytes per rule
+#ifndef LPM_MAX_RULES
+#define LPM_MAX_RULES (1 << 20)
+#endif  // LPM_MAX_RULES
+
+// Gathers index the second level with signed 32-bit integers
+_Static_assert(LPM_LONG_GROUPS <= (1 << 23), "Too many groups");
+_Static_assert((LPM_MAX_RULES & (LPM_MAX_RULES - 1)) == 0,
+               "The number of rules must be a power of 2");
+
+// The rule table is at most half full
+#define RULE_SLOTS (2 * LPM_MAX_RULES)
+
+#define ENTRY_VALID 0x80000000u
+#define ENTRY_GROUP 0x40000000u
+#define ENTRY_PLEN_SHIFT 24
+#define ENTRY_PLEN_MASK 0x3F
+#define ENTRY_VALUE_MASK 0xFFFFFF
+
+struct lpm_rule {
+  uint32_t prefix;  // masked
+  uint16_t value;
+  uint8_t prefixlen;
+  uint8_t busy;
+};
+
+struct lpm {
+  uint32_t *lpm_24;
+  uint32_t *lpm_long;  // LPM_LONG_GROUPS groups of lpm_LONG_FACTOR entries
+  uint32_t *free_groups;
+  uint32_t free_group_count;
+  struct lpm_rule *rules;  // linear probing over RULE_SLOTS
+  uint32_t rule_count;
+};
+
+static inline uint32_t prefix_mask(uint8_t prefixlen) {
+  return prefixlen == 0 ? 0 : 0xFFFFFFFFu << (lpm_PLEN_MAX - prefixlen);
+}
+
+static inline uint32_t entry_of_rule(struct lpm_rule *rule) {
+  if (rule == NULL) {
+    return 0;
+  }
+  return ENTRY_VALID | (uint32_t)rule->prefixlen << ENTRY_PLEN_SHIFT |
+         rule->value;
+}
+
+static inline bool entry_is_group(uint32_t entry) {
+  return (entry & ENTRY_GROUP) != 0;
+}
+
+static inline uint8_t entry_prefixlen(uint32_t entry) {
+  return (entry >> ENTRY_PLEN_SHIFT) & ENTRY_PLEN_MASK;
+}
+
+static inline uint32_t *group_entries(struct lpm *_lpm, uint32_t entry) {
+  return &_lpm->lpm_long[(entry & ENTRY_VALUE_MASK) * lpm_LONG_FACTOR];
+}
+
+static inline uint32_t rule_home(uint32_t prefix, uint8_t prefixlen) {
+  return __builtin_ia32_crc32si(prefixlen, prefix) & (RULE_SLOTS - 1);
+}
+
+static struct lpm_rule *rule_find(struct lpm *_lpm, uint32_t prefix,
+                                  uint8_t prefixlen) {
+  for (uint32_t slot = rule_home(prefix, prefixlen);;
+       slot = (slot + 1) & (RULE_SLOTS - 1)) {
+    struct lpm_rule *rule = &_lpm->rules[slot];
+    if (!rule->busy) {
+      return NULL;
+    }
+    if (rule->prefix == prefix && rule->prefixlen == prefixlen) {
+      return rule;
+    }
+  }
+}
+
+static void rule_insert(struct lpm *_lpm, uint32_t prefix, uint8_t prefixlen,
+                        uint16_t value) {
+  uint32_t slot = rule_home(prefix, prefixlen);
+  while (_lpm->rules[slot].busy) {
+    slot = (slot + 1) & (RULE_SLOTS - 1);
+  }
+  _lpm->rules[slot].prefix = prefix;
+  _lpm->rules[slot].value = value;
+  _lpm->rules[slot].prefixlen = prefixlen;
+  _lpm->rules[slot].busy = 1;
+  _lpm->rule_count++;
+}
+
+// Backward-shift deletion: rules after the hole move into it if that does not
+// put them before their home slot
+static void rule_remove(struct lpm *_lpm, struct lpm_rule *rule) {
+  uint32_t hole = rule - _lpm->rules;
+  for (uint32_t slot = (hole + 1) & (RULE_SLOTS - 1); _lpm->rules[slot].busy;
+       slot = (slot + 1) & (RULE_SLOTS - 1)) {
+    struct lpm_rule *next = &_lpm->rules[slot];
+    uint32_t home = rule_home(next->prefix, next->prefixlen);
+    if (((slot - home) & (RULE_SLOTS - 1)) >=
+        ((slot - hole) & (RULE_SLOTS - 1))) {
+      _lpm->rules[hole] = *next;
+      hole = slot;
+    }
+  }
+  _lpm->rules[hole].busy = 0;
+  _lpm->rule_count--;
+}
+
+// The longest rule shorter than prefixlen that covers the prefix, if any
+static struct lpm_rule *rule_find_parent(struct lpm *_lpm, uint32_t prefix,
+                                         uint8_t prefixlen) {
+  for (int len = prefixlen - 1; len >= 0; len--) {
+    struct lpm_rule *rule = rule_find(_lpm, prefix & prefix_mask(len), len);
+    if (rule != NULL) {
+      return rule;
+    }
+  }
+  return NULL;
+}
+
+// Sets the entries that do not come from a longer rule
+static void entries_add(uint32_t *entries, uint32_t count, uint32_t entry,
+                        uint8_t prefixlen) {
+  for (uint32_t i = 0; i < count; i++) {
+    if ((entries[i] & ENTRY_VALID) == 0 ||
+        entry_prefixlen(entries[i]) <= prefixlen) {
+      entries[i] = entry;
+    }
+  }
+}
+
+// Sets the entries that come from the rule of that prefixlen
+static void entries_replace(uint32_t *entries, uint32_t count, uint32_t entry,
+                            uint8_t prefixlen) {
+  for (uint32_t i = 0; i < count; i++) {
+    if ((entries[i] & ENTRY_VALID) != 0 &&
+        entry_prefixlen(entries[i]) == prefixlen) {
+      entries[i] = entry;
+    }
+  }
+}
+
+// Frees the group of the first-level entry if all its entries are equal and
+// none comes from a rule longer than /24, which needs the group to be deleted
+static void group_try_free(struct lpm *_lpm, uint32_t lpm_24_index) {
+  uint32_t *entries = group_entries(_lpm, _lpm->lpm_24[lpm_24_index]);
+  if ((entries[0] & ENTRY_VALID) != 0 &&
+      entry_prefixlen(entries[0]) > lpm_24_PLEN_MAX) {
+    return;
+  }
+  for (uint32_t i = 1; i < lpm_LONG_FACTOR; i++) {
+    if (entries[i] != entries[0]) {
+      return;
+    }
+  }
+  _lpm->free_groups[_lpm->free_group_count] =
+      _lpm->lpm_24[lpm_24_index] & ENTRY_VALUE_MASK;
+  _lpm->free_group_count++;
+  _lpm->lpm_24[lpm_24_index] = entries[0];
+}
+
+int lpm_allocate(struct lpm **lpm_out) {
+  struct lpm *_lpm = (struct lpm *)vigor_malloc(sizeof(struct lpm));
+  if (_lpm == NULL) {
+    return 0;
+  }
+  _lpm->lpm_24 = vigor_malloc(sizeof(uint32_t) * lpm_24_MAX_ENTRIES);
+  _lpm->lpm_long =
+      vigor_malloc(sizeof(uint32_t) * LPM_LONG_GROUPS * lpm_LONG_FACTOR);
+  _lpm->free_groups = vigor_malloc(sizeof(uint32_t) * LPM_LONG_GROUPS);
+  _lpm->rules = vigor_malloc(sizeof(struct lpm_rule) * RULE_SLOTS);
+  if (_lpm->lpm_24 == NULL || _lpm->lpm_long == NULL ||
+      _lpm->free_groups == NULL || _lpm->rules == NULL) {
+    vigor_free(_lpm->rules);
+    vigor_free(_lpm->free_groups);
+    vigor_free(_lpm->lpm_long);
+    vigor_free(_lpm->lpm_24);
+    vigor_free(_lpm);
+    return 0;
+  }
+
+  memset(_lpm->lpm_24, 0, sizeof(uint32_t) * lpm_24_MAX_ENTRIES);
+  memset(_lpm->rules, 0, sizeof(struct lpm_rule) * RULE_SLOTS);
+  // Hand out low groups first
+  for (uint32_t group = 0; group < LPM_LONG_GROUPS; group++) {
+    _lpm->free_groups[group] = LPM_LONG_GROUPS - 1 - group;
+  }
+  _lpm->free_group_count = LPM_LONG_GROUPS;
+  _lpm->rule_count = 0;
+  *lpm_out = _lpm;
+  return 1;
+}
+
+void lpm_free(struct lpm *_lpm) {
+  vigor_free(_lpm->rules);
+  vigor_free(_lpm->free_groups);
+  vigor_free(_lpm->lpm_long);
+  vigor_free(_lpm->lpm_24);
+  vigor_free(_lpm);
+}
+
+int lpm_lookup_elem(struct lpm *_lpm, uint32_t prefix) {
+  uint32_t entry = _lpm->lpm_24[prefix >> BYTE_SIZE];
+  if (entry_is_group(entry)) {
+    entry = group_entries(_lpm, entry)[prefix & 0xFF];
+  }
+  return (entry & ENTRY_VALID) != 0 ? (uint16_t)entry : INVALID;
+}
+
+// With AVX2, 8 addresses at a time: one gather for their first-level
+// entries, then one for the second-level entries of those that have a group
+void lpm_lookup_bulk(struct lpm *_lpm, const uint32_t *prefixes,
+                     uint16_t *values_out, unsigned n) {
+  unsigned i = 0;
+#ifdef __AVX2__
+  const __m256i group_flag = _mm256_set1_epi32(ENTRY_GROUP);
+  const __m256i value_mask = _mm256_set1_epi32(ENTRY_VALUE_MASK);
+  const __m256i byte_mask = _mm256_set1_epi32(0xFF);
+  const __m256i invalid = _mm256_set1_epi32(INVALID);
+  for (; i + 8 <= n; i += 8) {
+    __m256i addresses = _mm256_loadu_si256((const __m256i *)&prefixes[i]);
+    __m256i entries = _mm256_i32gather_epi32(
+        (const int *)_lpm->lpm_24, _mm256_srli_epi32(addresses, BYTE_SIZE),
+        sizeof(uint32_t));
+    __m256i in_group = _mm256_cmpeq_epi32(
+        _mm256_and_si256(entries, group_flag), group_flag);
+    if (!_mm256_testz_si256(in_group, in_group)) {
+      __m256i long_indexes = _mm256_add_epi32(
+          _mm256_slli_epi32(_mm256_and_si256(entries, value_mask), 8),
+          _mm256_and_si256(addresses, byte_mask));
+      entries = _mm256_mask_i32gather_epi32(
+          entries, (const int *)_lpm->lpm_long, long_indexes, in_group,
+          sizeof(uint32_t));
+    }
+    // Sign-extending the valid bit selects the value or INVALID
+    __m256i valid = _mm256_srai_epi32(entries, 31);
+    __m256i values = _mm256_blendv_epi8(
+        invalid, _mm256_and_si256(entries, _mm256_set1_epi32(0xFFFF)), valid);
+    _mm_storeu_si128((__m128i *)&values_out[i],
+                     _mm_packus_epi32(_mm256_castsi256_si128(values),
+                                      _mm256_extracti128_si256(values, 1)));
+  }
+#endif  // __AVX2__
+  for (; i < n; i++) {
+    values_out[i] = lpm_lookup_elem(_lpm, prefixes[i]);
+  }
+}
+
+int lpm_update_elem(struct lpm *_lpm, uint32_t prefix, uint8_t prefixlen,
+                    uint16_t value) {
+  if (prefixlen > lpm_PLEN_MAX || value > MAX_NEXT_HOP_VALUE) {
+    return 0;
+  }
+
+  prefix &= prefix_mask(prefixlen);
+  struct lpm_rule *rule = rule_find(_lpm, prefix, prefixlen);
+  if (rule == NULL && _lpm->rule_count == LPM_MAX_RULES) {
+    return 0;
+  }
+
+  uint32_t entry = ENTRY_VALID |
+                   (uint32_t)prefixlen << ENTRY_PLEN_SHIFT | value;
+  if (prefixlen <= lpm_24_PLEN_MAX) {
+    uint32_t first_index = prefix >> BYTE_SIZE;
+    uint32_t last_index =
+        first_index + (1u << (lpm_24_PLEN_MAX - prefixlen));
+    for (uint32_t index = first_index; index < last_index; index++) {
+      uint32_t current = _lpm->lpm_24[index];
+      if (entry_is_group(current)) {
+        entries_add(group_entries(_lpm, current), lpm_LONG_FACTOR, entry,
+                    prefixlen);
+      } else if ((current & ENTRY_VALID) == 0 ||
+                 entry_prefixlen(current) <= prefixlen) {
+        _lpm->lpm_24[index] = entry;
+      }
+    }
+  } else {
+    uint32_t lpm_24_index = prefix >> BYTE_SIZE;
+    uint32_t current = _lpm->lpm_24[lpm_24_index];
+    if (!entry_is_group(current)) {
+      if (_lpm->free_group_count == 0) {
+        return 0;
+      }
+      _lpm->free_group_count--;
+      uint32_t group = _lpm->free_groups[_lpm->free_group_count];
+      // The group starts as a copy of the first-level entry
+      uint32_t *entries = &_lpm->lpm_long[group * lpm_LONG_FACTOR];
+      for (uint32_t i = 0; i < lpm_LONG_FACTOR; i++) {
+        entries[i] = current;
+      }
+      current = ENTRY_VALID | ENTRY_GROUP | group;
+      _lpm->lpm_24[lpm_24_index] = current;
+    }
+    entries_add(group_entries(_lpm, current) + (prefix & 0xFF),
+                1u << (lpm_PLEN_MAX - prefixlen), entry, prefixlen);
+  }
+
+  if (rule == NULL) {
+    rule_insert(_lpm, prefix, prefixlen, value);
+  } else {
+    rule->value = value;
+  }
+  return 1;
+}
+
+int lpm_delete_elem(struct lpm *_lpm, uint32_t prefix, uint8_t prefixlen) {
+  if (prefixlen > lpm_PLEN_MAX) {
+    return 0;
+  }
+
+  prefix &= prefix_mask(prefixlen);
+  struct lpm_rule *rule = rule_find(_lpm, prefix, prefixlen);
+  if (rule == NULL) {
+    return 0;
+  }
+  rule_remove(_lpm, rule);
+  uint32_t entry =
+      entry_of_rule(rule_find_parent(_lpm, prefix, prefixlen));
+
+  if (prefixlen <= lpm_24_PLEN_MAX) {
+    uint32_t first_index = prefix >> BYTE_SIZE;
+    uint32_t last_index =
+        first_index + (1u << (lpm_24_PLEN_MAX - prefixlen));
+    for (uint32_t index = first_index; index < last_index; index++) {
+      uint32_t current = _lpm->lpm_24[index];
+      if (entry_is_group(current)) {
+        entries_replace(group_entries(_lpm, current), lpm_LONG_FACTOR, entry,
+                        prefixlen);
+        group_try_free(_lpm, index);
+      } else if ((current & ENTRY_VALID) != 0 &&
+                 entry_prefixlen(current) == prefixlen) {
+        _lpm->lpm_24[index] = entry;
+      }
+    }
+  } else {
+    uint32_t lpm_24_index = prefix >> BYTE_SIZE;
+    entries_replace(
+        group_entries(_lpm, _lpm->lpm_24[lpm_24_index]) + (prefix & 0xFF),
+        1u << (lpm_PLEN_MAX - prefixlen), entry, prefixlen);
+    group_try_free(_lpm, lpm_24_index);
+  }
+  return 1;
+}
+
+#endif  // VIGOR_LPM_DYNAMIC
@@ -0,0 +1,246 @@
+#ifdef VIGOR_MAP_BUCKETIZED
+
+// Unverified implementation of map.h, built with MAP_LAYOUT=bucketized
+// instead of lib/verified/map.c.
+// The verified map keeps busy bits, hashes, chain counters, key pointers and
+// values in five parallel arrays, so a probe touches up to five cache lines.
+// Here, the busy bits, hash tags and values of MAP_BUCKET_SLOTS slots share
+// one cache line with a chain counter, so a lookup touches that line, plus
+// the key pointers of the slots whose tag matches.
+// Probing is linear over buckets; as in the verified map, the chain counter
+// of a bucket counts the keys that had to probe past it, so a lookup can stop
+// at the first bucket without any.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif  // __SSE2__
+
+#include "../verified/map.h"
+#include "../verified/vigor-alloc.h"
+
+#ifdef VIGOR_TELEMETRY
+#include "telemetry.h"
+#endif  // VIGOR_TELEMETRY
+
+#define MAP_BUCKET_SLOTS 8
+#define MAP_BUCKET_FULL ((uint8_t)((1 << MAP_BUCKET_SLOTS) - 1))
+
+struct map_bucket {
+  uint32_t chain;
+  uint8_t busy;  // bit n set if slot n holds a key
+  uint16_t tags[MAP_BUCKET_SLOTS] __attribute__((aligned(16)));
+  int values[MAP_BUCKET_SLOTS];
+} __attribute__((aligned(64)));
+
+_Static_assert(sizeof(struct map_bucket) == 64,
+               "A bucket must fill exactly one cache line");
+
+struct Map {
+  struct map_bucket* buckets;
+  void** keyps;  // MAP_BUCKET_SLOTS per bucket
+  unsigned bucket_mask;
+  unsigned capacity;
+  unsigned size;
+  map_keys_equality* keys_eq;
+  map_key_hash* khash;
+};
+
+// The low bits of the hash pick the bucket, the high ones are the tag
+static inline uint16_t hash_tag(unsigned hash) { return hash >> 16; }
+
+// Busy slots of the bucket whose tag matches
+static inline unsigned bucket_match(struct map_bucket* bucket, uint16_t tag) {
+#ifdef __SSE2__
+  __m128i tags = _mm_load_si128((__m128i*)bucket->tags);
+  __m128i equal = _mm_cmpeq_epi16(tags, _mm_set1_epi16(tag));
+  unsigned matches =
+      _mm_movemask_epi8(_mm_packs_epi16(equal, _mm_setzero_si128()));
+#else   // __SSE2__
+  unsigned matches = 0;
+  for (unsigned slot = 0; slot < MAP_BUCKET_SLOTS; slot++) {
+    matches |= (unsigned)(bucket->tags[slot] == tag) << slot;
+  }
+#endif  // __SSE2__
+  return matches & bucket->busy;
+}
+
+// Looks for the key; returns its slot, or -1 if it is not in the map.
+// Also returns the number of buckets probed before the key's one.
+static int find_key(struct Map* map, void* key, unsigned hash,
+                    unsigned* distance_out) {
+  uint16_t tag = hash_tag(hash);
+  unsigned index = hash & map->bucket_mask;
+  for (unsigned distance = 0; distance <= map->bucket_mask; distance++) {
+    struct map_bucket* bucket = &map->buckets[index];
+    unsigned matches = bucket_match(bucket, tag);
+    while (matches != 0) {
+      unsigned slot = __builtin_ctz(matches);
+      int position = index * MAP_BUCKET_SLOTS + slot;
+      if (map->keys_eq(map->keyps[position], key)) {
+        *distance_out = distance;
+        return position;
+      }
+      matches &= matches - 1;
+    }
+    if (bucket->chain == 0) {
+      return -1;
+    }
+    index = (index + 1) & map->bucket_mask;
+  }
+  return -1;
+}
+
+int map_allocate(map_keys_equality* keq, map_key_hash* khash,
+                 unsigned capacity, struct Map** map_out) {
+  if (capacity == 0) {
+    return 0;
+  }
+
+  // Twice as many slots as needed, so that a full map is only half-full
+  // and probes rarely leave the home bucket
+  unsigned bucket_count = 1;
+  while (bucket_count * MAP_BUCKET_SLOTS < 2 * (uint64_t)capacity) {
+    bucket_count *= 2;
+  }
+
+  struct Map* map = vigor_malloc(sizeof(struct Map));
+  if (map == NULL) {
+    return 0;
+  }
+  map->buckets = vigor_malloc(sizeof(struct map_bucket) * bucket_count);
+  if (map->buckets == NULL) {
+    vigor_free(map);
+    return 0;
+  }
+  map->keyps = vigor_malloc(sizeof(void*) * bucket_count * MAP_BUCKET_SLOTS);
+  if (map->keyps == NULL) {
+    vigor_free(map->buckets);
+    vigor_free(map);
+    return 0;
+  }
+
+  for (unsigned index = 0; index < bucket_count; index++) {
+    map->buckets[index].chain = 0;
+    map->buckets[index].busy = 0;
+  }
+  map->bucket_mask = bucket_count - 1;
+  map->capacity = capacity;
+  map->size = 0;
+  map->keys_eq = keq;
+  map->khash = khash;
+  *map_out = map;
+#ifdef VIGOR_TELEMETRY
+  telemetry_add_map(map, capacity);
+#endif  // VIGOR_TELEMETRY
+  return 1;
+}
+
+int map_get(struct Map* map, void* key, int* value_out) {
+  return map_get_with_hash(map, key, map->khash(key), value_out);
+}
+
+int map_get_with_hash(struct Map* map, void* key, unsigned hash,
+                      int* value_out) {
+  unsigned distance;
+  int position = find_key(map, key, hash, &distance);
+  if (position < 0) {
+    return 0;
+  }
+
+  *value_out = map->buckets[position / MAP_BUCKET_SLOTS]
+                   .values[position % MAP_BUCKET_SLOTS];
+  return 1;
+}
+
+// Same contract as the verified map: the key must not be in the map,
+// and the map must not be full
+void map_put(struct Map* map, void* key, int value) {
+  map_put_with_hash(map, key, map->khash(key), value);
+}
+
+void map_put_with_hash(struct Map* map, void* key, unsigned hash, int value) {
+  unsigned index = hash & map->bucket_mask;
+  while (map->buckets[index].busy == MAP_BUCKET_FULL) {
+    map->buckets[index].chain++;
+    index = (index + 1) & map->bucket_mask;
+  }
+
+  struct map_bucket* bucket = &map->buckets[index];
+  unsigned slot = __builtin_ctz(~bucket->busy);
+  bucket->busy |= 1 << slot;
+  bucket->tags[slot] = hash_tag(hash);
+  bucket->values[slot] = value;
+  map->keyps[index * MAP_BUCKET_SLOTS + slot] = key;
+  map->size++;
+}
+
+// Same contract as the verified map: the key must be in the map
+void map_erase(struct Map* map, void* key, void** trash) {
+  unsigned hash = map->khash(key);
+  unsigned distance;
+  int position = find_key(map, key, hash, &distance);
+
+  struct map_bucket* bucket = &map->buckets[position / MAP_BUCKET_SLOTS];
+  bucket->busy &= ~(1 << (position % MAP_BUCKET_SLOTS));
+  *trash = map->keyps[position];
+
+  // The key no longer probes past the buckets before its own
+  unsigned index = hash & map->bucket_mask;
+  for (unsigned n = 0; n < distance; n++) {
+    map->buckets[index].chain--;
+    index = (index + 1) & map->bucket_mask;
+  }
+  map->size--;
+}
+
+unsigned map_size(struct Map* map) { return map->size; }
+
+unsigned map_prefetch(struct Map* map, void* key) {
+  unsigned hash = map->khash(key);
+  map_prefetch_with_hash(map, hash);
+  return hash;
+}
+
+void map_prefetch_with_hash(struct Map* map, unsigned hash) {
+  __builtin_prefetch(&map->buckets[hash & map->bucket_mask]);
+}
+
+// Most keys are resolved in their home bucket, so the rounds are simpler
+// than in the verified map: one to prefetch the home buckets, one to
+// prefetch the keys whose tag matches there, and one to look keys up
+unsigned map_get_bulk(struct Map* map, void** keys, unsigned* hashes,
+                      unsigned n, int* values_out, uint64_t* hit_mask) {
+  for (unsigned i = 0; i < n; i++) {
+    hashes[i] = map->khash(keys[i]);
+    __builtin_prefetch(&map->buckets[hashes[i] & map->bucket_mask]);
+  }
+
+  for (unsigned i = 0; i < n; i++) {
+    unsigned index = hashes[i] & map->bucket_mask;
+    unsigned matches =
+        bucket_match(&map->buckets[index], hash_tag(hashes[i]));
+    for (; matches != 0; matches &= matches - 1) {
+      __builtin_prefetch(
+          map->keyps[index * MAP_BUCKET_SLOTS + __builtin_ctz(matches)]);
+    }
+  }
+
+  uint64_t hits = 0;
+  for (unsigned i = 0; i < n; i++) {
+    unsigned distance;
+    int position = find_key(map, keys[i], hashes[i], &distance);
+    if (position >= 0) {
+      values_out[i] = map->buckets[position / MAP_BUCKET_SLOTS]
+                          .values[position % MAP_BUCKET_SLOTS];
+      hits |= 1ULL << i;
+    }
+  }
+
+  *hit_mask = hits;
+  return __builtin_popcountll(hits);
+}
+
+#endif  // VIGOR_MAP_BUCKETIZED
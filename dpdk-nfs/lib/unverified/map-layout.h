@@ -0,0 +1,49 @@
+#ifndef _UNVERIFIED_MAP_LAYOUT_H_INCLUDED_
+#define _UNVERIFIED_MAP_LAYOUT_H_INCLUDED_
+
+#include <stddef.h>
+#include <string.h>
+
+#include "../verified/map.h"
+
+// Same layout as struct Map in lib/verified/map.c, which checks it.
+// The fields are copied in and out with memcpy rather than by casting the
+// struct Map pointer, which would break strict aliasing; the copies compile
+// to plain loads and stores of the fields that are used.
+struct map_layout {
+  int* busybits;
+  void** keyps;
+  unsigned* khs;
+  int* chns;
+  int* vals;
+  unsigned capacity;
+  unsigned size;
+  map_keys_equality* keys_eq;
+  map_key_hash* khash;
+};
+
+static inline void map_layout_load(struct Map* map, struct map_layout* layout) {
+  memcpy(layout, map, sizeof(*layout));
+}
+
+static inline void map_layout_store_size(struct Map* map,
+                                         const struct map_layout* layout) {
+  memcpy((char*)map + offsetof(struct map_layout, size), &layout->size,
+         sizeof(layout->size));
+}
+
+static inline unsigned map_layout_start(const struct map_layout* layout,
+                                        unsigned hash) {
+#ifdef CAPACITY_POW2
+  return hash & (layout->capacity - 1);
+#else
+  return hash % layout->capacity;
+#endif
+}
+
+static inline unsigned map_layout_next(const struct map_layout* layout,
+                                       unsigned index) {
+  return index + 1 == layout->capacity ? 0 : index + 1;
+}
+
+#endif  //_UNVERIFIED_MAP_LAYOUT_H_INCLUDED_
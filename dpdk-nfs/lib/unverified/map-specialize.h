@@ -0,0 +1,169 @@
+#ifndef _UNVERIFIED_MAP_SPECIALIZE_H_INCLUDED_
+#define _UNVERIFIED_MAP_SPECIALIZE_H_INCLUDED_
+
+#include "../verified/map.h"
+#include "map-layout.h"
+
+// Type-specialized instances of the verified map's get, put and erase.
+// The verified map calls the key hash and equality through function pointers,
+// on every put and on every probe whose hash matches, so they are never
+// inlined. An instance for a key type is stamped out next to the definitions
+// of its hash and equality, which then get inlined into the probing loops:
+//
+//   flow.h: MAP_SPECIALIZE_DECLARE(FlowId, struct FlowId)
+//   flow.c: MAP_SPECIALIZE_DEFINE(FlowId, struct FlowId, FlowId_hash,
+//                                 FlowId_eq)
+//
+// defines FlowId_map_get, FlowId_map_put and FlowId_map_erase, with the same
+// contracts as map_get, map_put and map_erase, on the same struct Map, and
+// outside of symbex FlowId_map_get_with_hash and FlowId_map_put_with_hash.
+// A map allocated with other hash or equality functions falls back to the
+// generic calls. Symbex, MAP_LAYOUT=bucketized and PROFILE builds always use
+// the generic calls, which they respectively model, replace and wrap.
+
+#if defined(KLEE_VERIFICATION) || defined(VIGOR_MAP_BUCKETIZED) || \
+    defined(VIGOR_PROFILE)
+
+#ifdef KLEE_VERIFICATION
+#define MAP_SPECIALIZE_DECLARE_WITH_HASH(prefix, key_type)
+#else  // KLEE_VERIFICATION
+#define MAP_SPECIALIZE_DECLARE_WITH_HASH(prefix, key_type)                  \
+  static inline int prefix##_map_get_with_hash(                             \
+      struct Map* map, key_type* key, unsigned hash, int* value_out) {      \
+    return map_get_with_hash(map, key, hash, value_out);                    \
+  }                                                                         \
+  static inline void prefix##_map_put_with_hash(                            \
+      struct Map* map, key_type* key, unsigned hash, int value) {           \
+    map_put_with_hash(map, key, hash, value);                               \
+  }
+#endif  // KLEE_VERIFICATION
+
+#define MAP_SPECIALIZE_DECLARE(prefix, key_type)                          \
+  static inline int prefix##_map_get(struct Map* map, key_type* key,      \
+                                     int* value_out) {                    \
+    return map_get(map, key, value_out);                                  \
+  }                                                                       \
+  static inline void prefix##_map_put(struct Map* map, key_type* key,     \
+                                      int value) {                        \
+    map_put(map, key, value);                                             \
+  }                                                                       \
+  static inline void prefix##_map_erase(struct Map* map, key_type* key,   \
+                                        void** trash) {                   \
+    map_erase(map, key, trash);                                           \
+  }                                                                       \
+  MAP_SPECIALIZE_DECLARE_WITH_HASH(prefix, key_type)
+
+#define MAP_SPECIALIZE_DEFINE(prefix, key_type, hash, eq)
+
+#else  // KLEE_VERIFICATION || VIGOR_MAP_BUCKETIZED || VIGOR_PROFILE
+
+#define MAP_SPECIALIZE_DECLARE(prefix, key_type)                              \
+  int prefix##_map_get(struct Map* map, key_type* key, int* value_out);       \
+  void prefix##_map_put(struct Map* map, key_type* key, int value);           \
+  void prefix##_map_erase(struct Map* map, key_type* key, void** trash);      \
+  int prefix##_map_get_with_hash(struct Map* map, key_type* key,              \
+                                 unsigned key_hash, int* value_out);          \
+  void prefix##_map_put_with_hash(struct Map* map, key_type* key,             \
+                                  unsigned key_hash, int value);
+
+// The probing follows find_key, find_empty and find_key_remove_chain in
+// lib/verified/map-impl.c
+#define MAP_SPECIALIZE_DEFINE(prefix, key_type, hash, eq)                     \
+  static inline int prefix##_map_find(struct map_layout* layout,              \
+                                      key_type* key, unsigned key_hash,       \
+                                      int* value_out) {                       \
+    unsigned index = map_layout_start(layout, key_hash);                      \
+    for (unsigned i = 0; i < layout->capacity; ++i) {                         \
+      if (layout->busybits[index] != 0 && layout->khs[index] == key_hash) {   \
+        if (eq(layout->keyps[index], key)) {                                  \
+          *value_out = layout->vals[index];                                   \
+          return 1;                                                           \
+        }                                                                     \
+      } else if (layout->chns[index] == 0) {                                  \
+        return 0;                                                             \
+      }                                                                       \
+      index = map_layout_next(layout, index);                                 \
+    }                                                                         \
+    return 0;                                                                 \
+  }                                                                           \
+                                                                              \
+  static inline void prefix##_map_insert(struct map_layout* layout,           \
+                                         key_type* key, unsigned key_hash,    \
+                                         int value) {                         \
+    unsigned index = map_layout_start(layout, key_hash);                      \
+    while (layout->busybits[index] != 0) {                                    \
+      layout->chns[index]++;                                                  \
+      index = map_layout_next(layout, index);                                 \
+    }                                                                         \
+    layout->busybits[index] = 1;                                              \
+    layout->keyps[index] = key;                                               \
+    layout->khs[index] = key_hash;                                            \
+    layout->vals[index] = value;                                              \
+    layout->size++;                                                           \
+  }                                                                           \
+                                                                              \
+  int prefix##_map_get(struct Map* map, key_type* key, int* value_out) {      \
+    struct map_layout layout;                                                 \
+    map_layout_load(map, &layout);                                            \
+    if (layout.khash != hash || layout.keys_eq != eq) {                       \
+      return map_get(map, key, value_out);                                    \
+    }                                                                         \
+    return prefix##_map_find(&layout, key, hash(key), value_out);             \
+  }                                                                           \
+                                                                              \
+  int prefix##_map_get_with_hash(struct Map* map, key_type* key,              \
+                                 unsigned key_hash, int* value_out) {         \
+    struct map_layout layout;                                                 \
+    map_layout_load(map, &layout);                                            \
+    if (layout.khash != hash || layout.keys_eq != eq) {                       \
+      return map_get_with_hash(map, key, key_hash, value_out);                \
+    }                                                                         \
+    return prefix##_map_find(&layout, key, key_hash, value_out);              \
+  }                                                                           \
+                                                                              \
+  void prefix##_map_put(struct Map* map, key_type* key, int value) {          \
+    struct map_layout layout;                                                 \
+    map_layout_load(map, &layout);                                            \
+    if (layout.khash != hash || layout.keys_eq != eq) {                       \
+      map_put(map, key, value);                                               \
+      return;                                                                 \
+    }                                                                         \
+    prefix##_map_insert(&layout, key, hash(key), value);                      \
+    map_layout_store_size(map, &layout);                                      \
+  }                                                                           \
+                                                                              \
+  void prefix##_map_put_with_hash(struct Map* map, key_type* key,             \
+                                  unsigned key_hash, int value) {             \
+    struct map_layout layout;                                                 \
+    map_layout_load(map, &layout);                                            \
+    if (layout.khash != hash || layout.keys_eq != eq) {                       \
+      map_put_with_hash(map, key, key_hash, value);                           \
+      return;                                                                 \
+    }                                                                         \
+    prefix##_map_insert(&layout, key, key_hash, value);                       \
+    map_layout_store_size(map, &layout);                                      \
+  }                                                                           \
+                                                                              \
+  void prefix##_map_erase(struct Map* map, key_type* key, void** trash) {     \
+    struct map_layout layout;                                                 \
+    map_layout_load(map, &layout);                                            \
+    if (layout.khash != hash || layout.keys_eq != eq) {                       \
+      map_erase(map, key, trash);                                             \
+      return;                                                                 \
+    }                                                                         \
+    unsigned key_hash = hash(key);                                            \
+    unsigned index = map_layout_start(&layout, key_hash);                     \
+    while (layout.busybits[index] == 0 || layout.khs[index] != key_hash ||    \
+           !eq(layout.keyps[index], key)) {                                   \
+      layout.chns[index]--;                                                   \
+      index = map_layout_next(&layout, index);                                \
+    }                                                                         \
+    layout.busybits[index] = 0;                                               \
+    *trash = layout.keyps[index];                                             \
+    layout.size--;                                                            \
+    map_layout_store_size(map, &layout);                                      \
+  }
+
+#endif  // KLEE_VERIFICATION || VIGOR_MAP_BUCKETIZED || VIGOR_PROFILE
+
+#endif  //_UNVERIFIED_MAP_SPECIALIZE_H_INCLUDED_
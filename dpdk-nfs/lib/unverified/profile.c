@@ -0,0 +1,169 @@
+#ifdef VIGOR_PROFILE
+
+#include "profile.h"
+
+#include <inttypes.h>
+#include <signal.h>
+#include <stdlib.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_lcore.h>
+
+#include "../verified/double-chain.h"
+#include "../verified/expirator.h"
+#include "../verified/map.h"
+
+// Log-linear buckets: values below 2^PROFILE_SUB_BITS get one bucket each,
+// every larger power of two is split into 2^PROFILE_SUB_BITS buckets,
+// so percentiles are off by at most 1/16th
+#define PROFILE_SUB_BITS 4
+#define PROFILE_SUB_BUCKETS (1 << PROFILE_SUB_BITS)
+// Calls longer than 2^PROFILE_MAX_BITS cycles all land in the last bucket
+#define PROFILE_MAX_BITS 40
+#define PROFILE_BUCKETS \
+  ((PROFILE_MAX_BITS - PROFILE_SUB_BITS + 1) * PROFILE_SUB_BUCKETS)
+
+struct profile_histogram {
+  uint64_t count;
+  uint64_t max;
+  uint64_t buckets[PROFILE_BUCKETS];
+};
+
+struct profile_lcore {
+  struct profile_histogram sites[PROFILE_SITES_COUNT];
+} __rte_cache_aligned;
+
+static struct profile_lcore profiles[RTE_MAX_LCORE];
+
+static const char *site_names[PROFILE_SITES_COUNT] = {
+    [PROFILE_NF_PROCESS] = "nf_process",
+    [PROFILE_MAP_GET] = "map_get",
+    [PROFILE_MAP_PUT] = "map_put",
+    [PROFILE_DCHAIN_REJUVENATE_INDEX] = "dchain_rejuvenate_index",
+    [PROFILE_EXPIRE_ITEMS_SINGLE_MAP] = "expire_items_single_map",
+};
+
+static unsigned bucket_of(uint64_t cycles) {
+  if (cycles < PROFILE_SUB_BUCKETS) {
+    return cycles;
+  }
+
+  unsigned msb = 63 - __builtin_clzll(cycles);
+  if (msb >= PROFILE_MAX_BITS) {
+    return PROFILE_BUCKETS - 1;
+  }
+  unsigned sub =
+      (cycles >> (msb - PROFILE_SUB_BITS)) & (PROFILE_SUB_BUCKETS - 1);
+  return (msb - PROFILE_SUB_BITS + 1) * PROFILE_SUB_BUCKETS + sub;
+}
+
+// Smallest value that lands in the given bucket
+static uint64_t bucket_floor(unsigned bucket) {
+  if (bucket < PROFILE_SUB_BUCKETS) {
+    return bucket;
+  }
+
+  unsigned msb = bucket / PROFILE_SUB_BUCKETS + PROFILE_SUB_BITS - 1;
+  uint64_t sub = bucket % PROFILE_SUB_BUCKETS;
+  return (PROFILE_SUB_BUCKETS + sub) << (msb - PROFILE_SUB_BITS);
+}
+
+static uint64_t percentile(const struct profile_histogram *histogram,
+                           double fraction) {
+  uint64_t rank = (uint64_t)(fraction * histogram->count);
+  uint64_t seen = 0;
+  for (unsigned bucket = 0; bucket < PROFILE_BUCKETS; bucket++) {
+    seen += histogram->buckets[bucket];
+    if (seen > rank) {
+      return bucket_floor(bucket);
+    }
+  }
+  return histogram->max;
+}
+
+void profile_record(enum profile_site site, uint64_t cycles) {
+  struct profile_histogram *histogram =
+      &profiles[rte_lcore_id()].sites[site];
+  histogram->count++;
+  histogram->buckets[bucket_of(cycles)]++;
+  if (cycles > histogram->max) {
+    histogram->max = cycles;
+  }
+}
+
+void profile_dump(FILE *out) {
+  fprintf(out, "Cycles per call (%" PRIu64 " cycles/us):\n",
+          rte_get_tsc_hz() / 1000000);
+  for (unsigned lcore = 0; lcore < RTE_MAX_LCORE; lcore++) {
+    for (unsigned site = 0; site < PROFILE_SITES_COUNT; site++) {
+      const struct profile_histogram *histogram =
+          &profiles[lcore].sites[site];
+      if (histogram->count == 0) {
+        continue;
+      }
+      fprintf(out,
+              "lcore %u %-24s count %12" PRIu64 " p50 %8" PRIu64
+              " p99 %8" PRIu64 " p99.9 %8" PRIu64 " max %10" PRIu64 "\n",
+              lcore, site_names[site], histogram->count,
+              percentile(histogram, 0.5), percentile(histogram, 0.99),
+              percentile(histogram, 0.999), histogram->max);
+    }
+  }
+  fflush(out);
+}
+
+// Not async-signal-safe, but the NF is about to die anyway, and the
+// lcores keep running; a few calls may be missing from the histograms
+static void profile_signal_handler(int signal) {
+  (void)signal;
+  profile_dump(stderr);
+  exit(EXIT_SUCCESS);
+}
+
+void profile_init(void) {
+  signal(SIGINT, profile_signal_handler);
+  signal(SIGTERM, profile_signal_handler);
+}
+
+// Link-time wrappers, see -Wl,--wrap in the Makefile
+
+int __real_map_get(struct Map *map, void *key, int *value_out);
+void __real_map_put(struct Map *map, void *key, int value);
+int __real_dchain_rejuvenate_index(struct DoubleChain *chain, int index,
+                                   vigor_time_t time);
+int __real_expire_items_single_map(struct DoubleChain *chain,
+                                   struct Vector *vector, struct Map *map,
+                                   vigor_time_t time);
+
+int __wrap_map_get(struct Map *map, void *key, int *value_out) {
+  uint64_t begin = rte_rdtsc();
+  int result = __real_map_get(map, key, value_out);
+  profile_record(PROFILE_MAP_GET, rte_rdtsc() - begin);
+  return result;
+}
+
+void __wrap_map_put(struct Map *map, void *key, int value) {
+  uint64_t begin = rte_rdtsc();
+  __real_map_put(map, key, value);
+  profile_record(PROFILE_MAP_PUT, rte_rdtsc() - begin);
+}
+
+int __wrap_dchain_rejuvenate_index(struct DoubleChain *chain, int index,
+                                   vigor_time_t time) {
+  uint64_t begin = rte_rdtsc();
+  int result = __real_dchain_rejuvenate_index(chain, index, time);
+  profile_record(PROFILE_DCHAIN_REJUVENATE_INDEX, rte_rdtsc() - begin);
+  return result;
+}
+
+int __wrap_expire_items_single_map(struct DoubleChain *chain,
+                                   struct Vector *vector, struct Map *map,
+                                   vigor_time_t time) {
+  uint64_t begin = rte_rdtsc();
+  int result = __real_expire_items_single_map(chain, vector, map, time);
+  profile_record(PROFILE_EXPIRE_ITEMS_SINGLE_MAP, rte_rdtsc() - begin);
+  return result;
+}
+
+#endif  // VIGOR_PROFILE
@@ -0,0 +1,32 @@
+#ifndef _UNVERIFIED_PROFILE_H_INCLUDED_
+#define _UNVERIFIED_PROFILE_H_INCLUDED_
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Per-lcore cycle histograms of nf_process and of the data structure calls
+// that usually dominate it, built with PROFILE=1.
+// The data structure functions are wrapped at link time (see the Makefile),
+// so neither the NFs nor the verified code change.
+// The histograms are printed when the NF gets SIGINT or SIGTERM.
+
+enum profile_site {
+  PROFILE_NF_PROCESS,
+  PROFILE_MAP_GET,
+  PROFILE_MAP_PUT,
+  PROFILE_DCHAIN_REJUVENATE_INDEX,
+  PROFILE_EXPIRE_ITEMS_SINGLE_MAP,
+  PROFILE_SITES_COUNT
+};
+
+// Installs the signal handlers that print the histograms and exit.
+void profile_init(void);
+
+// Records one call that took the given number of TSC cycles,
+// on the current lcore.
+void profile_record(enum profile_site site, uint64_t cycles);
+
+// Prints count, p50, p99, p99.9 and max of every site for every lcore.
+void profile_dump(FILE *out);
+
+#endif  //_UNVERIFIED_PROFILE_H_INCLUDED_
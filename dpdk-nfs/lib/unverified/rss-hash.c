@@ -0,0 +1,60 @@
+#include "rss-hash.h"
+
+#include <string.h>
+
+uint8_t rss_hash_key[RSS_HASH_KEY_LENGTH] = {
+    0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d,
+    0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+    0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d,
+    0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+    0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a};
+
+// Source and destination addresses, then ports
+#define RSS_HASH_INPUT_LENGTH 12
+
+// The Toeplitz hash XORs, for every set input bit, the 32 key bits starting
+// at that bit's position; this XORs them 8 input bits at a time.
+static uint32_t rss_hash_tables[RSS_HASH_INPUT_LENGTH][256];
+
+// The 32 key bits starting at the given bit, most significant first
+static uint32_t key_window(unsigned bit) {
+  unsigned byte = bit / 8;
+  unsigned shift = bit % 8;
+  uint32_t window = ((uint32_t)rss_hash_key[byte] << 24) |
+                    ((uint32_t)rss_hash_key[byte + 1] << 16) |
+                    ((uint32_t)rss_hash_key[byte + 2] << 8) |
+                    rss_hash_key[byte + 3];
+  if (shift != 0) {
+    window = (window << shift) | (rss_hash_key[byte + 4] >> (8 - shift));
+  }
+  return window;
+}
+
+void rss_hash_init(void) {
+  for (unsigned byte = 0; byte < RSS_HASH_INPUT_LENGTH; byte++) {
+    for (unsigned value = 0; value < 256; value++) {
+      uint32_t hash = 0;
+      for (unsigned bit = 0; bit < 8; bit++) {
+        if (value & (0x80 >> bit)) {
+          hash ^= key_window(byte * 8 + bit);
+        }
+      }
+      rss_hash_tables[byte][value] = hash;
+    }
+  }
+}
+
+uint32_t rss_hash_ipv4_tcpudp(uint32_t src_ip, uint32_t dst_ip,
+                              uint16_t src_port, uint16_t dst_port) {
+  uint8_t input[RSS_HASH_INPUT_LENGTH];
+  memcpy(input, &src_ip, sizeof(src_ip));
+  memcpy(input + 4, &dst_ip, sizeof(dst_ip));
+  memcpy(input + 8, &src_port, sizeof(src_port));
+  memcpy(input + 10, &dst_port, sizeof(dst_port));
+
+  uint32_t hash = 0;
+  for (unsigned byte = 0; byte < RSS_HASH_INPUT_LENGTH; byte++) {
+    hash ^= rss_hash_tables[byte][input[byte]];
+  }
+  return hash;
+}
@@ -0,0 +1,31 @@
+#ifndef _UNVERIFIED_RSS_HASH_H_INCLUDED_
+#define _UNVERIFIED_RSS_HASH_H_INCLUDED_
+
+#include <stdint.h>
+
+// Symmetric RSS key: repeating 0x6d5a makes the Toeplitz hash invariant to
+// swapping source and destination, so both directions of a flow are steered
+// to the same queue, and thus to the same NF instance.
+#define RSS_HASH_KEY_LENGTH 52
+extern uint8_t rss_hash_key[RSS_HASH_KEY_LENGTH];
+
+// Unverified software Toeplitz hash with rss_hash_key, used by NFs built with
+// RSS_HASH=true as the hash of their flow tables: it is the hash the NICs
+// compute over the addresses and ports of non-fragmented TCP and UDP packets,
+// so the flow tables can be probed with the mbuf's RSS hash (see
+// nf_rss_hash in nf-util.h), and only keys the NIC did not hash are hashed
+// in software.
+
+// The key repeats every 16 bits, and so do its hashes: they are h * 0x10001
+// for a 16-bit h. The NFs refuse flow tables of more flows than that many
+// hashes, whose probe chains would grow long.
+#define RSS_HASH_DISTINCT_VALUES 65536
+
+// Fills the lookup tables of rss_hash_ipv4_tcpudp, once before any hashing.
+void rss_hash_init(void);
+
+// Addresses and ports in network byte order, like in the packet.
+uint32_t rss_hash_ipv4_tcpudp(uint32_t src_ip, uint32_t dst_ip,
+                              uint16_t src_port, uint16_t dst_port);
+
+#endif  // _UNVERIFIED_RSS_HASH_H_INCLUDED_
@@ -1,47 +1,55 @@
 #include "sketch.h"
 
-#include <stdlib.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <assert.h>
 
-#include "lib/verified/boilerplate-util.h"
-#include "lib/verified/map.h"
-#include "lib/verified/vector.h"
-#include "lib/verified/double-chain.h"
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif  // __SSE4_1__
 
 #include "lib/verified/vigor-time.h"
-
-struct internal_data {
-  unsigned hashes[SKETCH_HASHES];
-  int present[SKETCH_HASHES];
-  int buckets_indexes[SKETCH_HASHES];
+#include "lib/verified/vigor-alloc.h"
+
+// Flat count-min sketch: SKETCH_HASHES rows of width buckets, one bucket per
+// row for every key hash.
+// Buckets age instead of being freed: every bucket carries the epoch of its
+// last touch or refresh, and counts as absent once that epoch is older than
+// the time given to sketch_expire, so expiration is up to one epoch late.
+// Buckets stamp their epoch relative to a per-sketch base, which keeps them at
+// 8 bytes. Before stamps would no longer fit in 32 bits, the base moves
+// forward and buckets older than it are cleared, so stamps never wrap around:
+// however long the sketch stays idle, an expired bucket cannot look live again.
+
+// 2^20ns is about 1ms
+#ifndef SKETCH_EPOCH_SHIFT
+#define SKETCH_EPOCH_SHIFT 20
+#endif  // SKETCH_EPOCH_SHIFT
+
+// Distance between the base and the expiration border past which
+// sketch_expire moves the base, about 25 days of 1ms epochs; moving it walks
+// all buckets, but only once in that long
+#define SKETCH_REBASE_DISTANCE (UINT64_C(1) << 31)
+
+struct sketch_bucket {
+  uint32_t count;
+  uint32_t stamp;  // epoch of the last touch or refresh minus the base, 0 if
+                   // never touched
 };
 
 struct Sketch {
-  struct Map *clients;
-  struct Vector *keys;
-  struct Vector *buckets;
-  struct DoubleChain *allocators[SKETCH_HASHES];
-
-  uint32_t capacity;
+  struct sketch_bucket *buckets;  // row after row
+  uint32_t width;                 // power of 2
+  uint32_t bucket_count;
   uint16_t threshold;
-
   map_key_hash *kh;
-  struct internal_data internal;
-};
-
-struct hash {
-  uint32_t value;
-};
 
-struct bucket {
-  uint32_t value;
-};
+  uint64_t base;        // epoch that stamps are relative to
+  uint64_t border;      // buckets stamped before this epoch have expired
+  uint32_t live_stamp;  // the smallest stamp of a bucket that has not expired
 
-struct sketch_data {
-  unsigned hashes[SKETCH_HASHES];
-  int present[SKETCH_HASHES];
-  int buckets_indexes[SKETCH_HASHES];
+  // Buckets of the last hashed key
+  uint32_t offsets[SKETCH_HASHES] __attribute__((aligned(16)));
 };
 
 unsigned find_next_power_of_2_bigger_than(uint32_t d) {
@@ -55,179 +63,164 @@ unsigned find_next_power_of_2_bigger_than(uint32_t d) {
   return n;
 }
 
-bool hash_eq(void *a, void *b) {
-  struct hash *id1 = (struct hash *)a;
-  struct hash *id2 = (struct hash *)b;
+// Times before the first epoch, e.g. an expiration time early on, are in it
+static inline uint64_t epoch_of(vigor_time_t time) {
+  uint64_t epoch = time < 0 ? 0 : (uint64_t)time >> SKETCH_EPOCH_SHIFT;
+  return epoch == 0 ? 1 : epoch;
+}
 
-  return (id1->value == id2->value);
+static inline bool bucket_is_live(struct Sketch *sketch,
+                                  struct sketch_bucket *bucket) {
+  return bucket->stamp >= sketch->live_stamp;
 }
 
-void hash_allocate(void *obj) {
-  struct hash *id = (struct hash *)obj;
-  id->value = 0;
+static void set_live_stamp(struct Sketch *sketch) {
+  sketch->live_stamp =
+      sketch->border > sketch->base ? sketch->border - sketch->base : 1;
 }
 
-unsigned hash_hash(void *obj) {
-  struct hash *id = (struct hash *)obj;
+// Makes stamps relative to a later base, clearing the buckets that have
+// expired or that the new base cannot represent
+static void rebase(struct Sketch *sketch, uint64_t base) {
+  assert(base >= sketch->base);
+  for (uint32_t index = 0; index < sketch->bucket_count; index++) {
+    struct sketch_bucket *bucket = &sketch->buckets[index];
+    uint64_t epoch = sketch->base + bucket->stamp;
+    if (bucket->stamp == 0 || epoch <= base || epoch < sketch->border) {
+      bucket->count = 0;
+      bucket->stamp = 0;
+    } else {
+      bucket->stamp = epoch - base;
+    }
+  }
+  sketch->base = base;
+  set_live_stamp(sketch);
+}
 
-  unsigned hash = 0;
-  hash = __builtin_ia32_crc32si(hash, id->value);
-  return hash;
+// Without sketch_expire calls, e.g. while the NF is idle, the base may lag so
+// far behind that the stamp of the time does not fit anymore
+static inline uint32_t stamp_of(struct Sketch *sketch, vigor_time_t time) {
+  uint64_t epoch = epoch_of(time);
+  assert(epoch > sketch->base);
+  if (epoch - sketch->base > UINT32_MAX) {
+    rebase(sketch, epoch - SKETCH_REBASE_DISTANCE);
+  }
+  return epoch - sketch->base;
 }
 
-void bucket_allocate(void *obj) { (uintptr_t) obj; }
+// Mixes the key hash with the salt of a row (murmur3's finalizer)
+static inline uint32_t row_hash(uint32_t hash, uint32_t salt) {
+  uint32_t x = hash ^ salt;
+  x *= 0x85ebca6b;
+  x ^= x >> 13;
+  x *= 0xc2b2ae35;
+  x ^= x >> 16;
+  return x;
+}
 
 int sketch_allocate(map_key_hash *kh, uint32_t capacity, uint16_t threshold,
                     struct Sketch **sketch_out) {
   assert(SKETCH_HASHES <= SKETCH_SALTS_BANK_SIZE);
 
-  struct Sketch *sketch_alloc = (struct Sketch *)malloc(sizeof(struct Sketch));
-  if (sketch_alloc == NULL) {
+  if (capacity == 0 || capacity > 0x80000000 / SKETCH_HASHES) {
     return 0;
   }
 
-  (*sketch_out) = sketch_alloc;
-
-  (*sketch_out)->capacity = capacity;
-  (*sketch_out)->threshold = threshold;
-  (*sketch_out)->kh = kh;
-
-  unsigned total_sketch_capacity =
-      find_next_power_of_2_bigger_than(capacity * SKETCH_HASHES);
-
-  (*sketch_out)->clients = NULL;
-  if (map_allocate(hash_eq, hash_hash, total_sketch_capacity,
-                   &((*sketch_out)->clients)) == 0) {
+  struct Sketch *sketch = (struct Sketch *)vigor_malloc(sizeof(struct Sketch));
+  if (sketch == NULL) {
     return 0;
   }
 
-  (*sketch_out)->keys = NULL;
-  if (vector_allocate(sizeof(struct hash), total_sketch_capacity, hash_allocate,
-                      &((*sketch_out)->keys)) == 0) {
+  sketch->width = find_next_power_of_2_bigger_than(capacity);
+  sketch->bucket_count = sketch->width * SKETCH_HASHES;
+  sketch->buckets =
+      vigor_malloc(sizeof(struct sketch_bucket) * sketch->bucket_count);
+  if (sketch->buckets == NULL) {
+    vigor_free(sketch);
     return 0;
   }
 
-  (*sketch_out)->buckets = NULL;
-  if (vector_allocate(sizeof(struct bucket), total_sketch_capacity,
-                      bucket_allocate, &((*sketch_out)->buckets)) == 0) {
-    return 0;
+  for (uint32_t index = 0; index < sketch->bucket_count; index++) {
+    sketch->buckets[index].count = 0;
+    sketch->buckets[index].stamp = 0;
   }
-
-  for (int i = 0; i < SKETCH_HASHES; i++) {
-    (*sketch_out)->allocators[i] = NULL;
-    if (dchain_allocate(capacity, &((*sketch_out)->allocators[i])) == 0) {
-      return 0;
-    }
-  }
-
+  sketch->threshold = threshold;
+  sketch->kh = kh;
+  sketch->base = 0;
+  sketch->border = 0;
+  sketch->live_stamp = 1;
+  *sketch_out = sketch;
   return 1;
 }
 
 void sketch_compute_hashes(struct Sketch *sketch, void *key) {
+  uint32_t hash = sketch->kh(key);
+
+#if defined(__SSE4_1__) && SKETCH_HASHES == 4
+  // All rows at once, row_hash lane by lane
+  __m128i x = _mm_xor_si128(_mm_set1_epi32(hash),
+                            _mm_loadu_si128((const __m128i *)SKETCH_SALTS));
+  x = _mm_mullo_epi32(x, _mm_set1_epi32(0x85ebca6b));
+  x = _mm_xor_si128(x, _mm_srli_epi32(x, 13));
+  x = _mm_mullo_epi32(x, _mm_set1_epi32(0xc2b2ae35));
+  x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+  x = _mm_and_si128(x, _mm_set1_epi32(sketch->width - 1));
+  __m128i rows = _mm_mullo_epi32(_mm_setr_epi32(0, 1, 2, 3),
+                                 _mm_set1_epi32(sketch->width));
+  _mm_store_si128((__m128i *)sketch->offsets, _mm_add_epi32(x, rows));
+#else   // __SSE4_1__ && SKETCH_HASHES == 4
   for (int i = 0; i < SKETCH_HASHES; i++) {
-    sketch->internal.buckets_indexes[i] = -1;
-    sketch->internal.present[i] = 0;
-    sketch->internal.hashes[i] = 0;
-
-    sketch->internal.hashes[i] =
-        __builtin_ia32_crc32si(sketch->internal.hashes[i], SKETCH_SALTS[i]);
-    sketch->internal.hashes[i] =
-        __builtin_ia32_crc32si(sketch->internal.hashes[i], sketch->kh(key));
-    sketch->internal.hashes[i] %= sketch->capacity;
+    uint32_t column = row_hash(hash, SKETCH_SALTS[i]) & (sketch->width - 1);
+    sketch->offsets[i] = i * sketch->width + column;
+  }
+#endif  // __SSE4_1__ && SKETCH_HASHES == 4
+
+  for (int i = 0; i < SKETCH_HASHES; i++) {
+    __builtin_prefetch(&sketch->buckets[sketch->offsets[i]]);
   }
 }
 
 void sketch_refresh(struct Sketch *sketch, vigor_time_t now) {
+  uint32_t stamp = stamp_of(sketch, now);
   for (int i = 0; i < SKETCH_HASHES; i++) {
-    map_get(sketch->clients, &sketch->internal.hashes[i],
-            &sketch->internal.buckets_indexes[i]);
-    dchain_rejuvenate_index(sketch->allocators[i],
-                            sketch->internal.buckets_indexes[i], now);
+    struct sketch_bucket *bucket = &sketch->buckets[sketch->offsets[i]];
+    bucket->stamp = bucket_is_live(sketch, bucket) ? stamp : bucket->stamp;
   }
 }
 
 int sketch_fetch(struct Sketch *sketch) {
-  int bucket_min_set = false;
-  uint32_t *buckets_values[SKETCH_HASHES];
-  uint32_t bucket_min = 0;
+  bool bucket_min_set = false;
+  uint32_t bucket_min = UINT32_MAX;
 
   for (int i = 0; i < SKETCH_HASHES; i++) {
-    sketch->internal.present[i] =
-        map_get(sketch->clients, &sketch->internal.hashes[i],
-                &sketch->internal.buckets_indexes[i]);
-
-    if (!sketch->internal.present[i]) {
-      continue;
-    }
-
-    int offseted = sketch->internal.buckets_indexes[i] + sketch->capacity * i;
-    vector_borrow(sketch->buckets, offseted, (void **)&buckets_values[i]);
-
-    if (!bucket_min_set || bucket_min > *buckets_values[i]) {
-      bucket_min = *buckets_values[i];
+    struct sketch_bucket *bucket = &sketch->buckets[sketch->offsets[i]];
+    if (bucket_is_live(sketch, bucket)) {
       bucket_min_set = true;
+      bucket_min = bucket->count < bucket_min ? bucket->count : bucket_min;
     }
-
-    vector_return(sketch->buckets, offseted, buckets_values[i]);
   }
 
   return bucket_min_set && bucket_min > sketch->threshold;
 }
 
+// An absent bucket starts at 0, so buckets count the touches after the first
 int sketch_touch_buckets(struct Sketch *sketch, vigor_time_t now) {
+  uint32_t stamp = stamp_of(sketch, now);
   for (int i = 0; i < SKETCH_HASHES; i++) {
-    int bucket_index = -1;
-    int present =
-        map_get(sketch->clients, &sketch->internal.hashes[i], &bucket_index);
-
-    if (!present) {
-      int allocated_client =
-          dchain_allocate_new_index(sketch->allocators[i], &bucket_index, now);
-
-      if (!allocated_client) {
-        // Sketch size limit reached.
-        return false;
-      }
-
-      int offseted = bucket_index + sketch->capacity * i;
-
-      uint32_t *saved_hash = 0;
-      uint32_t *saved_bucket = 0;
-
-      vector_borrow(sketch->keys, offseted, (void **)&saved_hash);
-      vector_borrow(sketch->buckets, offseted, (void **)&saved_bucket);
-
-      (*saved_hash) = sketch->internal.hashes[i];
-      (*saved_bucket) = 0;
-      map_put(sketch->clients, saved_hash, bucket_index);
-
-      vector_return(sketch->keys, offseted, saved_hash);
-      vector_return(sketch->buckets, offseted, saved_bucket);
-    } else {
-      dchain_rejuvenate_index(sketch->allocators[i], bucket_index, now);
-      uint32_t *bucket;
-      int offseted = bucket_index + sketch->capacity * i;
-      vector_borrow(sketch->buckets, offseted, (void **)&bucket);
-      (*bucket)++;
-      vector_return(sketch->buckets, offseted, bucket);
-    }
+    struct sketch_bucket *bucket = &sketch->buckets[sketch->offsets[i]];
+    bucket->count = bucket_is_live(sketch, bucket) ? bucket->count + 1 : 0;
+    bucket->stamp = stamp;
   }
 
   return true;
 }
 
+// Expired buckets are only reset when touched again, or when the base moves
 void sketch_expire(struct Sketch *sketch, vigor_time_t time) {
-  int offset = 0;
-  int index = -1;
-
-  for (int i = 0; i < SKETCH_HASHES; i++) {
-    offset = i * sketch->capacity;
-
-    while (dchain_expire_one_index(sketch->allocators[i], &index, time)) {
-      void *key;
-      vector_borrow(sketch->keys, index + offset, &key);
-      map_erase(sketch->clients, key, &key);
-      vector_return(sketch->keys, index + offset, key);
-    }
+  sketch->border = epoch_of(time);
+  if (sketch->border > sketch->base + SKETCH_REBASE_DISTANCE) {
+    rebase(sketch, sketch->border - 1);
+  } else {
+    set_live_stamp(sketch);
   }
-}
\ No newline at end of file
+}
@@ -9,14 +9,24 @@
 #include "lib/verified/map.h"
 #include "lib/verified/vigor-time.h"
 
+// Count-min sketch of SKETCH_HASHES rows, whose buckets expire when neither
+// touched nor refreshed for a while, see sketch.c.
 struct Sketch;
 
+// @param capacity - Buckets per row, rounded up to a power of 2.
+// @param threshold - Count above which sketch_fetch reports an overflow.
 int sketch_allocate(map_key_hash *kh, uint32_t capacity, uint16_t threshold,
                     struct Sketch **sketch_out);
+// Picks the buckets of the key, for the calls below.
 void sketch_compute_hashes(struct Sketch *sketch, void *k);
+// Keeps the buckets that have not expired alive.
 void sketch_refresh(struct Sketch *sketch, vigor_time_t now);
+// @returns whether the smallest count among the buckets that have not expired
+// is above the threshold.
 int sketch_fetch(struct Sketch *sketch);
+// Counts one more occurrence of the key; always succeeds.
 int sketch_touch_buckets(struct Sketch *sketch, vigor_time_t now);
+// Expires the buckets last touched or refreshed before the given time.
 void sketch_expire(struct Sketch *sketch, vigor_time_t time);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,87 @@
+#ifdef VIGOR_TELEMETRY
+
+#include "telemetry.h"
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static struct telemetry_region *region;
+
+VIGOR_PER_LCORE struct telemetry_lcore *telemetry_local;
+
+// Private part of the lcore state, which readers do not need
+struct telemetry_private {
+  struct Map *maps[TELEMETRY_MAX_MAPS];
+  vigor_time_t next_tick;
+  uint64_t expired_at_last_tick;
+};
+
+static VIGOR_PER_LCORE struct telemetry_private local;
+
+bool telemetry_init(unsigned lcore_count, unsigned device_count) {
+  if (lcore_count > TELEMETRY_MAX_LCORES ||
+      device_count > TELEMETRY_MAX_DEVICES) {
+    return false;
+  }
+
+  // Readers that still map an old region keep it until they reopen
+  shm_unlink(TELEMETRY_SHM_NAME);
+  int fd = shm_open(TELEMETRY_SHM_NAME, O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  // ftruncate zero-fills, so all counters start at 0
+  if (ftruncate(fd, sizeof(struct telemetry_region)) != 0) {
+    close(fd);
+    return false;
+  }
+  void *mapped = mmap(NULL, sizeof(struct telemetry_region),
+                      PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    return false;
+  }
+
+  region = mapped;
+  region->version = TELEMETRY_VERSION;
+  region->lcore_count = lcore_count;
+  region->device_count = device_count;
+  region->tsc_hz = rte_get_tsc_hz();
+  __atomic_store_n(&region->magic, TELEMETRY_MAGIC, __ATOMIC_RELEASE);
+  return true;
+}
+
+void telemetry_init_lcore(unsigned lcore_index) {
+  telemetry_local = &region->lcores[lcore_index];
+}
+
+void telemetry_add_map(struct Map *map, unsigned capacity) {
+  if (telemetry_local == NULL ||
+      telemetry_local->map_count == TELEMETRY_MAX_MAPS) {
+    return;
+  }
+
+  local.maps[telemetry_local->map_count] = map;
+  telemetry_local->maps[telemetry_local->map_count].capacity = capacity;
+  telemetry_local->map_count++;
+}
+
+void telemetry_tick(vigor_time_t now) {
+  if (now < local.next_tick) {
+    return;
+  }
+  local.next_tick = now + TELEMETRY_TICK_NS;
+
+  for (uint64_t n = 0; n < telemetry_local->map_count; n++) {
+    telemetry_local->maps[n].size = map_size(local.maps[n]);
+  }
+  telemetry_local->expired_last_tick =
+      telemetry_local->expired - local.expired_at_last_tick;
+  local.expired_at_last_tick = telemetry_local->expired;
+  telemetry_local->ticks++;
+}
+
+#endif  // VIGOR_TELEMETRY
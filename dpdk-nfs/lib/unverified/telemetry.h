@@ -0,0 +1,132 @@
+#ifndef _UNVERIFIED_TELEMETRY_H_INCLUDED_
+#define _UNVERIFIED_TELEMETRY_H_INCLUDED_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Live counters of a running NF, built with TELEMETRY=true.
+// They live in a POSIX shared memory region that external tools can map
+// read-only and poll without stopping the NF (see telemetry/reader.c);
+// DPDK memzones would require the NF to run without --no-shconf.
+//
+// Every lcore owns one cache-aligned block and is its only writer, so the
+// hot path never shares a cache line with another core. Counters only grow,
+// so readers compute rates from the difference between two samples; fields
+// of a block may be sampled at slightly different times.
+//
+// This header is also used by the reader, so the layout does not depend on
+// DPDK.
+
+#define TELEMETRY_SHM_NAME "/vigor-telemetry"
+#define TELEMETRY_MAGIC 0x564947524d455452ULL
+#define TELEMETRY_VERSION 1
+
+#define TELEMETRY_MAX_LCORES 128
+#define TELEMETRY_MAX_DEVICES 32
+#define TELEMETRY_MAX_MAPS 64
+
+// How often the slowly changing fields (map occupancy, expirations per tick)
+// are refreshed
+#define TELEMETRY_TICK_NS 100000000ULL
+
+#define TELEMETRY_CACHE_LINE_SIZE 64
+
+struct telemetry_device {
+  uint64_t rx;
+  uint64_t tx;
+  uint64_t nf_dropped;  // received on this device, dropped by the NF
+  uint64_t tx_dropped;  // not accepted by this device
+};
+
+struct telemetry_map {
+  uint64_t size;
+  uint64_t capacity;
+};
+
+struct telemetry_lcore {
+  // Updated for every packet
+  struct telemetry_device devices[TELEMETRY_MAX_DEVICES];
+  uint64_t processed;       // calls to nf_process
+  uint64_t process_cycles;  // TSC cycles spent in nf_process
+
+  // Updated rarely
+  uint64_t chain_allocation_failures;
+  uint64_t expired;            // expired indexes, in all chains
+  uint64_t expired_last_tick;  // expired indexes during the last tick
+  uint64_t ticks;
+  uint64_t map_count;  // maps in allocation order, up to TELEMETRY_MAX_MAPS
+  struct telemetry_map maps[TELEMETRY_MAX_MAPS];
+} __attribute__((aligned(TELEMETRY_CACHE_LINE_SIZE)));
+
+struct telemetry_region {
+  uint64_t magic;  // written last, once the rest is initialized
+  uint32_t version;
+  uint32_t lcore_count;
+  uint32_t device_count;
+  uint64_t tsc_hz;  // to turn process_cycles into time
+  struct telemetry_lcore lcores[TELEMETRY_MAX_LCORES];
+};
+
+#ifdef VIGOR_TELEMETRY
+#include <rte_cycles.h>
+
+#include "../verified/boilerplate-util.h"
+#include "../verified/map.h"
+#include "../verified/vigor-time.h"
+
+// Block of the current lcore, NULL before telemetry_init_lcore
+extern VIGOR_PER_LCORE struct telemetry_lcore *telemetry_local;
+
+// Creates the shared region, replacing any stale one; call once, before
+// launching the lcores.
+// @returns true on success.
+bool telemetry_init(unsigned lcore_count, unsigned device_count);
+
+// Points the current lcore at its block; call before allocating NF state,
+// so that its maps are accounted for.
+void telemetry_init_lcore(unsigned lcore_index);
+
+// Accounts for a newly allocated map of the current lcore.
+void telemetry_add_map(struct Map *map, unsigned capacity);
+
+// Refreshes map occupancy and expirations once per TELEMETRY_TICK_NS.
+void telemetry_tick(vigor_time_t now);
+
+static inline void telemetry_rx(uint16_t device, uint16_t count) {
+  telemetry_local->devices[device].rx += count;
+}
+
+static inline void telemetry_tx(uint16_t device, uint16_t sent,
+                                uint16_t dropped) {
+  telemetry_local->devices[device].tx += sent;
+  telemetry_local->devices[device].tx_dropped += dropped;
+}
+
+static inline void telemetry_nf_drop(uint16_t device) {
+  telemetry_local->devices[device].nf_dropped++;
+}
+
+static inline uint64_t telemetry_process_begin(void) { return rte_rdtsc(); }
+
+static inline void telemetry_process_end(uint64_t begin) {
+  telemetry_local->processed++;
+  telemetry_local->process_cycles += rte_rdtsc() - begin;
+}
+
+// Hooks for the data structures, which may run before telemetry_init_lcore
+
+static inline void telemetry_chain_allocation_failed(void) {
+  if (telemetry_local != NULL) {
+    telemetry_local->chain_allocation_failures++;
+  }
+}
+
+static inline void telemetry_chain_expired(void) {
+  if (telemetry_local != NULL) {
+    telemetry_local->expired++;
+  }
+}
+#endif  // VIGOR_TELEMETRY
+
+#endif  //_UNVERIFIED_TELEMETRY_H_INCLUDED_
@@ -0,0 +1,80 @@
+#include "../verified/vigor-alloc.h"
+#include "../verified/boilerplate-util.h"
+
+#include <rte_common.h>
+#include <rte_eal.h>
+#include <rte_malloc.h>
+#include <rte_memory.h>
+
+#include <sys/mman.h>
+
+// Transparent hugepages are 2MB on x86
+#define FALLBACK_HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+static void *default_malloc(size_t size);
+static void default_free(void *ptr);
+
+static vigor_malloc_fn *allocator_malloc = default_malloc;
+static vigor_free_fn *allocator_free = default_free;
+
+static int allocator_socket = SOCKET_ID_ANY;
+
+static VIGOR_PER_LCORE struct vigor_alloc_stats allocator_stats;
+
+static void *default_malloc(size_t size) {
+  void *ptr = rte_malloc_socket(NULL, size, RTE_CACHE_LINE_SIZE,
+                                allocator_socket);
+  if (ptr != NULL) {
+    // With --no-huge, EAL memory is made of regular pages too
+    if (rte_eal_has_hugepages()) {
+      allocator_stats.hugepage_bytes += size;
+    } else {
+      allocator_stats.fallback_bytes += size;
+    }
+    return ptr;
+  }
+
+  // Out of hugepage memory, still give the NF what it asked for;
+  // large tables at least get transparent hugepages
+  if (size >= FALLBACK_HUGEPAGE_SIZE) {
+    size_t aligned_size = RTE_ALIGN_CEIL(size, FALLBACK_HUGEPAGE_SIZE);
+    ptr = aligned_alloc(FALLBACK_HUGEPAGE_SIZE, aligned_size);
+    if (ptr != NULL) {
+      madvise(ptr, aligned_size, MADV_HUGEPAGE);
+    }
+  } else {
+    ptr = aligned_alloc(RTE_CACHE_LINE_SIZE,
+                        RTE_ALIGN_CEIL(size, RTE_CACHE_LINE_SIZE));
+  }
+  if (ptr != NULL) {
+    allocator_stats.fallback_bytes += size;
+  }
+  return ptr;
+}
+
+static void default_free(void *ptr) {
+  if (ptr == NULL) {
+    return;
+  }
+
+  if (rte_mem_virt2memseg(ptr, NULL) != NULL) {
+    rte_free(ptr);
+  } else {
+    free(ptr);
+  }
+}
+
+void *vigor_malloc(size_t size) { return allocator_malloc(size); }
+
+void vigor_free(void *ptr) { allocator_free(ptr); }
+
+void vigor_set_allocator(vigor_malloc_fn *malloc_fn, vigor_free_fn *free_fn) {
+  allocator_malloc = malloc_fn;
+  allocator_free = free_fn;
+}
+
+void vigor_alloc_set_socket(int socket) { allocator_socket = socket; }
+
+void vigor_alloc_get_stats(struct vigor_alloc_stats *stats_out) {
+  *stats_out = allocator_stats;
+}
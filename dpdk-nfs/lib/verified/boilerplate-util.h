@@ -23,6 +23,14 @@ unsigned long long __builtin_ia32_crc32di(unsigned long long acc,
 #define AND &&
 #endif  // KLEE_VERIFICATION
 
+// Globals of which every lcore keeps a private copy, for the unverified
+// multi-core support; symbex only ever runs one lcore
+#ifdef KLEE_VERIFICATION
+#define VIGOR_PER_LCORE
+#else  // KLEE_VERIFICATION
+#define VIGOR_PER_LCORE __thread
+#endif  // KLEE_VERIFICATION
+
 #define DEFAULT_UINT32_T 0
 
 static void null_init(void *obj)
@@ -1,6 +1,7 @@
 #include "cht.h"
 #include <assert.h>
 #include <stdlib.h>
+#include "vigor-alloc.h"
 
 //@ #include "../proof/prime.gh"
 //@ #include "../proof/permutations.gh"
@@ -689,7 +690,7 @@ int cht_fill_cht(struct Vector *cht, uint32_t cht_height,
 
   // Generate the permutations of 0..(cht_height - 1) for each backend
   int *permutations =
-      (int *)malloc(sizeof(int) * (int)(cht_height * backend_capacity));
+      (int *)vigor_malloc(sizeof(int) * (int)(cht_height * backend_capacity));
   if (permutations == 0) {
     return 0;
   }
@@ -802,9 +803,9 @@ int cht_fill_cht(struct Vector *cht, uint32_t cht_height,
     //@ forall_append(perms, cons(new_elem, nil), is_permutation);
   }
 
-  int *next = (int *)malloc(sizeof(int) * (int)(cht_height));
+  int *next = (int *)vigor_malloc(sizeof(int) * (int)(cht_height));
   if (next == 0) {
-    free(permutations);
+    vigor_free(permutations);
     return 0;
   }
 
@@ -1104,8 +1105,8 @@ int cht_fill_cht(struct Vector *cht, uint32_t cht_height,
   //@ assert (true == valid_cht(vals, backend_capacity, cht_height));
 
   // Free memory
-  free(next);
-  free(permutations);
+  vigor_free(next);
+  vigor_free(permutations);
   return 1;
 }
 
@@ -1,9 +1,17 @@
+// DCHAIN_LAYOUT=wheel replaces this file by lib/unverified/double-chain-wheel.c
+#ifndef VIGOR_DCHAIN_WHEEL
+
 #include "double-chain.h"
 
 #include <stdlib.h>
 #include <stddef.h>
 
 #include "double-chain-impl.h"
+#include "vigor-alloc.h"
+
+#ifdef VIGOR_TELEMETRY
+#include "../unverified/telemetry.h"
+#endif  // VIGOR_TELEMETRY
 
 //@ #include <nat.gh>
 //@ #include "../proof/arith.gh"
@@ -125,7 +133,7 @@ int dchain_allocate(int index_range, struct DoubleChain** chain_out)
 {
   struct DoubleChain* old_chain_out = *chain_out;
   struct DoubleChain* chain_alloc =
-      (struct DoubleChain*)malloc(sizeof(struct DoubleChain));
+      (struct DoubleChain*)vigor_malloc(sizeof(struct DoubleChain));
   if (chain_alloc == NULL) return 0;
   *chain_out = (struct DoubleChain*)chain_alloc;
 
@@ -136,20 +144,20 @@ int dchain_allocate(int index_range, struct DoubleChain** chain_out)
          (index_range + DCHAIN_RESERVED), IRANG_LIMIT +
     DCHAIN_RESERVED);
     @*/
-  struct dchain_cell* cells_alloc = (struct dchain_cell*)malloc(
+  struct dchain_cell* cells_alloc = (struct dchain_cell*)vigor_malloc(
       sizeof(struct dchain_cell) * (index_range + DCHAIN_RESERVED));
   if (cells_alloc == NULL) {
-    free(chain_alloc);
+    vigor_free(chain_alloc);
     *chain_out = old_chain_out;
     return 0;
   }
   (*chain_out)->cells = cells_alloc;
 
   vigor_time_t* timestamps_alloc =
-      (vigor_time_t*)malloc(sizeof(vigor_time_t) * (index_range));
+      (vigor_time_t*)vigor_malloc(sizeof(vigor_time_t) * (index_range));
   if (timestamps_alloc == NULL) {
-    free((void*)cells_alloc);
-    free(chain_alloc);
+    vigor_free((void*)cells_alloc);
+    vigor_free(chain_alloc);
     *chain_out = old_chain_out;
     return 0;
   }
@@ -399,6 +407,9 @@ int dchain_allocate_new_index(struct DoubleChain* chain, int* index_out,
     // dchain_low_fp(ch), time, dchain_high_fp(ch));
     //@ close double_chainp(dchain_allocate_fp(ch, ni, time), chain);
   } else {
+#ifdef VIGOR_TELEMETRY
+    telemetry_chain_allocation_failed();
+#endif  // VIGOR_TELEMETRY
     //@ close double_chainp(ch, chain);
   }
   return ret;
@@ -836,6 +847,9 @@ int dchain_expire_one_index(struct DoubleChain* chain, int* index_out,
         double_chainp(dchain_remove_index_fp(ch, oi), chain);
         }
         @*/
+#ifdef VIGOR_TELEMETRY
+      telemetry_chain_expired();
+#endif  // VIGOR_TELEMETRY
       return rez;
     }
     //@ glue_timestamp(timestamps, tmstmps, oi);
@@ -1923,3 +1937,5 @@ time)));
   }
   }
   @*/
+
+#endif  // VIGOR_DCHAIN_WHEEL
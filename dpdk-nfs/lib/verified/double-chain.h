@@ -11,7 +11,12 @@
 struct DoubleChain;
 // Makes sure the allocator structur fits into memory, and particularly into
 // 32 bit address space.
+// See CAPACITY_UPPER_LIMIT in map-util.h
+#ifdef VIGOR_LARGE_CAPACITY
+#define IRANG_LIMIT (1 << 28)
+#else   // VIGOR_LARGE_CAPACITY
 #define IRANG_LIMIT (1048576)
+#endif  // VIGOR_LARGE_CAPACITY
 
 // kinda hacky, but makes the proof independent of vigor_time_t... sort of
 #define malloc_block_time malloc_block_llongs
@@ -1,4 +1,5 @@
 #include "double-map.h"
+#include "vigor-alloc.h"
 
 #ifdef CAPACITY_POW2
 #include "map-impl-pow2.h"
@@ -296,141 +297,145 @@ int dmap_allocate /*@ <K1,K2,V> @*/
 
   struct DoubleMap* old_map_val = *map_out;
   struct DoubleMap* map_alloc =
-      (struct DoubleMap*)malloc(sizeof(struct DoubleMap));
+      (struct DoubleMap*)vigor_malloc(sizeof(struct DoubleMap));
   if (map_alloc == NULL) return 0;
   *map_out = (struct DoubleMap*)map_alloc;
 
   //@ mul_bounds(value_size, 4096, capacity, CAPACITY_UPPER_LIMIT);
-  uint8_t* vals_alloc = (uint8_t*)malloc((uint32_t)value_size * capacity);
+#ifdef VIGOR_LARGE_CAPACITY
+  uint8_t* vals_alloc = (uint8_t*)vigor_malloc((size_t)value_size * capacity);
+#else   // VIGOR_LARGE_CAPACITY
+  uint8_t* vals_alloc = (uint8_t*)vigor_malloc((uint32_t)value_size * capacity);
+#endif  // VIGOR_LARGE_CAPACITY
   if (vals_alloc == NULL) {
-    free(map_alloc);
+    vigor_free(map_alloc);
     *map_out = old_map_val;
     return 0;
   }
   (*map_out)->values = vals_alloc;
-  int* bbs_a_alloc = (int*)malloc(sizeof(int) * (int)keys_capacity);
+  int* bbs_a_alloc = (int*)vigor_malloc(sizeof(int) * (int)keys_capacity);
   if (bbs_a_alloc == NULL) {
-    free(vals_alloc);
-    free(map_alloc);
+    vigor_free(vals_alloc);
+    vigor_free(map_alloc);
     *map_out = old_map_val;
     return 0;
   }
   (*map_out)->bbs_a = bbs_a_alloc;
-  void** kps_a_alloc = (void**)malloc(sizeof(void*) * (int)keys_capacity);
+  void** kps_a_alloc = (void**)vigor_malloc(sizeof(void*) * (int)keys_capacity);
   if (kps_a_alloc == NULL) {
-    free(bbs_a_alloc);
-    free(vals_alloc);
-    free(map_alloc);
+    vigor_free(bbs_a_alloc);
+    vigor_free(vals_alloc);
+    vigor_free(map_alloc);
     *map_out = old_map_val;
     return 0;
   }
   (*map_out)->kps_a = kps_a_alloc;
   unsigned* khs_a_alloc =
-      (unsigned*)malloc(sizeof(unsigned) * (int)keys_capacity);
+      (unsigned*)vigor_malloc(sizeof(unsigned) * (int)keys_capacity);
   if (khs_a_alloc == NULL) {
-    free(kps_a_alloc);
-    free(bbs_a_alloc);
-    free(vals_alloc);
-    free(map_alloc);
+    vigor_free(kps_a_alloc);
+    vigor_free(bbs_a_alloc);
+    vigor_free(vals_alloc);
+    vigor_free(map_alloc);
     *map_out = old_map_val;
     return 0;
   }
   (*map_out)->khs_a = khs_a_alloc;
-  int* chns_a_alloc = (int*)malloc(sizeof(int) * (int)keys_capacity);
+  int* chns_a_alloc = (int*)vigor_malloc(sizeof(int) * (int)keys_capacity);
   if (chns_a_alloc == NULL) {
-    free(khs_a_alloc);
-    free(kps_a_alloc);
-    free(bbs_a_alloc);
-    free(vals_alloc);
-    free(map_alloc);
+    vigor_free(khs_a_alloc);
+    vigor_free(kps_a_alloc);
+    vigor_free(bbs_a_alloc);
+    vigor_free(vals_alloc);
+    vigor_free(map_alloc);
     *map_out = old_map_val;
     return 0;
   }
   (*map_out)->chns_a = chns_a_alloc;
-  int* inds_a_alloc = (int*)malloc(sizeof(int) * (int)keys_capacity);
+  int* inds_a_alloc = (int*)vigor_malloc(sizeof(int) * (int)keys_capacity);
   if (inds_a_alloc == NULL) {
-    free(chns_a_alloc);
-    free(khs_a_alloc);
-    free(kps_a_alloc);
-    free(bbs_a_alloc);
-    free(vals_alloc);
-    free(map_alloc);
+    vigor_free(chns_a_alloc);
+    vigor_free(khs_a_alloc);
+    vigor_free(kps_a_alloc);
+    vigor_free(bbs_a_alloc);
+    vigor_free(vals_alloc);
+    vigor_free(map_alloc);
     *map_out = old_map_val;
     return 0;
   }
   (*map_out)->inds_a = inds_a_alloc;
-  int* bbs_b_alloc = (int*)malloc(sizeof(int) * (int)keys_capacity);
+  int* bbs_b_alloc = (int*)vigor_malloc(sizeof(int) * (int)keys_capacity);
   if (bbs_b_alloc == NULL) {
-    free(inds_a_alloc);
-    free(chns_a_alloc);
-    free(khs_a_alloc);
-    free(kps_a_alloc);
-    free(bbs_a_alloc);
-    free(vals_alloc);
-    free(map_alloc);
+    vigor_free(inds_a_alloc);
+    vigor_free(chns_a_alloc);
+    vigor_free(khs_a_alloc);
+    vigor_free(kps_a_alloc);
+    vigor_free(bbs_a_alloc);
+    vigor_free(vals_alloc);
+    vigor_free(map_alloc);
     *map_out = old_map_val;
     return 0;
   }
   (*map_out)->bbs_b = bbs_b_alloc;
-  void** kps_b_alloc = (void**)malloc(sizeof(void*) * (int)keys_capacity);
+  void** kps_b_alloc = (void**)vigor_malloc(sizeof(void*) * (int)keys_capacity);
   if (kps_b_alloc == NULL) {
-    free(bbs_b_alloc);
-    free(inds_a_alloc);
-    free(chns_a_alloc);
-    free(khs_a_alloc);
-    free(kps_a_alloc);
-    free(bbs_a_alloc);
-    free(vals_alloc);
-    free(map_alloc);
+    vigor_free(bbs_b_alloc);
+    vigor_free(inds_a_alloc);
+    vigor_free(chns_a_alloc);
+    vigor_free(khs_a_alloc);
+    vigor_free(kps_a_alloc);
+    vigor_free(bbs_a_alloc);
+    vigor_free(vals_alloc);
+    vigor_free(map_alloc);
     *map_out = old_map_val;
     return 0;
   }
   (*map_out)->kps_b = kps_b_alloc;
   unsigned* khs_b_alloc =
-      (unsigned*)malloc(sizeof(unsigned) * (int)keys_capacity);
+      (unsigned*)vigor_malloc(sizeof(unsigned) * (int)keys_capacity);
   if (khs_b_alloc == NULL) {
-    free(kps_b_alloc);
-    free(bbs_b_alloc);
-    free(inds_a_alloc);
-    free(chns_a_alloc);
-    free(khs_a_alloc);
-    free(kps_a_alloc);
-    free(bbs_a_alloc);
-    free(vals_alloc);
-    free(map_alloc);
+    vigor_free(kps_b_alloc);
+    vigor_free(bbs_b_alloc);
+    vigor_free(inds_a_alloc);
+    vigor_free(chns_a_alloc);
+    vigor_free(khs_a_alloc);
+    vigor_free(kps_a_alloc);
+    vigor_free(bbs_a_alloc);
+    vigor_free(vals_alloc);
+    vigor_free(map_alloc);
     *map_out = old_map_val;
     return 0;
   }
   (*map_out)->khs_b = khs_b_alloc;
-  int* inds_b_alloc = (int*)malloc(sizeof(int) * (int)keys_capacity);
+  int* inds_b_alloc = (int*)vigor_malloc(sizeof(int) * (int)keys_capacity);
   if (inds_b_alloc == NULL) {
-    free(khs_b_alloc);
-    free(kps_b_alloc);
-    free(bbs_b_alloc);
-    free(inds_a_alloc);
-    free(chns_a_alloc);
-    free(khs_a_alloc);
-    free(kps_a_alloc);
-    free(bbs_a_alloc);
-    free(vals_alloc);
-    free(map_alloc);
+    vigor_free(khs_b_alloc);
+    vigor_free(kps_b_alloc);
+    vigor_free(bbs_b_alloc);
+    vigor_free(inds_a_alloc);
+    vigor_free(chns_a_alloc);
+    vigor_free(khs_a_alloc);
+    vigor_free(kps_a_alloc);
+    vigor_free(bbs_a_alloc);
+    vigor_free(vals_alloc);
+    vigor_free(map_alloc);
     *map_out = old_map_val;
     return 0;
   }
   (*map_out)->inds_b = inds_b_alloc;
-  int* chns_b_alloc = (int*)malloc(sizeof(int) * (int)keys_capacity);
+  int* chns_b_alloc = (int*)vigor_malloc(sizeof(int) * (int)keys_capacity);
   if (chns_b_alloc == NULL) {
-    free(inds_b_alloc);
-    free(khs_b_alloc);
-    free(kps_b_alloc);
-    free(bbs_b_alloc);
-    free(inds_a_alloc);
-    free(chns_a_alloc);
-    free(khs_a_alloc);
-    free(kps_a_alloc);
-    free(bbs_a_alloc);
-    free(vals_alloc);
-    free(map_alloc);
+    vigor_free(inds_b_alloc);
+    vigor_free(khs_b_alloc);
+    vigor_free(kps_b_alloc);
+    vigor_free(bbs_b_alloc);
+    vigor_free(inds_a_alloc);
+    vigor_free(chns_a_alloc);
+    vigor_free(khs_a_alloc);
+    vigor_free(kps_a_alloc);
+    vigor_free(bbs_a_alloc);
+    vigor_free(vals_alloc);
+    vigor_free(map_alloc);
     *map_out = old_map_val;
     return 0;
   }
@@ -1148,7 +1153,11 @@ int dmap_put /*@ <K1,K2,V> @*/ (struct DoubleMap* map, void* value, int index)
   //@ mul_bounds(index, cap, vsz, 4096);
   //@ mul_mono_strict(index, cap, vsz);
   //@ extract_value<K1,K2,V>(map->values, vals, index);
+#ifdef VIGOR_LARGE_CAPACITY
+  void* my_value = map->values + (size_t)index * map->value_size;
+#else   // VIGOR_LARGE_CAPACITY
   void* my_value = map->values + index * map->value_size;
+#endif  // VIGOR_LARGE_CAPACITY
   uq_value_copy* cpy = map->cpy;
   cpy((char*)my_value, value);
 
@@ -1243,7 +1252,11 @@ void dmap_get_value /*@ <K1,K2,V> @*/ (struct DoubleMap* map, int index,
   //@ mul_bounds(index, cap, vsz, 4096);
   //@ mul_mono_strict(index, cap, vsz);
   //@ extract_value(map->values, vals, index);
+#ifdef VIGOR_LARGE_CAPACITY
+  void* my_value = map->values + (size_t)index * map->value_size;
+#else   // VIGOR_LARGE_CAPACITY
   void* my_value = map->values + index * map->value_size;
+#endif  // VIGOR_LARGE_CAPACITY
   uq_value_copy* cpy = map->cpy;
   cpy((char*)value_out, (char*)my_value);
   //@ glue_values(map->values, vals, index);
@@ -1647,7 +1660,11 @@ int dmap_erase /*@ <K1,K2,V> @*/ (struct DoubleMap* map, int index)
   //@ mul_bounds(index, cap, vsz, 4096);
   //@ mul_mono_strict(index, cap, vsz);
   //@ extract_value(map->values, vals, index);
+#ifdef VIGOR_LARGE_CAPACITY
+  void* my_value = map->values + (size_t)index * map->value_size;
+#else   // VIGOR_LARGE_CAPACITY
   void* my_value = map->values + index * map->value_size;
+#endif  // VIGOR_LARGE_CAPACITY
   dmap_extract_keys* exk = map->exk;
   exk(my_value, &key_a, &key_b);
   //@ assert [0.5]bvp(my_value, ?v);
@@ -1,4 +1,9 @@
+// LPM_LAYOUT=dynamic replaces this file by
+// lib/unverified/lpm-dir-24-8-dynamic.c
+#ifndef VIGOR_LPM_DYNAMIC
+
 #include "lpm-dir-24-8.h"
+#include "vigor-alloc.h"
 
 //@ #include "../proof/lpm-dir-24-8-lemmas.gh"
 
@@ -362,22 +367,23 @@ int lpm_allocate(struct lpm **lpm_out)
         table(new_lo, dir_init()) &*&
         result == 1; @*/
 {
-  struct lpm *_lpm = (struct lpm *)malloc(sizeof(struct lpm));
+  struct lpm *_lpm = (struct lpm *)vigor_malloc(sizeof(struct lpm));
   if (_lpm == 0) {
     return 0;
   }
 
-  uint16_t *lpm_24 = (uint16_t *)malloc(lpm_24_MAX_ENTRIES * sizeof(uint16_t));
+  uint16_t *lpm_24 =
+      (uint16_t *)vigor_malloc(lpm_24_MAX_ENTRIES * sizeof(uint16_t));
   if (lpm_24 == 0) {
-    free(_lpm);
+    vigor_free(_lpm);
     return 0;
   }
 
   uint16_t *lpm_long =
-      (uint16_t *)malloc(lpm_LONG_MAX_ENTRIES * sizeof(uint16_t));
+      (uint16_t *)vigor_malloc(lpm_LONG_MAX_ENTRIES * sizeof(uint16_t));
   if (lpm_long == 0) {
-    free(lpm_24);
-    free(_lpm);
+    vigor_free(lpm_24);
+    vigor_free(_lpm);
     return 0;
   }
 
@@ -445,9 +451,9 @@ void lpm_free(struct lpm *_lpm)
 //@ ensures true;
 {
   //@ open table(_lpm, _);
-  free(_lpm->lpm_24);
-  free(_lpm->lpm_long);
-  free(_lpm);
+  vigor_free(_lpm->lpm_24);
+  vigor_free(_lpm->lpm_long);
+  vigor_free(_lpm);
 }
 
 int lpm_lookup_elem(struct lpm *_lpm, uint32_t prefix)
@@ -792,3 +798,19 @@ int lpm_update_elem(struct lpm *_lpm, uint32_t prefix, uint8_t prefixlen,
   }
   return 1;
 }
+
+#ifndef KLEE_VERIFICATION
+// The 16-bit entries cannot be gathered without reading past the tables, so
+// all first-level entries are prefetched before any address is looked up
+void lpm_lookup_bulk(struct lpm *_lpm, const uint32_t *prefixes,
+                     uint16_t *values_out, unsigned n) {
+  for (unsigned i = 0; i < n; i++) {
+    __builtin_prefetch(&_lpm->lpm_24[lpm_24_extract_first_index(prefixes[i])]);
+  }
+  for (unsigned i = 0; i < n; i++) {
+    values_out[i] = lpm_lookup_elem(_lpm, prefixes[i]);
+  }
+}
+#endif  // KLEE_VERIFICATION
+
+#endif  // VIGOR_LPM_DYNAMIC
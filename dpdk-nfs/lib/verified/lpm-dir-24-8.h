@@ -71,3 +71,17 @@ int lpm_lookup_elem(struct lpm *_lpm, uint32_t prefix);
 //@ requires table(_lpm, ?dir);
 /*@ ensures table(_lpm, dir) &*&
       result == lpm_dir_24_8_lookup(Z_of_int(prefix, N32),dir); @*/
+
+#ifndef KLEE_VERIFICATION
+// Unverified: lpm_lookup_elem for n addresses, whose memory accesses overlap
+// instead of waiting on each other.
+void lpm_lookup_bulk(struct lpm *_lpm, const uint32_t *prefixes,
+                     uint16_t *values_out, unsigned n);
+#endif  // KLEE_VERIFICATION
+
+#ifdef VIGOR_LPM_DYNAMIC
+// LPM_LAYOUT=dynamic only: removes the rule of that prefix and prefixlen,
+// addresses it covered then match the next longest rule.
+// @returns 1 if the rule existed, 0 otherwise.
+int lpm_delete_elem(struct lpm *_lpm, uint32_t prefix, uint8_t prefixlen);
+#endif  // VIGOR_LPM_DYNAMIC
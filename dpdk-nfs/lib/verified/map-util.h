@@ -1,7 +1,13 @@
 #ifndef _MAP_UTIL_H_INCLUDED_
 #define _MAP_UTIL_H_INCLUDED_
 
+// LARGE_CAPACITY=true builds lift the limit, at the price of the proofs,
+// which only hold below the default one
+#ifdef VIGOR_LARGE_CAPACITY
+#define CAPACITY_UPPER_LIMIT (1 << 28)
+#else   // VIGOR_LARGE_CAPACITY
 #define CAPACITY_UPPER_LIMIT 140000
+#endif  // VIGOR_LARGE_CAPACITY
 
 #include <stdbool.h>
 
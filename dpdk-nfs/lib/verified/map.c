@@ -1,6 +1,14 @@
+// MAP_LAYOUT=bucketized replaces this file by lib/unverified/map-bucketized.c
+#ifndef VIGOR_MAP_BUCKETIZED
+
 #include <stdlib.h>
 #include <stddef.h>
 #include "map.h"
+#include "vigor-alloc.h"
+
+#ifdef VIGOR_TELEMETRY
+#include "../unverified/telemetry.h"
+#endif  // VIGOR_TELEMETRY
 
 #ifdef CAPACITY_POW2
 #include "map-impl-pow2.h"
@@ -76,50 +84,51 @@ int map_allocate /*@ <t> @*/ (map_keys_equality* keq, map_key_hash* khash,
 #endif
 
   struct Map* old_map_val = *map_out;
-  struct Map* map_alloc = (struct Map*)malloc(sizeof(struct Map));
+  struct Map* map_alloc = (struct Map*)vigor_malloc(sizeof(struct Map));
   if (map_alloc == NULL) return 0;
   *map_out = (struct Map*)map_alloc;
-  int* bbs_alloc = (int*)malloc(sizeof(int) * (int)capacity);
+  int* bbs_alloc = (int*)vigor_malloc(sizeof(int) * (int)capacity);
   if (bbs_alloc == NULL) {
-    free(map_alloc);
+    vigor_free(map_alloc);
     *map_out = old_map_val;
     return 0;
   }
   (*map_out)->busybits = bbs_alloc;
-  void** keyps_alloc = (void**)malloc(sizeof(void*) * (int)capacity);
+  void** keyps_alloc = (void**)vigor_malloc(sizeof(void*) * (int)capacity);
   if (keyps_alloc == NULL) {
-    free(bbs_alloc);
-    free(map_alloc);
+    vigor_free(bbs_alloc);
+    vigor_free(map_alloc);
     *map_out = old_map_val;
     return 0;
   }
   (*map_out)->keyps = keyps_alloc;
-  unsigned* khs_alloc = (unsigned*)malloc(sizeof(unsigned) * (int)capacity);
+  unsigned* khs_alloc =
+      (unsigned*)vigor_malloc(sizeof(unsigned) * (int)capacity);
   if (khs_alloc == NULL) {
-    free(keyps_alloc);
-    free(bbs_alloc);
-    free(map_alloc);
+    vigor_free(keyps_alloc);
+    vigor_free(bbs_alloc);
+    vigor_free(map_alloc);
     *map_out = old_map_val;
     return 0;
   }
   (*map_out)->khs = khs_alloc;
-  int* chns_alloc = (int*)malloc(sizeof(int) * (int)capacity);
+  int* chns_alloc = (int*)vigor_malloc(sizeof(int) * (int)capacity);
   if (chns_alloc == NULL) {
-    free(khs_alloc);
-    free(keyps_alloc);
-    free(bbs_alloc);
-    free(map_alloc);
+    vigor_free(khs_alloc);
+    vigor_free(keyps_alloc);
+    vigor_free(bbs_alloc);
+    vigor_free(map_alloc);
     *map_out = old_map_val;
     return 0;
   }
   (*map_out)->chns = chns_alloc;
-  int* vals_alloc = (int*)malloc(sizeof(int) * (int)capacity);
+  int* vals_alloc = (int*)vigor_malloc(sizeof(int) * (int)capacity);
   if (vals_alloc == NULL) {
-    free(chns_alloc);
-    free(khs_alloc);
-    free(keyps_alloc);
-    free(bbs_alloc);
-    free(map_alloc);
+    vigor_free(chns_alloc);
+    vigor_free(khs_alloc);
+    vigor_free(keyps_alloc);
+    vigor_free(bbs_alloc);
+    vigor_free(map_alloc);
     *map_out = old_map_val;
     return 0;
   }
@@ -136,6 +145,9 @@ int map_allocate /*@ <t> @*/ (map_keys_equality* keq, map_key_hash* khash,
   /*@
     close mapp<t>(*map_out, kp, hsh, nop_true, mapc(capacity, nil, nil));
     @*/
+#ifdef VIGOR_TELEMETRY
+  telemetry_add_map(*map_out, capacity);
+#endif  // VIGOR_TELEMETRY
   return 1;
 }
 
@@ -315,3 +327,124 @@ kt k2)
   }
   }
   @*/
+
+#ifndef KLEE_VERIFICATION
+unsigned map_prefetch(struct Map* map, void* key) {
+  unsigned hash = map->khash(key);
+  map_prefetch_with_hash(map, hash);
+  return hash;
+}
+
+void map_prefetch_with_hash(struct Map* map, unsigned hash) {
+#ifdef CAPACITY_POW2
+  unsigned index = hash & (map->capacity - 1);
+#else
+  unsigned index = hash % map->capacity;
+#endif
+  __builtin_prefetch(&map->busybits[index]);
+  __builtin_prefetch(&map->khs[index]);
+  __builtin_prefetch(&map->keyps[index]);
+  __builtin_prefetch(&map->vals[index]);
+}
+
+int map_get_with_hash(struct Map* map, void* key, unsigned hash,
+                      int* value_out) {
+  return map_impl_get(map->busybits, map->keyps, map->khs, map->chns, map->vals,
+                      key, map->keys_eq, hash, value_out, map->capacity);
+}
+
+void map_put_with_hash(struct Map* map, void* key, unsigned hash, int value) {
+  map_impl_put(map->busybits, map->keyps, map->khs, map->chns, map->vals, key,
+               hash, value, map->capacity);
+  ++map->size;
+}
+
+// map-layout.h mirrors the layout of struct Map
+#include "../unverified/map-layout.h"
+
+#define MAP_LAYOUT_CHECK(field)                                             \
+  _Static_assert(offsetof(struct Map, field) ==                             \
+                     offsetof(struct map_layout, field),                    \
+                 "struct map_layout does not match struct Map: " #field)
+MAP_LAYOUT_CHECK(busybits);
+MAP_LAYOUT_CHECK(keyps);
+MAP_LAYOUT_CHECK(khs);
+MAP_LAYOUT_CHECK(chns);
+MAP_LAYOUT_CHECK(vals);
+MAP_LAYOUT_CHECK(capacity);
+MAP_LAYOUT_CHECK(size);
+MAP_LAYOUT_CHECK(keys_eq);
+MAP_LAYOUT_CHECK(khash);
+
+static inline unsigned map_next_index(struct Map* map, unsigned index) {
+  return index + 1 == map->capacity ? 0 : index + 1;
+}
+
+static inline void map_prefetch_slot(struct Map* map, unsigned index) {
+  __builtin_prefetch(&map->busybits[index]);
+  __builtin_prefetch(&map->khs[index]);
+  __builtin_prefetch(&map->chns[index]);
+}
+
+// Same probing as find_key in map-impl.c, with the keys in lockstep:
+// every round, each pending key inspects the metadata of one slot, which is
+// already in flight; keys whose hash matches have their key and value
+// prefetched, and are only compared once all keys have been inspected.
+unsigned map_get_bulk(struct Map* map, void** keys, unsigned* hashes,
+                      unsigned n, int* values_out, uint64_t* hit_mask) {
+  unsigned indexes[MAP_BULK_MAX];
+  unsigned probes[MAP_BULK_MAX];
+  uint64_t pending = n == MAP_BULK_MAX ? ~0ULL : (1ULL << n) - 1;
+  uint64_t hits = 0;
+
+  for (unsigned i = 0; i < n; i++) {
+    hashes[i] = map->khash(keys[i]);
+#ifdef CAPACITY_POW2
+    indexes[i] = hashes[i] & (map->capacity - 1);
+#else
+    indexes[i] = hashes[i] % map->capacity;
+#endif
+    probes[i] = 0;
+    map_prefetch_slot(map, indexes[i]);
+    __builtin_prefetch(&map->keyps[indexes[i]]);
+  }
+
+  while (pending != 0) {
+    uint64_t candidates = 0;
+    for (uint64_t left = pending; left != 0; left &= left - 1) {
+      unsigned i = __builtin_ctzll(left);
+      unsigned index = indexes[i];
+      if (map->busybits[index] != 0 && map->khs[index] == hashes[i]) {
+        candidates |= 1ULL << i;
+        __builtin_prefetch(map->keyps[index]);
+        __builtin_prefetch(&map->vals[index]);
+      } else if (map->chns[index] == 0 || ++probes[i] == map->capacity) {
+        pending &= ~(1ULL << i);
+      } else {
+        indexes[i] = map_next_index(map, index);
+        map_prefetch_slot(map, indexes[i]);
+      }
+    }
+
+    for (; candidates != 0; candidates &= candidates - 1) {
+      unsigned i = __builtin_ctzll(candidates);
+      unsigned index = indexes[i];
+      if (map->keys_eq(map->keyps[index], keys[i])) {
+        values_out[i] = map->vals[index];
+        hits |= 1ULL << i;
+        pending &= ~(1ULL << i);
+      } else if (++probes[i] == map->capacity) {
+        pending &= ~(1ULL << i);
+      } else {
+        indexes[i] = map_next_index(map, index);
+        map_prefetch_slot(map, indexes[i]);
+      }
+    }
+  }
+
+  *hit_mask = hits;
+  return __builtin_popcountll(hits);
+}
+#endif  // KLEE_VERIFICATION
+
+#endif  // VIGOR_MAP_BUCKETIZED
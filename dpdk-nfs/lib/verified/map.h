@@ -110,4 +110,36 @@ ensures false == distinct(map(snd, m));
   ensures true == forall(map_erase_all_fp(m, keys), inv);
   @*/
 
+#ifndef KLEE_VERIFICATION
+#include <stdint.h>
+
+// Unverified, for the batched datapath: hashes the key and prefetches the
+// bucket where a lookup of it starts, so that a later map_get is less likely
+// to wait on memory.
+// @returns the hash of the key.
+unsigned map_prefetch(struct Map* map, void* key);
+
+// Unverified: map_prefetch for a key whose hash is already known, as below.
+void map_prefetch_with_hash(struct Map* map, unsigned hash);
+
+// Unverified: map_get and map_put for a key whose hash is already known,
+// e.g. from map_prefetch, or from the NIC for keys hashed with
+// rss_hash_ipv4_tcpudp; it must be what the map's key hash returns for key.
+int map_get_with_hash(struct Map* map, void* key, unsigned hash,
+                      int* value_out);
+void map_put_with_hash(struct Map* map, void* key, unsigned hash, int value);
+
+// At most that many keys per map_get_bulk call, one bit each in the hit mask
+#define MAP_BULK_MAX 64
+
+// Unverified: map_get for a burst of keys. Hashes all keys into hashes[]
+// (e.g. for a later map_put), prefetches all their buckets, then probes them
+// in rounds, one bucket per pending key per round, so that the memory
+// accesses of different keys overlap instead of waiting on each other.
+// Sets bit i of *hit_mask, and values_out[i], iff keys[i] is in the map.
+// @returns the number of keys in the map.
+unsigned map_get_bulk(struct Map* map, void** keys, unsigned* hashes,
+                      unsigned n, int* values_out, uint64_t* hit_mask);
+#endif  // KLEE_VERIFICATION
+
 #endif  //_MAP_H_INCLUDED_
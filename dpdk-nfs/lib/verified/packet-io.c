@@ -1,13 +1,50 @@
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <rte_ip.h>
 #include <rte_mbuf.h>
 #include <rte_memcpy.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif  // __SSE2__
+
+#include "boilerplate-util.h"
 #include "packet-io.h"
 
-size_t global_total_length;
-size_t global_read_length = 0;
+// The state of the packet being processed, one per lcore: nf_process returns
+// all chunks of a packet before the next one is borrowed from, so an lcore
+// never has several packets in flight
+VIGOR_PER_LCORE size_t global_total_length;
+VIGOR_PER_LCORE size_t global_read_length = 0;
+
+#ifndef KLEE_VERIFICATION
+VIGOR_PER_LCORE struct rte_mbuf *global_mbuf;
+#endif  // KLEE_VERIFICATION
+
+#ifdef VIGOR_MTU
+// Jumbo frames are chains of mbuf segments. Chunks within the first segment
+// are borrowed as usual; further ones point into their segment if they fit
+// in it, or are copied into a per-lcore buffer and back to the segments when
+// returned. Chunks are returned in the reverse order of borrowing, so those
+// "remote" chunks are kept on a stack.
+#define PACKET_LINEAR_BUFFER_SIZE 512
+#define PACKET_MAX_REMOTE_CHUNKS 16
+
+struct remote_chunk {
+  uint8_t *chunk;
+  size_t offset;
+  size_t length;
+  bool linearized;
+};
+
+VIGOR_PER_LCORE size_t global_segment_length;
+VIGOR_PER_LCORE struct remote_chunk
+    global_remote_chunks[PACKET_MAX_REMOTE_CHUNKS];
+VIGOR_PER_LCORE size_t global_remote_chunk_count;
+VIGOR_PER_LCORE uint8_t global_linear_buffer[PACKET_LINEAR_BUFFER_SIZE];
+VIGOR_PER_LCORE size_t global_linear_length;
+#endif  // VIGOR_MTU
 
 /*@
   fixpoint bool missing_chunks(list<pair<int8_t*, int> > missing_chunks, int8_t*
@@ -50,6 +87,77 @@ void packet_state_total_length(void *p, uint32_t *len)
   //@ close packetp(p, unread, nil);
 }
 
+#ifndef KLEE_VERIFICATION
+void packet_state_mbuf(struct rte_mbuf *mbuf) {
+  global_mbuf = mbuf;
+#ifdef VIGOR_MTU
+  global_segment_length = rte_pktmbuf_data_len(mbuf);
+  global_remote_chunk_count = 0;
+  global_linear_length = 0;
+#endif  // VIGOR_MTU
+}
+
+struct rte_mbuf *packet_get_mbuf(void) { return global_mbuf; }
+#endif  // KLEE_VERIFICATION
+
+#ifdef VIGOR_MTU
+
+static void *borrow_remote_chunk(size_t offset, size_t length) {
+  assert(global_remote_chunk_count < PACKET_MAX_REMOTE_CHUNKS);
+  assert(global_linear_length + length <= PACKET_LINEAR_BUFFER_SIZE);
+  uint8_t *buffer = global_linear_buffer + global_linear_length;
+  // Only copies if the chunk spans segments
+  uint8_t *chunk =
+      (uint8_t *)rte_pktmbuf_read(global_mbuf, offset, length, buffer);
+  assert(chunk != NULL);
+
+  struct remote_chunk *remote =
+      &global_remote_chunks[global_remote_chunk_count++];
+  remote->chunk = chunk;
+  remote->offset = offset;
+  remote->length = length;
+  remote->linearized = chunk == buffer;
+  if (remote->linearized) {
+    global_linear_length += length;
+  }
+  return chunk;
+}
+
+static void return_remote_chunk(void) {
+  struct remote_chunk *remote =
+      &global_remote_chunks[--global_remote_chunk_count];
+  if (remote->linearized) {
+    struct rte_mbuf *segment = global_mbuf;
+    size_t offset = remote->offset;
+    while (offset >= rte_pktmbuf_data_len(segment)) {
+      offset -= rte_pktmbuf_data_len(segment);
+      segment = segment->next;
+    }
+    const uint8_t *src = remote->chunk;
+    size_t length = remote->length;
+    while (length > 0) {
+      size_t n = RTE_MIN(length, rte_pktmbuf_data_len(segment) - offset);
+      rte_memcpy(rte_pktmbuf_mtod_offset(segment, uint8_t *, offset), src, n);
+      src += n;
+      length -= n;
+      offset = 0;
+      segment = segment->next;
+    }
+    global_linear_length -= remote->length;
+  }
+  global_read_length = remote->offset;
+}
+
+static struct remote_chunk *find_remote_chunk(void *chunk) {
+  for (size_t i = global_remote_chunk_count; i-- > 0;) {
+    if (global_remote_chunks[i].chunk == chunk) {
+      return &global_remote_chunks[i];
+    }
+  }
+  return NULL;
+}
+#endif  // VIGOR_MTU
+
 /*@
   lemma void borrowed_len_nonneg(list<pair<int8_t*, int> > missing_chunks,
                  int8_t* start, int8_t* beginning)
@@ -84,7 +192,13 @@ void packet_borrow_next_chunk(void *p, size_t length, void **chunk)
   //@ assert 0 <= global_read_length;
   //@ assert p > 0;
   //@ assert p + global_read_length > 0;
-  // TODO: support mbuf chains.
+#ifdef VIGOR_MTU
+  if (global_read_length + length > global_segment_length) {
+    *chunk = borrow_remote_chunk(global_read_length, length);
+    global_read_length += length;
+    return;
+  }
+#endif  // VIGOR_MTU
   *chunk = (char *)p + global_read_length;
   //@ chars_split(*chunk, length);
   global_read_length += length;
@@ -98,73 +212,210 @@ void packet_return_chunk(void *p, void *chunk)
 /*@ ensures packetp(p, append(chnk, unread), mc); @*/
 {
   //@ open packetp(p, unread, cons(pair(chunk, len), mc));
+#ifdef VIGOR_MTU
+  if (global_remote_chunk_count != 0 &&
+      global_remote_chunks[global_remote_chunk_count - 1].chunk == chunk) {
+    return_remote_chunk();
+    return;
+  }
+#endif  // VIGOR_MTU
   global_read_length = (uint32_t)((int8_t *)chunk - (int8_t *)p);
   //@ close packetp(p, append(chnk, unread), mc);
 }
 
-void packet_shrink_chunk(void **p, size_t length, void **chunks,
-                         size_t num_chunks, struct rte_mbuf *mbuf) {
-  uint8_t *data = (uint8_t *)(*p);
-
-  void *last_chunk = chunks[num_chunks - 1];
-  size_t last_chunk_length = packet_get_chunk_length(data, last_chunk);
-  uint8_t *last_chunk_limit = last_chunk + last_chunk_length;
-
-  assert(length <= last_chunk_length);
-  size_t offset = last_chunk_length - length;
+// Chunk edits resize borrowed chunks, or add one after them, and move the
+// bytes around the edits in as few moves as possible. The bytes between two
+// edits move as one block, and either all blocks before the last edit move
+// (the packet starts earlier or later in the mbuf, like with
+// rte_pktmbuf_prepend/adj) or all blocks after the first one do (the packet
+// ends earlier or later, like with rte_pktmbuf_append/trim), whichever moves
+// fewer bytes and fits in the mbuf's headroom or tailroom.
+// The tail of the packet can only move if the mbuf is contiguous, and with
+// MTU, only chunks in the first segment can be edited.
 
-  if (offset == 0) {
-    return;
+// Moves n bytes between possibly overlapping locations: all bytes are loaded
+// before any is stored, as at most 4 overlapping words or 16-byte vectors
+static inline void move_bytes(uint8_t *dst, const uint8_t *src, size_t n) {
+  if (n < 4) {
+    uint8_t bytes[3];
+    for (size_t i = 0; i < n; i++) {
+      bytes[i] = src[i];
+    }
+    for (size_t i = 0; i < n; i++) {
+      dst[i] = bytes[i];
+    }
+  } else if (n < 8) {
+    uint32_t a, b;
+    memcpy(&a, src, 4);
+    memcpy(&b, src + n - 4, 4);
+    memcpy(dst, &a, 4);
+    memcpy(dst + n - 4, &b, 4);
+  } else if (n < 16) {
+    uint64_t a, b;
+    memcpy(&a, src, 8);
+    memcpy(&b, src + n - 8, 8);
+    memcpy(dst, &a, 8);
+    memcpy(dst + n - 8, &b, 8);
+#ifdef __SSE2__
+  } else if (n <= 64) {
+    size_t second = n >= 32 ? 16 : n - 16;
+    size_t third = n >= 32 ? n - 32 : 0;
+    __m128i a = _mm_loadu_si128((const __m128i *)src);
+    __m128i b = _mm_loadu_si128((const __m128i *)(src + second));
+    __m128i c = _mm_loadu_si128((const __m128i *)(src + third));
+    __m128i d = _mm_loadu_si128((const __m128i *)(src + n - 16));
+    _mm_storeu_si128((__m128i *)dst, a);
+    _mm_storeu_si128((__m128i *)(dst + second), b);
+    _mm_storeu_si128((__m128i *)(dst + third), c);
+    _mm_storeu_si128((__m128i *)(dst + n - 16), d);
+#endif  // __SSE2__
+  } else {
+    memmove(dst, src, n);
   }
+}
 
-  uint8_t *current = last_chunk_limit - 1;
+// The bytes between two edits move as one block: block k ends with the
+// bytes edit k keeps, and the last block is the rest of the packet.
+// Its offset is where it moves if the tail of the packet moves: the sum of
+// the deltas of the edits before it.
+struct edit_block {
+  uint8_t *start;
+  size_t length;
+  ptrdiff_t offset;
+};
 
-  while (current >= data + offset) {
-    rte_memcpy(current, current - offset, 1);
-    current--;
+// Blocks keep their order, so a block moving towards the start of the packet
+// only lands on blocks before it, and one moving towards the end only on
+// blocks after it: the former move first to last, the latter last to first.
+static inline void move_blocks(struct edit_block *blocks, size_t first,
+                               size_t last, ptrdiff_t base) {
+  for (size_t k = first; k <= last; k++) {
+    if (blocks[k].offset < base) {
+      move_bytes(blocks[k].start + blocks[k].offset - base, blocks[k].start,
+                 blocks[k].length);
+    }
   }
-
-  data = (uint8_t *)rte_pktmbuf_adj(mbuf, offset);
-  assert(data);
-
-  global_read_length -= offset;
-  global_total_length -= offset;
-
-  for (int i = 0; i < num_chunks; i++) {
-    chunks[i] += offset;
+  for (size_t k = last + 1; k-- > first;) {
+    if (blocks[k].offset > base) {
+      move_bytes(blocks[k].start + blocks[k].offset - base, blocks[k].start,
+                 blocks[k].length);
+    }
   }
-
-  (*p) = data;
 }
 
-void packet_insert_new_chunk(void **p, size_t length, void **chunks,
-                             size_t *num_chunks, struct rte_mbuf *mbuf) {
-  uint8_t *data = (uint8_t *)(*p);
-  uint8_t *last_chunk_limit = data + global_read_length;
+// Inlined where the number of edits is known, so that loops over edits unroll
+static inline __attribute__((always_inline)) void edit_chunks(
+    void **p, void **chunks, size_t *num_chunks,
+    const struct packet_chunk_edit *edits, size_t num_edits,
+    struct rte_mbuf *mbuf) {
+  assert(num_edits <= PACKET_MAX_CHUNK_EDITS);
+  if (num_edits == 0) {
+    return;
+  }
+#ifdef VIGOR_MTU
+  assert(global_remote_chunk_count == 0);
+#endif  // VIGOR_MTU
 
-  data = (uint8_t *)rte_pktmbuf_prepend(mbuf, length);
-  assert(data);
+  uint8_t *data = (uint8_t *)(*p);
+  uint8_t *read_limit = data + global_read_length;
+  struct edit_block blocks[PACKET_MAX_CHUNK_EDITS + 1];
+  uint8_t *next_start = data;
+  ptrdiff_t delta = 0;
+  for (size_t k = 0; k < num_edits; k++) {
+    size_t chunk = edits[k].chunk;
+    assert(k == 0 || edits[k - 1].chunk < chunk);
+    assert(chunk <= *num_chunks);
+    uint8_t *chunk_start = chunk == *num_chunks ? read_limit : chunks[chunk];
+    uint8_t *chunk_limit =
+        chunk + 1 >= *num_chunks ? read_limit : chunks[chunk + 1];
+    size_t old_length = chunk_limit - chunk_start;
+    size_t kept = edits[k].length < old_length ? edits[k].length : old_length;
 
-  uint8_t *current = data;
+    blocks[k].start = next_start;
+    blocks[k].length = chunk_start + kept - next_start;
+    blocks[k].offset = delta;
+    next_start = chunk_limit;
+    delta += (ptrdiff_t)edits[k].length - (ptrdiff_t)old_length;
+  }
+  blocks[num_edits].start = next_start;
+  blocks[num_edits].length = data + global_total_length - next_start;
+  blocks[num_edits].offset = delta;
 
-  while (current + length < last_chunk_limit) {
-    rte_memcpy(current, current + length, 1);
-    current++;
+  // Moving the head of the packet moves the blocks before the last one by
+  // their offset minus delta, moving the tail the blocks after the first one
+  bool head_fits = delta <= (ptrdiff_t)rte_pktmbuf_headroom(mbuf);
+  bool tail_fits = rte_pktmbuf_is_contiguous(mbuf) &&
+                   delta <= (ptrdiff_t)rte_pktmbuf_tailroom(mbuf);
+  assert(head_fits || tail_fits);
+  size_t head_moved = 0;
+  size_t tail_moved = 0;
+  for (size_t k = 0; k <= num_edits; k++) {
+    head_moved += k < num_edits && blocks[k].offset != delta
+                      ? blocks[k].length
+                      : 0;
+    tail_moved += blocks[k].offset != 0 ? blocks[k].length : 0;
+  }
+  ptrdiff_t base = 0;
+  if (head_fits && (!tail_fits || head_moved <= tail_moved)) {
+    base = delta;
+    move_blocks(blocks, 0, num_edits - 1, base);
+    (*p) = delta >= 0 ? rte_pktmbuf_prepend(mbuf, delta)
+                      : rte_pktmbuf_adj(mbuf, -delta);
+    assert(*p);
+  } else {
+    move_blocks(blocks, 1, num_edits, base);
+    bool resized = delta >= 0 ? rte_pktmbuf_append(mbuf, delta) != NULL
+                              : rte_pktmbuf_trim(mbuf, -delta) == 0;
+    assert(resized);
   }
 
-  for (int i = 0; i < (*num_chunks); i++) {
-    chunks[i] -= length;
+  // Chunk i moves with the block of the first edit at or after it
+  size_t k = 0;
+  for (size_t i = 0; i < *num_chunks; i++) {
+    if (k < num_edits && edits[k].chunk < i) {
+      k++;
+    }
+    chunks[i] = (uint8_t *)chunks[i] + blocks[k].offset - base;
+  }
+  if (edits[num_edits - 1].chunk == *num_chunks) {
+    chunks[*num_chunks] = read_limit + blocks[num_edits - 1].offset - base;
+    (*num_chunks)++;
   }
 
-  assert(chunks[0] == data);
+  global_read_length += delta;
+  global_total_length += delta;
+#ifdef VIGOR_MTU
+  global_segment_length += delta;
+#endif  // VIGOR_MTU
+}
 
-  (*num_chunks)++;
-  (*p) = data;
+void packet_edit_chunks(void **p, void **chunks, size_t *num_chunks,
+                        const struct packet_chunk_edit *edits,
+                        size_t num_edits, struct rte_mbuf *mbuf) {
+  // Few edits are the common case, and worth unrolled copies
+  switch (num_edits) {
+    case 1:
+      edit_chunks(p, chunks, num_chunks, edits, 1, mbuf);
+      break;
+    case 2:
+      edit_chunks(p, chunks, num_chunks, edits, 2, mbuf);
+      break;
+    default:
+      edit_chunks(p, chunks, num_chunks, edits, num_edits, mbuf);
+  }
+}
 
-  chunks[(*num_chunks) - 1] = data + global_read_length;
+void packet_shrink_chunk(void **p, size_t length, void **chunks,
+                         size_t num_chunks, struct rte_mbuf *mbuf) {
+  assert(length <= packet_get_chunk_length(*p, chunks[num_chunks - 1]));
+  struct packet_chunk_edit edit = {.chunk = num_chunks - 1, .length = length};
+  edit_chunks(p, chunks, &num_chunks, &edit, 1, mbuf);
+}
 
-  global_read_length += length;
-  global_total_length += length;
+void packet_insert_new_chunk(void **p, size_t length, void **chunks,
+                             size_t *num_chunks, struct rte_mbuf *mbuf) {
+  struct packet_chunk_edit edit = {.chunk = *num_chunks, .length = length};
+  edit_chunks(p, chunks, num_chunks, &edit, 1, mbuf);
 }
 
 uint32_t packet_get_unread_length(void *p)
@@ -178,5 +429,11 @@ uint32_t packet_get_unread_length(void *p)
 }
 
 size_t packet_get_chunk_length(void *p, void *chunk) {
+#ifdef VIGOR_MTU
+  struct remote_chunk *remote = find_remote_chunk(chunk);
+  if (remote != NULL) {
+    return global_read_length - remote->offset;
+  }
+#endif  // VIGOR_MTU
   return (uint32_t)(((char *)p + global_read_length) - (char *)chunk);
 }
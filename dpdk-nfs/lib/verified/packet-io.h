@@ -60,6 +60,31 @@ void packet_shrink_chunk(void **p, size_t length, void **chunks,
 void packet_insert_new_chunk(void **p, size_t length, void **chunks,
                              size_t *num_chunks, struct rte_mbuf *mbuf);
 
+#ifndef KLEE_VERIFICATION
+// Unverified: several packet_shrink_chunk/packet_insert_new_chunk-like edits
+// with a single pass over the packet.
+// Edit chunk i (< *num_chunks) sets the length of borrowed chunk i, dropping
+// bytes from its end or adding uninitialized ones there; edit chunk
+// *num_chunks adds a new chunk of that length after the borrowed ones.
+// Edits are sorted by chunk, at most PACKET_MAX_CHUNK_EDITS of them. Like
+// with the other edits, any borrowed chunk may move.
+#define PACKET_MAX_CHUNK_EDITS 8
+
+struct packet_chunk_edit {
+  size_t chunk;
+  size_t length;
+};
+
+void packet_edit_chunks(void **p, void **chunks, size_t *num_chunks,
+                        const struct packet_chunk_edit *edits,
+                        size_t num_edits, struct rte_mbuf *mbuf);
+
+// Unverified: the mbuf of the packet, called after packet_state_total_length;
+// with MTU, the packet may be a chain of segments, see packet-io.c
+void packet_state_mbuf(struct rte_mbuf *mbuf);
+struct rte_mbuf *packet_get_mbuf(void);
+#endif  // KLEE_VERIFICATION
+
 size_t packet_get_chunk_length(void *p, void *chunk);
 
 bool packet_receive(uint16_t src_device, void **p, uint32_t *len);
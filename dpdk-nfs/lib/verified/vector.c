@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include "vector.h"
+#include "vigor-alloc.h"
 
 //@ #include "../proof/arith.gh"
 //@ #include "../proof/stdex.gh"
@@ -162,13 +163,19 @@ int vector_allocate /*@ <t> @*/ (int elem_size, unsigned capacity,
          true == forall(contents, is_one)); @*/
 {
   struct Vector* old_vector_val = *vector_out;
-  struct Vector* vector_alloc = (struct Vector*)malloc(sizeof(struct Vector));
+  struct Vector* vector_alloc =
+      (struct Vector*)vigor_malloc(sizeof(struct Vector));
   if (vector_alloc == 0) return 0;
   *vector_out = (struct Vector*)vector_alloc;
   //@ mul_bounds(elem_size, 4096, capacity, VECTOR_CAPACITY_UPPER_LIMIT);
-  char* data_alloc = (char*)malloc((uint32_t)elem_size * capacity);
+#ifdef VIGOR_LARGE_CAPACITY
+  // Vectors of large builds may exceed 4GB
+  char* data_alloc = (char*)vigor_malloc((size_t)elem_size * capacity);
+#else   // VIGOR_LARGE_CAPACITY
+  char* data_alloc = (char*)vigor_malloc((uint32_t)elem_size * capacity);
+#endif  // VIGOR_LARGE_CAPACITY
   if (data_alloc == 0) {
-    free(vector_alloc);
+    vigor_free(vector_alloc);
     *vector_out = old_vector_val;
     return 0;
   }
@@ -206,7 +213,11 @@ int vector_allocate /*@ <t> @*/ (int elem_size, unsigned capacity,
     //@ assert 0 < elem_size;
     //@ mul_mono(0, i, elem_size);
     //@ assert 0 <= elem_size*i;
+#ifdef VIGOR_LARGE_CAPACITY
+    init_elem((*vector_out)->data + (size_t)elem_size * i);
+#else   // VIGOR_LARGE_CAPACITY
     init_elem((*vector_out)->data + elem_size * (int)i);
+#endif  // VIGOR_LARGE_CAPACITY
     //@ assert entp(data + elem_size*i, val);
     //@ close upperbounded_ptr(data + elem_size*(i + 1));
     //@ append_to_entsp(data, data + elem_size*i);
@@ -309,7 +320,11 @@ void vector_borrow /*@ <t> @*/ (struct Vector* vector, int index,
   //@ extract_by_index<t>(vector->data, index);
   //@ mul_mono_strict(index, length(values), vector->elem_size);
   //@ mul_bounds(index, length(values), vector->elem_size, 4096);
+#ifdef VIGOR_LARGE_CAPACITY
+  *val_out = vector->data + (size_t)index * vector->elem_size;
+#else   // VIGOR_LARGE_CAPACITY
   *val_out = vector->data + index * vector->elem_size;
+#endif  // VIGOR_LARGE_CAPACITY
   //@ gen_addrs_index(vector->data, vector->elem_size, length(values), index);
   //@ take_update_unrelevant(index, index, pair(val, 0.0), values);
   //@ drop_update_unrelevant(index + 1, index, pair(val, 0.0), values);
@@ -523,3 +538,13 @@ void vector_return /*@ <t> @*/ (struct Vector* vector, int index, void* value)
   }
   }
   @*/
+
+#ifndef KLEE_VERIFICATION
+void vector_prefetch(struct Vector* vector, int index) {
+#ifdef VIGOR_LARGE_CAPACITY
+  __builtin_prefetch(vector->data + (size_t)index * vector->elem_size);
+#else   // VIGOR_LARGE_CAPACITY
+  __builtin_prefetch(vector->data + index * vector->elem_size);
+#endif  // VIGOR_LARGE_CAPACITY
+}
+#endif  // KLEE_VERIFICATION
@@ -5,7 +5,12 @@
 //@ #include "../proof/listexex.gh"
 //@ #include "../proof/listutils.gh"
 
+// See CAPACITY_UPPER_LIMIT in map-util.h
+#ifdef VIGOR_LARGE_CAPACITY
+#define VECTOR_CAPACITY_UPPER_LIMIT (1 << 28)
+#else   // VIGOR_LARGE_CAPACITY
 #define VECTOR_CAPACITY_UPPER_LIMIT 140000
+#endif  // VIGOR_LARGE_CAPACITY
 
 struct Vector;
 
@@ -145,4 +150,10 @@ void vector_return /*@ <t> @*/ (struct Vector* vector, int index, void* value);
 /*@ ensures vectorp<t>(vector, entp, update(index, pair(v, frac), values),
    addrs) &*& (frac == 0 ? [0]entp(value, v) : true); @*/
 
+#ifndef KLEE_VERIFICATION
+// Unverified, for the batched datapath: prefetches the given slot,
+// so that a later vector_borrow of it is less likely to wait on memory.
+void vector_prefetch(struct Vector* vector, int index);
+#endif  // KLEE_VERIFICATION
+
 #endif  //_VECTOR_H_INCLUDED_
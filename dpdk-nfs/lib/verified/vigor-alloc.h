@@ -0,0 +1,40 @@
+#ifndef _VIGOR_ALLOC_H_INCLUDED_
+#define _VIGOR_ALLOC_H_INCLUDED_
+
+#include <stddef.h>
+#include <stdlib.h>
+
+// Memory allocation for the data structures and the NF state.
+// Symbex sees plain malloc and free; at runtime, allocations go through a
+// pluggable allocator, which by default hands out cache-line-aligned hugepage
+// memory on the NUMA socket of the NICs.
+#ifdef KLEE_VERIFICATION
+#define vigor_malloc malloc
+#define vigor_free free
+#else  // KLEE_VERIFICATION
+
+typedef void *vigor_malloc_fn(size_t size);
+typedef void vigor_free_fn(void *ptr);
+
+void *vigor_malloc(size_t size);
+void vigor_free(void *ptr);
+
+// Replaces the allocator; must be called before any allocation, since memory
+// must be freed by the allocator it came from.
+void vigor_set_allocator(vigor_malloc_fn *malloc_fn, vigor_free_fn *free_fn);
+
+// Sets the NUMA socket the default allocator allocates on,
+// SOCKET_ID_ANY by default
+void vigor_alloc_set_socket(int socket);
+
+// Bytes allocated so far by the calling lcore through the default allocator
+struct vigor_alloc_stats {
+  size_t hugepage_bytes;
+  size_t fallback_bytes;  // regular pages: hugepages ran out, or --no-huge
+};
+
+void vigor_alloc_get_stats(struct vigor_alloc_stats *stats_out);
+
+#endif  // KLEE_VERIFICATION
+
+#endif  //_VIGOR_ALLOC_H_INCLUDED_
@@ -1,4 +1,5 @@
 #include "vigor-time.h"
+#include "boilerplate-util.h"
 
 #include <time.h>
 #include <assert.h>
@@ -7,7 +8,23 @@
 #include <nfos_tsc.h>
 #endif
 
-vigor_time_t last_time = 0;
+// The TSC clock is only for the DPDK runtime;
+// NFOS and the models have their own clock_gettime
+#if defined(VIGOR_TSC_TIME) && !defined(NFOS) && !defined(KLEE_VERIFICATION)
+#define VIGOR_TSC_CLOCK
+#include <rte_cycles.h>
+#endif
+
+VIGOR_PER_LCORE vigor_time_t last_time = 0;
+
+#ifdef VIGOR_TSC_CLOCK
+// Fixed-point TSC to nanoseconds conversion, set once by vigor_time_init:
+// ns = base_ns + ((tsc - base_tsc) * mult) >> shift
+#define VIGOR_TSC_SHIFT 32
+static uint64_t tsc_mult;
+static uint64_t tsc_base;
+static vigor_time_t tsc_base_ns;
+#endif  // VIGOR_TSC_CLOCK
 
 #ifdef NFOS
 time_t time(time_t *timer) { assert(0); }
@@ -52,13 +69,35 @@ int gettimeofday(struct timeval *tv, void *tz) {
 }
 #endif
 
+void vigor_time_init(void)
+//@ requires true;
+//@ ensures true;
+{
+#ifdef VIGOR_TSC_CLOCK
+  // Anchor the TSC to the monotonic clock, so that times keep their meaning
+  struct timespec tp;
+  clock_gettime(CLOCK_MONOTONIC, &tp);
+  tsc_base = rte_rdtsc();
+  tsc_base_ns = tp.tv_sec * VIGOR_TIME_SECONDS_MULTIPLIER + tp.tv_nsec;
+  tsc_mult = (VIGOR_TIME_SECONDS_MULTIPLIER << VIGOR_TSC_SHIFT) /
+             rte_get_tsc_hz();
+#endif  // VIGOR_TSC_CLOCK
+}
+
 vigor_time_t current_time(void)
 //@ requires last_time(?x);
 //@ ensures result >= 0 &*& x <= result &*& last_time(result);
 {
+#ifdef VIGOR_TSC_CLOCK
+  // Assumes an invariant TSC, synchronized across cores
+  uint64_t cycles = rte_rdtsc() - tsc_base;
+  last_time = tsc_base_ns +
+              (vigor_time_t)(((__uint128_t)cycles * tsc_mult) >> VIGOR_TSC_SHIFT);
+#else   // VIGOR_TSC_CLOCK
   struct timespec tp;
   clock_gettime(CLOCK_MONOTONIC, &tp);
   last_time = tp.tv_sec * 1000000000ul + tp.tv_nsec;
+#endif  // VIGOR_TSC_CLOCK
   return last_time;
 }
 
@@ -11,6 +11,13 @@
 
 //@ predicate last_time(vigor_time_t t);
 
+// Sets up the clock used by current_time; must be called once, before any
+// call to current_time. Only does anything for the TSC-based clock, i.e. when
+// building with VIGOR_TSC_TIME.
+void vigor_time_init(void);
+//@ requires true;
+//@ ensures true;
+
 // A wrapper around the system time function. Returns the number of
 // nanoseconds since the Epoch (1970-01-01 00:00:00 +0000 (UTC)).
 // @returns the number of nanoseconds since Epoch.
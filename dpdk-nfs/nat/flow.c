@@ -68,4 +68,6 @@ unsigned FlowId_hash(void* obj) {
   return hash;
 }
 
+MAP_SPECIALIZE_DEFINE(FlowId, struct FlowId, FlowId_hash, FlowId_eq)
+
 #endif  // KLEE_VERIFICATION
@@ -16,6 +16,7 @@ struct FlowId {
 #include "lib/verified/boilerplate-util.h"
 
 #include "lib/verified/ether.h"
+#include "lib/unverified/map-specialize.h"
 
 #include "flow.h"
 
@@ -36,6 +37,8 @@ void FlowId_allocate(void* obj);
   p("protocol: %d", (obj)->protocol);               \
   p("}");
 
+MAP_SPECIALIZE_DECLARE(FlowId, struct FlowId)
+
 #ifdef KLEE_VERIFICATION
 #include <klee/klee.h>
 #include "lib/models/str-descr.h"
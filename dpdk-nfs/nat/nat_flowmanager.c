@@ -9,6 +9,9 @@
 #include "lib/verified/map.h"
 #include "lib/verified/vector.h"
 #include "lib/verified/expirator.h"
+#ifdef VIGOR_EXPIRATION_BUDGET
+#include "lib/unverified/expirator.h"
+#endif  // VIGOR_EXPIRATION_BUDGET
 
 #include "state.h"
 
@@ -33,6 +36,16 @@ struct FlowManager *flow_manager_allocate(uint16_t starting_port,
 
   manager->expiration_time = expiration_time;
 
+#ifdef VIGOR_EXPIRATION_BUDGET
+  // Flows are expired by the runtime instead of flow_manager_expire
+  if (!expirator_register(manager->state->heap, manager->state->fv,
+                          manager->state->fm,
+                          (vigor_time_t)manager->expiration_time *
+                              1000)) {  // us to ns
+    return NULL;
+  }
+#endif  // VIGOR_EXPIRATION_BUDGET
+
   return manager;
 }
 
@@ -49,7 +62,7 @@ bool flow_manager_allocate_flow(struct FlowManager *manager, struct FlowId *id,
   struct FlowId *key = 0;
   vector_borrow(manager->state->fv, index, (void **)&key);
   memcpy((void *)key, (void *)id, sizeof(struct FlowId));
-  map_put(manager->state->fm, key, index);
+  FlowId_map_put(manager->state->fm, key, index);
   vector_return(manager->state->fv, index, key);
   return true;
 }
@@ -67,7 +80,7 @@ void flow_manager_expire(struct FlowManager *manager, vigor_time_t time) {
 bool flow_manager_get_internal(struct FlowManager *manager, struct FlowId *id,
                                vigor_time_t time, uint16_t *external_port) {
   int index;
-  if (map_get(manager->state->fm, id, &index) == 0) {
+  if (FlowId_map_get(manager->state->fm, id, &index) == 0) {
     return false;
   }
   *external_port = index + manager->state->start_port;
@@ -92,3 +105,51 @@ bool flow_manager_get_external(struct FlowManager *manager,
 
   return true;
 }
+
+#ifdef VIGOR_PREFETCH_DISTANCE
+unsigned flow_manager_prefetch_internal(struct FlowManager *manager,
+                                        struct FlowId *id) {
+  return map_prefetch(manager->state->fm, id);
+}
+
+void flow_manager_prefetch_external(struct FlowManager *manager,
+                                    uint16_t external_port) {
+  int index = external_port - manager->state->start_port;
+  if (0 <= index && index < manager->state->max_flows) {
+    vector_prefetch(manager->state->fv, index);
+  }
+}
+
+bool flow_manager_get_internal_with_hash(struct FlowManager *manager,
+                                         struct FlowId *id, unsigned hash,
+                                         vigor_time_t time,
+                                         uint16_t *external_port) {
+  int index;
+  if (FlowId_map_get_with_hash(manager->state->fm, id, hash, &index) == 0) {
+    return false;
+  }
+  *external_port = index + manager->state->start_port;
+  dchain_rejuvenate_index(manager->state->heap, index, time);
+  return true;
+}
+
+bool flow_manager_allocate_flow_with_hash(struct FlowManager *manager,
+                                          struct FlowId *id, unsigned hash,
+                                          uint16_t internal_device,
+                                          vigor_time_t time,
+                                          uint16_t *external_port) {
+  int index;
+  if (dchain_allocate_new_index(manager->state->heap, &index, time) == 0) {
+    return false;
+  }
+
+  *external_port = manager->state->start_port + index;
+
+  struct FlowId *key = 0;
+  vector_borrow(manager->state->fv, index, (void **)&key);
+  memcpy((void *)key, (void *)id, sizeof(struct FlowId));
+  FlowId_map_put_with_hash(manager->state->fm, key, hash, index);
+  vector_return(manager->state->fv, index, key);
+  return true;
+}
+#endif  // VIGOR_PREFETCH_DISTANCE
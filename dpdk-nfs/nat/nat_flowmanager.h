@@ -26,4 +26,26 @@ bool flow_manager_get_internal(struct FlowManager *manager, struct FlowId *id,
 bool flow_manager_get_external(struct FlowManager *manager,
                                uint16_t external_port, vigor_time_t time,
                                struct FlowId *out_flow);
+
+#ifdef VIGOR_PREFETCH_DISTANCE
+// Prefetch what later calls to flow_manager_get_internal and
+// flow_manager_get_external, respectively, will need; the first one returns
+// the hash of the flow
+unsigned flow_manager_prefetch_internal(struct FlowManager *manager,
+                                        struct FlowId *id);
+void flow_manager_prefetch_external(struct FlowManager *manager,
+                                    uint16_t external_port);
+
+// flow_manager_get_internal and flow_manager_allocate_flow with the
+// FlowId_hash of the flow already known
+bool flow_manager_get_internal_with_hash(struct FlowManager *manager,
+                                         struct FlowId *id, unsigned hash,
+                                         vigor_time_t time,
+                                         uint16_t *external_port);
+bool flow_manager_allocate_flow_with_hash(struct FlowManager *manager,
+                                          struct FlowId *id, unsigned hash,
+                                          uint16_t internal_device,
+                                          vigor_time_t time,
+                                          uint16_t *external_port);
+#endif  // VIGOR_PREFETCH_DISTANCE
 #endif  //_FLOWMANAGER_H_INCLUDED_
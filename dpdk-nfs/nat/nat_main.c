@@ -19,12 +19,41 @@ bool nf_init(void) {
   return flow_manager != NULL;
 }
 
+#ifdef VIGOR_PREFETCH_DISTANCE
+bool nf_prefetch(uint16_t device, uint8_t *packet, uint16_t packet_length,
+                 struct rte_mbuf *mbuf, unsigned *hash) {
+  struct rte_ipv4_hdr *rte_ipv4_header;
+  struct tcpudp_hdr *tcpudp_header;
+  if (!nf_peek_rte_ipv4_tcpudp_headers(packet, packet_length, &rte_ipv4_header,
+                                       &tcpudp_header)) {
+    return false;
+  }
+
+  if (device == config.wan_device) {
+    // External flows are looked up by port, there is no hash
+    flow_manager_prefetch_external(flow_manager, tcpudp_header->dst_port);
+    return false;
+  } else {
+    struct FlowId id = {.src_port = tcpudp_header->src_port,
+                        .dst_port = tcpudp_header->dst_port,
+                        .src_ip = rte_ipv4_header->src_addr,
+                        .dst_ip = rte_ipv4_header->dst_addr,
+                        .protocol = rte_ipv4_header->next_proto_id,
+                        .internal_device = device};
+    *hash = flow_manager_prefetch_internal(flow_manager, &id);
+    return true;
+  }
+}
+#endif  // VIGOR_PREFETCH_DISTANCE
+
 int nf_process(uint16_t device, uint8_t **buffer, uint16_t packet_length,
                vigor_time_t now, struct rte_mbuf *mbuf) {
   NF_DEBUG("It is %" PRId64, now);
 
+#ifndef VIGOR_EXPIRATION_BUDGET
   flow_manager_expire(flow_manager, now);
   NF_DEBUG("Flows have been expired");
+#endif  // VIGOR_EXPIRATION_BUDGET
 
   struct rte_ether_hdr *rte_ether_header = nf_then_get_rte_ether_header(buffer);
   struct rte_ipv4_hdr *rte_ipv4_header =
@@ -81,11 +110,25 @@ int nf_process(uint16_t device, uint8_t **buffer, uint16_t packet_length,
              config.wan_device);
 
     uint16_t external_port;
+#ifdef VIGOR_PREFETCH_DISTANCE
+    // nf_prefetch already hashed the flow
+    unsigned hash;
+    if (!nf_prefetched_hash(&hash)) {
+      hash = FlowId_hash(&id);
+    }
+    if (!flow_manager_get_internal_with_hash(flow_manager, &id, hash, now,
+                                             &external_port)) {
+      NF_DEBUG("New flow");
+
+      if (!flow_manager_allocate_flow_with_hash(flow_manager, &id, hash, device,
+                                                now, &external_port)) {
+#else   // VIGOR_PREFETCH_DISTANCE
     if (!flow_manager_get_internal(flow_manager, &id, now, &external_port)) {
       NF_DEBUG("New flow");
 
       if (!flow_manager_allocate_flow(flow_manager, &id, device, now,
                                       &external_port)) {
+#endif  // VIGOR_PREFETCH_DISTANCE
         NF_DEBUG("No space for the flow, dropping");
         return device;
       }
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 
 #include "lib/verified/boilerplate-util.h"
+#include "lib/verified/vigor-alloc.h"
 
 #ifdef KLEE_VERIFICATION
 #include "lib/models/verified/double-chain-control.h"
@@ -23,7 +24,7 @@ bool flow_consistency(void* value, int index, void* state) {
 struct State* alloc_state(int max_flows, int start_port, uint32_t ext_ip,
                           uint32_t nat_device) {
   if (allocated_nf_state != NULL) return allocated_nf_state;
-  struct State* ret = malloc(sizeof(struct State));
+  struct State* ret = vigor_malloc(sizeof(struct State));
   if (ret == NULL) return NULL;
   ret->fm = NULL;
   if (map_allocate(FlowId_eq, FlowId_hash, max_flows, &(ret->fm)) == 0)
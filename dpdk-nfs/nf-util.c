@@ -9,6 +9,7 @@
 #include <rte_tcp.h>
 #include <rte_udp.h>
 
+#include "lib/verified/boilerplate-util.h"
 #include "nf-log.h"
 #include "nf-util.h"
 
@@ -16,8 +17,25 @@
 #include <klee/klee.h>
 #endif
 
-void *chunks_borrowed[MAX_N_CHUNKS];
-size_t chunks_borrowed_num = 0;
+VIGOR_PER_LCORE void *chunks_borrowed[MAX_N_CHUNKS];
+VIGOR_PER_LCORE size_t chunks_borrowed_num = 0;
+
+#ifdef VIGOR_CHECKSUM_INCREMENTAL
+VIGOR_PER_LCORE struct nf_checksum_snapshot nf_checksum_snapshot;
+#endif  // VIGOR_CHECKSUM_INCREMENTAL
+
+#ifdef VIGOR_CHECKSUM_OFFLOAD
+bool nf_checksum_offload = false;
+#endif  // VIGOR_CHECKSUM_OFFLOAD
+
+#ifdef VIGOR_RSS_HASH
+bool nf_rss_hash_offload = false;
+#endif  // VIGOR_RSS_HASH
+
+#ifdef VIGOR_PREFETCH_DISTANCE
+VIGOR_PER_LCORE bool nf_prefetch_hash_valid = false;
+VIGOR_PER_LCORE unsigned nf_prefetch_hash;
+#endif  // VIGOR_PREFETCH_DISTANCE
 
 void nf_log_pkt(struct rte_ether_hdr *rte_ether_header,
                 struct rte_ipv4_hdr *rte_ipv4_header,
@@ -95,8 +113,133 @@ void nf_set_rte_ipv4_udptcp_checksum(struct rte_ipv4_hdr *ip_header,
   ip_header->hdr_checksum = klee_int("checksum");
 }
 #else   // KLEE_VERIFICATION
+#ifdef VIGOR_CHECKSUM_OFFLOAD
+// Leaves the checksums to the NIC, which only needs the L4 pseudo-header one
+static void set_checksum_offload(struct rte_ipv4_hdr *ip_header,
+                                 void *l4_header) {
+  struct rte_mbuf *mbuf = packet_get_mbuf();
+  mbuf->l2_len = (uint8_t *)ip_header - rte_pktmbuf_mtod(mbuf, uint8_t *);
+  mbuf->l3_len = (ip_header->version_ihl & RTE_IPV4_HDR_IHL_MASK) *
+                 RTE_IPV4_IHL_MULTIPLIER;
+  mbuf->ol_flags |= PKT_TX_IPV4 | PKT_TX_IP_CKSUM;
+  ip_header->hdr_checksum = 0;
+  if (ip_header->next_proto_id == IPPROTO_TCP) {
+    struct rte_tcp_hdr *tcp_header = (struct rte_tcp_hdr *)l4_header;
+    mbuf->ol_flags |= PKT_TX_TCP_CKSUM;
+    tcp_header->cksum = rte_ipv4_phdr_cksum(ip_header, mbuf->ol_flags);
+  } else if (ip_header->next_proto_id == IPPROTO_UDP) {
+    struct rte_udp_hdr *udp_header = (struct rte_udp_hdr *)l4_header;
+    mbuf->ol_flags |= PKT_TX_UDP_CKSUM;
+    udp_header->dgram_cksum = rte_ipv4_phdr_cksum(ip_header, mbuf->ol_flags);
+  }
+}
+#endif  // VIGOR_CHECKSUM_OFFLOAD
+
+#ifdef VIGOR_CHECKSUM_INCREMENTAL
+// Adds the difference between the old and new 16-bit words to the one's
+// complement sum of a checksum, as in RFC 1624, HC' = ~(~HC + ~m + m');
+// unchanged words add ~m + m = -0
+static inline uint32_t checksum_diff(uint32_t sum, const void *old_words,
+                                     const void *new_words, size_t length) {
+  const uint16_t *old_word = (const uint16_t *)old_words;
+  const uint16_t *new_word = (const uint16_t *)new_words;
+  for (size_t i = 0; i < length / 2; i++) {
+    sum += (uint16_t)~old_word[i] + new_word[i];
+  }
+  return sum;
+}
+
+static inline uint16_t checksum_fold(uint32_t sum) {
+  sum = (sum & 0xffff) + (sum >> 16);
+  sum = (sum & 0xffff) + (sum >> 16);
+  return (uint16_t)~sum;
+}
+
+// Updates the checksums of headers that were only rewritten since they were
+// borrowed, i.e. neither moved nor resized and without IP options; returns
+// false if the checksums have to be recomputed
+static bool update_checksums(struct rte_ipv4_hdr *ip_header, void *l4_header) {
+  const struct nf_checksum_snapshot *snapshot = &nf_checksum_snapshot;
+  const struct rte_ipv4_hdr *old_ip = &snapshot->ipv4;
+  bool is_tcp = ip_header->next_proto_id == IPPROTO_TCP;
+  bool is_udp = ip_header->next_proto_id == IPPROTO_UDP;
+  if ((snapshot->ipv4_header != ip_header) |
+      (ip_header->version_ihl != RTE_IPV4_VHL_DEF) |
+      (ip_header->version_ihl != old_ip->version_ihl) |
+      (ip_header->total_length != old_ip->total_length) |
+      (ip_header->next_proto_id != old_ip->next_proto_id) |
+      ((is_tcp | is_udp) & (snapshot->l4_header != l4_header))) {
+    return false;
+  }
+
+  // The L4 checksum covers the addresses in its pseudo-header
+  uint32_t address_sum =
+      checksum_diff(0, &old_ip->src_addr, &ip_header->src_addr,
+                    sizeof(old_ip->src_addr) + sizeof(old_ip->dst_addr));
+  if (is_tcp) {
+    struct rte_tcp_hdr *tcp_header = (struct rte_tcp_hdr *)l4_header;
+    uint32_t sum = checksum_diff(address_sum + (uint16_t)~tcp_header->cksum,
+                                 snapshot->l4, l4_header, snapshot->l4_length);
+    uint16_t cksum = checksum_fold(sum);
+    tcp_header->cksum = cksum == 0 ? 0xffff : cksum;
+  } else if (is_udp) {
+    struct rte_udp_hdr *udp_header = (struct rte_udp_hdr *)l4_header;
+    // A zero UDP checksum means none
+    if (udp_header->dgram_cksum != 0) {
+      uint32_t sum =
+          checksum_diff(address_sum + (uint16_t)~udp_header->dgram_cksum,
+                        snapshot->l4, l4_header, snapshot->l4_length);
+      uint16_t cksum = checksum_fold(sum);
+      udp_header->dgram_cksum = cksum == 0 ? 0xffff : cksum;
+    }
+  }
+
+  uint32_t sum = checksum_diff((uint16_t)~ip_header->hdr_checksum, old_ip,
+                               ip_header, sizeof(struct rte_ipv4_hdr));
+  ip_header->hdr_checksum = checksum_fold(sum);
+  return true;
+}
+#endif  // VIGOR_CHECKSUM_INCREMENTAL
+
+// rte_ipv4_udptcp_cksum for a datagram that may continue in further segments
+// with MTU; its L4 header must be in the first one, as all edited chunks are
+static uint16_t ipv4_udptcp_cksum_mbuf(struct rte_ipv4_hdr *ip_header,
+                                       void *l4_header) {
+  struct rte_mbuf *mbuf = packet_get_mbuf();
+  if (rte_pktmbuf_is_contiguous(mbuf)) {
+    return rte_ipv4_udptcp_cksum(ip_header, l4_header);
+  }
+
+  uint32_t l4_offset = (uint8_t *)l4_header - rte_pktmbuf_mtod(mbuf, uint8_t *);
+  assert(l4_offset < rte_pktmbuf_data_len(mbuf));
+  uint32_t l4_length = rte_be_to_cpu_16(ip_header->total_length) -
+                       (ip_header->version_ihl & RTE_IPV4_HDR_IHL_MASK) *
+                           RTE_IPV4_IHL_MULTIPLIER;
+  // Garbage in, garbage out, but never past the end of the packet
+  l4_length = RTE_MIN(l4_length, rte_pktmbuf_pkt_len(mbuf) - l4_offset);
+
+  uint16_t raw_sum;
+  rte_raw_cksum_mbuf(mbuf, l4_offset, l4_length, &raw_sum);
+  uint32_t sum = (uint32_t)raw_sum + rte_ipv4_phdr_cksum(ip_header, 0);
+  sum = (sum & 0xffff) + (sum >> 16);
+  uint16_t cksum = (uint16_t)~sum;
+  return cksum == 0 ? 0xffff : cksum;
+}
+
 void nf_set_rte_ipv4_udptcp_checksum(struct rte_ipv4_hdr *ip_header,
                                      void *l4_header, void *packet) {
+#ifdef VIGOR_CHECKSUM_OFFLOAD
+  if (nf_checksum_offload) {
+    set_checksum_offload(ip_header, l4_header);
+    return;
+  }
+#endif  // VIGOR_CHECKSUM_OFFLOAD
+#ifdef VIGOR_CHECKSUM_INCREMENTAL
+  if (update_checksums(ip_header, l4_header)) {
+    return;
+  }
+#endif  // VIGOR_CHECKSUM_INCREMENTAL
+
   // Make sure the packet pointer points to the TCPUDP continuation
   // This check is exercised during verification, no need to repeat it.
   // void* payload = nf_borrow_next_chunk(packet,
@@ -107,11 +250,11 @@ void nf_set_rte_ipv4_udptcp_checksum(struct rte_ipv4_hdr *ip_header,
   if (ip_header->next_proto_id == IPPROTO_TCP) {
     struct rte_tcp_hdr *tcp_header = (struct rte_tcp_hdr *)l4_header;
     tcp_header->cksum = 0;  // Assumed by cksum calculation
-    tcp_header->cksum = rte_ipv4_udptcp_cksum(ip_header, tcp_header);
+    tcp_header->cksum = ipv4_udptcp_cksum_mbuf(ip_header, tcp_header);
   } else if (ip_header->next_proto_id == IPPROTO_UDP) {
     struct rte_udp_hdr *udp_header = (struct rte_udp_hdr *)l4_header;
     udp_header->dgram_cksum = 0;  // Assumed by cksum calculation
-    udp_header->dgram_cksum = rte_ipv4_udptcp_cksum(ip_header, udp_header);
+    udp_header->dgram_cksum = ipv4_udptcp_cksum_mbuf(ip_header, udp_header);
   }
   ip_header->hdr_checksum = rte_ipv4_cksum(ip_header);
 }
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <rte_byteorder.h>
 #include <rte_common.h>
@@ -13,6 +14,7 @@
 #include <rte_tcp.h>
 #include <rte_udp.h>
 
+#include "lib/verified/boilerplate-util.h"
 #include "lib/verified/packet-io.h"
 #include "lib/verified/tcpudp_hdr.h"
 
@@ -103,9 +105,84 @@ char *nf_mac_to_str(struct rte_ether_addr *addr);
 
 char *nf_rte_ipv4_to_str(uint32_t addr);
 
+#ifdef VIGOR_CHECKSUM_INCREMENTAL
+// The IPv4 and L4 headers as borrowed, from which
+// nf_set_rte_ipv4_udptcp_checksum updates the checksums of the rewritten ones
+// instead of recomputing them over the whole packet
+struct nf_checksum_snapshot {
+  const struct rte_ipv4_hdr *ipv4_header;
+  const void *l4_header;
+  size_t l4_length;
+  struct rte_ipv4_hdr ipv4;
+  uint8_t l4[sizeof(struct rte_tcp_hdr)];
+};
+
+extern VIGOR_PER_LCORE struct nf_checksum_snapshot nf_checksum_snapshot;
+
+static inline void nf_checksum_snapshot_ipv4(const struct rte_ipv4_hdr *hdr) {
+  nf_checksum_snapshot.ipv4_header = hdr;
+  nf_checksum_snapshot.l4_header = NULL;
+  memcpy(&nf_checksum_snapshot.ipv4, hdr, sizeof(struct rte_ipv4_hdr));
+}
+
+static inline void nf_checksum_snapshot_l4(const void *hdr, size_t length) {
+  nf_checksum_snapshot.l4_header = hdr;
+  nf_checksum_snapshot.l4_length = length;
+  memcpy(nf_checksum_snapshot.l4, hdr, length);
+}
+
+// Headers moved or resized by chunk edits, and those of the next packet,
+// get their checksums recomputed unless borrowed again
+static inline void nf_checksum_snapshot_clear(void) {
+  nf_checksum_snapshot.ipv4_header = NULL;
+}
+
+#define CHECKSUM_SNAPSHOT_IPV4(hdr) nf_checksum_snapshot_ipv4(hdr)
+#define CHECKSUM_SNAPSHOT_L4(hdr, length) nf_checksum_snapshot_l4(hdr, length)
+#define CHECKSUM_SNAPSHOT_CLEAR() nf_checksum_snapshot_clear()
+#else  // VIGOR_CHECKSUM_INCREMENTAL
+#define CHECKSUM_SNAPSHOT_IPV4(hdr)       /*nothing*/
+#define CHECKSUM_SNAPSHOT_L4(hdr, length) /*nothing*/
+#define CHECKSUM_SNAPSHOT_CLEAR()         /*nothing*/
+#endif  // VIGOR_CHECKSUM_INCREMENTAL
+
+#ifdef VIGOR_CHECKSUM_OFFLOAD
+// Whether all NF ports compute IPv4, TCP and UDP checksums on TX,
+// set when initializing them
+extern bool nf_checksum_offload;
+#endif  // VIGOR_CHECKSUM_OFFLOAD
+
+#ifdef VIGOR_RSS_HASH
+#include "lib/unverified/rss-hash.h"
+
+// Whether all NF ports deliver the RSS hash of non-fragmented IPv4 TCP and
+// UDP packets, set when initializing them
+extern bool nf_rss_hash_offload;
+
+// The flow hash of the packet, i.e. rss_hash_ipv4_tcpudp of its addresses and
+// ports: the mbuf's RSS hash when the NIC computed it over those, otherwise
+// computed in software. Fragments are hashed by the NIC over the addresses
+// only, so they are always hashed in software.
+static inline unsigned nf_rss_hash(struct rte_mbuf *mbuf,
+                                   struct rte_ipv4_hdr *header,
+                                   struct tcpudp_hdr *tcpudp_header) {
+  uint16_t fragment = rte_cpu_to_be_16(RTE_IPV4_HDR_MF_FLAG |
+                                       RTE_IPV4_HDR_OFFSET_MASK);
+  if (nf_rss_hash_offload && (mbuf->ol_flags & PKT_RX_RSS_HASH) != 0 &&
+      (header->fragment_offset & fragment) == 0) {
+    return mbuf->hash.rss;
+  }
+  return rss_hash_ipv4_tcpudp(header->src_addr, header->dst_addr,
+                              tcpudp_header->src_port,
+                              tcpudp_header->dst_port);
+}
+#endif  // VIGOR_RSS_HASH
+
+// Chunks of the packet being processed, one set per lcore like the packet
+// state in packet-io.c
 #define MAX_N_CHUNKS 100
-extern void *chunks_borrowed[];
-extern size_t chunks_borrowed_num;
+extern VIGOR_PER_LCORE void *chunks_borrowed[];
+extern VIGOR_PER_LCORE size_t chunks_borrowed_num;
 
 static inline void *nf_borrow_next_chunk(uint8_t **p, size_t length) {
   assert(chunks_borrowed_num < MAX_N_CHUNKS);
@@ -137,6 +214,7 @@ static inline void *nf_shrink_chunk(uint8_t **p, size_t length,
                                     struct rte_mbuf *mbuf) {
   assert(chunks_borrowed_num < MAX_N_CHUNKS);
   assert(chunks_borrowed_num);
+  CHECKSUM_SNAPSHOT_CLEAR();
   packet_shrink_chunk((void **)p, length, chunks_borrowed, chunks_borrowed_num,
                       mbuf);
   return chunks_borrowed[chunks_borrowed_num - 1];
@@ -150,18 +228,33 @@ static inline void *nf_insert_new_chunk(uint8_t **p, size_t length,
   // Do not really trace the ip options chunk, as it's length
   // is unknown statically
   CHUNK_LAYOUT_IMPL(*p, 1, NULL, 0, NULL, 0, "new_hdr");
+  CHECKSUM_SNAPSHOT_CLEAR();
   packet_insert_new_chunk((void **)p, length, chunks_borrowed,
                           &chunks_borrowed_num, mbuf);
 
   return chunks_borrowed[chunks_borrowed_num - 1];
 }
 
+#ifndef KLEE_VERIFICATION
+// Unverified: see packet_edit_chunks
+static inline void nf_edit_chunks(uint8_t **p,
+                                  const struct packet_chunk_edit *edits,
+                                  size_t num_edits, struct rte_mbuf *mbuf) {
+  assert(chunks_borrowed_num < MAX_N_CHUNKS);
+  assert(chunks_borrowed_num);
+  CHECKSUM_SNAPSHOT_CLEAR();
+  packet_edit_chunks((void **)p, chunks_borrowed, &chunks_borrowed_num, edits,
+                     num_edits, mbuf);
+}
+#endif  // KLEE_VERIFICATION
+
 static inline void *nf_get_borrowed_chunk(uint32_t chunk_i) {
   assert(chunk_i < chunks_borrowed_num);
   return chunks_borrowed[chunk_i];
 }
 
 static inline void nf_return_all_chunks(void *p) {
+  CHECKSUM_SNAPSHOT_CLEAR();
   while (chunks_borrowed_num != 0) {
     packet_return_chunk(p, chunks_borrowed[chunks_borrowed_num - 1]);
     chunks_borrowed_num--;
@@ -195,6 +288,7 @@ static inline struct rte_ipv4_hdr *nf_then_get_rte_ipv4_header(
   CHUNK_LAYOUT(p, rte_ipv4_hdr, rte_ipv4_fields);
   struct rte_ipv4_hdr *hdr = (struct rte_ipv4_hdr *)nf_borrow_next_chunk(
       p, sizeof(struct rte_ipv4_hdr));
+  CHECKSUM_SNAPSHOT_IPV4(hdr);
 
   return hdr;
 }
@@ -214,6 +308,7 @@ static inline struct rte_ipv4_hdr *nf_then_get_rte_ipv4_header_with_options(
   CHUNK_LAYOUT(p, rte_ipv4_hdr, rte_ipv4_fields);
   struct rte_ipv4_hdr *hdr = (struct rte_ipv4_hdr *)nf_borrow_next_chunk(
       p, sizeof(struct rte_ipv4_hdr));
+  CHECKSUM_SNAPSHOT_IPV4(hdr);
 
   uint8_t ihl = hdr->version_ihl & 0x0f;
   if ((ihl < IP_MIN_SIZE_WORDS) |
@@ -238,8 +333,10 @@ static inline struct tcpudp_hdr *nf_then_get_tcpudp_header(
     return NULL;
   }
   CHUNK_LAYOUT(*p, tcpudp_hdr, tcpudp_fields);
-  return (struct tcpudp_hdr *)nf_borrow_next_chunk(p,
-                                                   sizeof(struct tcpudp_hdr));
+  struct tcpudp_hdr *hdr = (struct tcpudp_hdr *)nf_borrow_next_chunk(
+      p, sizeof(struct tcpudp_hdr));
+  CHECKSUM_SNAPSHOT_L4(hdr, sizeof(struct tcpudp_hdr));
+  return hdr;
 }
 
 static inline struct rte_tcp_hdr *nf_then_get_tcp_header(
@@ -249,8 +346,10 @@ static inline struct rte_tcp_hdr *nf_then_get_tcp_header(
     return NULL;
   }
   CHUNK_LAYOUT(*p, rte_tcp_hdr, tcp_fields);
-  return (struct rte_tcp_hdr *)nf_borrow_next_chunk(p,
-                                                    sizeof(struct rte_tcp_hdr));
+  struct rte_tcp_hdr *hdr = (struct rte_tcp_hdr *)nf_borrow_next_chunk(
+      p, sizeof(struct rte_tcp_hdr));
+  CHECKSUM_SNAPSHOT_L4(hdr, sizeof(struct rte_tcp_hdr));
+  return hdr;
 }
 
 static inline struct rte_udp_hdr *nf_then_get_udp_header(
@@ -260,6 +359,51 @@ static inline struct rte_udp_hdr *nf_then_get_udp_header(
     return NULL;
   }
   CHUNK_LAYOUT(*p, rte_udp_hdr, udp_fields);
-  return (struct rte_udp_hdr *)nf_borrow_next_chunk(p,
-                                                    sizeof(struct rte_udp_hdr));
+  struct rte_udp_hdr *hdr = (struct rte_udp_hdr *)nf_borrow_next_chunk(
+      p, sizeof(struct rte_udp_hdr));
+  CHECKSUM_SNAPSHOT_L4(hdr, sizeof(struct rte_udp_hdr));
+  return hdr;
 }
+
+#ifndef KLEE_VERIFICATION
+// For the unverified prefetch stage, which runs before the packet is borrowed
+// chunk by chunk: finds the headers that nf_then_get_rte_ether_header,
+// nf_then_get_rte_ipv4_header and nf_then_get_tcpudp_header would return,
+// without borrowing them. Returns false if the packet does not have them.
+static inline bool nf_peek_rte_ipv4_tcpudp_headers(
+    uint8_t *packet, uint16_t packet_length,
+    struct rte_ipv4_hdr **rte_ipv4_header_out,
+    struct tcpudp_hdr **tcpudp_header_out) {
+  if (packet_length < sizeof(struct rte_ether_hdr) +
+                          sizeof(struct rte_ipv4_hdr) +
+                          sizeof(struct tcpudp_hdr)) {
+    return false;
+  }
+
+  struct rte_ether_hdr *rte_ether_header = (struct rte_ether_hdr *)packet;
+  struct rte_ipv4_hdr *rte_ipv4_header =
+      (struct rte_ipv4_hdr *)(rte_ether_header + 1);
+  if ((!nf_has_rte_ipv4_header(rte_ether_header)) |
+      (!nf_has_tcpudp_header(rte_ipv4_header))) {
+    return false;
+  }
+
+  *rte_ipv4_header_out = rte_ipv4_header;
+  *tcpudp_header_out = (struct tcpudp_hdr *)(rte_ipv4_header + 1);
+  return true;
+}
+
+#ifdef VIGOR_PREFETCH_DISTANCE
+// Set by the runtime before nf_process to what nf_prefetch returned for the
+// same packet
+extern VIGOR_PER_LCORE bool nf_prefetch_hash_valid;
+extern VIGOR_PER_LCORE unsigned nf_prefetch_hash;
+
+// In nf_process: whether nf_prefetch left the hash of the key it prefetched
+// for this packet in *hash
+static inline bool nf_prefetched_hash(unsigned *hash) {
+  *hash = nf_prefetch_hash;
+  return nf_prefetch_hash_valid;
+}
+#endif  // VIGOR_PREFETCH_DISTANCE
+#endif  // KLEE_VERIFICATION
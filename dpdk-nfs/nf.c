@@ -1,4 +1,6 @@
+#include <errno.h>
 #include <inttypes.h>
+#include <string.h>
 // DPDK uses these but doesn't include them. :|
 #include <linux/limits.h>
 #include <sys/types.h>
@@ -12,10 +14,29 @@
 
 #include "lib/verified/boilerplate-util.h"
 #include "lib/verified/packet-io.h"
+#include "lib/verified/vigor-alloc.h"
 #include "nf-log.h"
 #include "nf-util.h"
 #include "nf.h"
 
+#ifdef VIGOR_EXPIRATION_BUDGET
+#include "lib/unverified/expirator.h"
+#endif  // VIGOR_EXPIRATION_BUDGET
+
+#ifdef VIGOR_TELEMETRY
+#include "lib/unverified/telemetry.h"
+#endif  // VIGOR_TELEMETRY
+
+#ifdef VIGOR_PROFILE
+#include <rte_cycles.h>
+
+#include "lib/unverified/profile.h"
+#endif  // VIGOR_PROFILE
+
+#ifndef KLEE_VERIFICATION
+#include "lib/unverified/rss-hash.h"
+#endif  // KLEE_VERIFICATION
+
 #ifdef KLEE_VERIFICATION
 #include "lib/models/hardware.h"
 #include "lib/models/verified/vigor-time-control.h"
@@ -76,51 +97,326 @@ static const uint16_t TX_QUEUE_SIZE = 1024;
 // Buffer count for mempools
 static const unsigned MEMPOOL_BUFFER_COUNT = 2048;
 
+// Per-lcore mempool cache size, only used when running on multiple lcores
+static const unsigned MEMPOOL_CACHE_SIZE = 256;
+
+#ifndef KLEE_VERIFICATION
+// Unverified multi-core support: every lcore gets its own RX/TX queue pair on
+// every device and runs its own NF instance; RSS spreads flows across the RX
+// queues.
+struct lcore_conf {
+  uint16_t queue_id;
+} __rte_cache_aligned;
+
+static struct lcore_conf lcores_conf[RTE_MAX_LCORE];
+
+// The key is the symmetric rss_hash_key, of which drivers that do not say
+// otherwise use the first 40 bytes
+#define RSS_HASH_KEY_DEFAULT_LENGTH 40
+
+static const uint64_t RSS_HASH_FUNCTIONS =
+    ETH_RSS_IP | ETH_RSS_TCP | ETH_RSS_UDP;
+#endif  // KLEE_VERIFICATION
+
+unsigned nf_lcores_count(void) {
+#ifdef KLEE_VERIFICATION
+  return 1;  // no multicore support for verification
+#else   // KLEE_VERIFICATION
+  return rte_lcore_count();
+#endif  // KLEE_VERIFICATION
+}
+
+unsigned nf_lcore_index(void) {
+#ifdef KLEE_VERIFICATION
+  return 0;
+#else   // KLEE_VERIFICATION
+  return lcores_conf[rte_lcore_id()].queue_id;
+#endif  // KLEE_VERIFICATION
+}
+
 // Send the given packet to all devices except the packet's own
-void flood(struct rte_mbuf *packet, uint16_t nb_devices) {
+void flood(struct rte_mbuf *packet, uint16_t nb_devices, uint16_t queue_id) {
+  if (nb_devices < 2) {
+#ifdef VIGOR_TELEMETRY
+    telemetry_nf_drop(packet->port);
+#endif  // VIGOR_TELEMETRY
+    rte_pktmbuf_free(packet);
+    return;
+  }
+
+  // one reference per output device, released by the driver once sent
   rte_mbuf_refcnt_set(packet, nb_devices - 1);
-  int total_sent = 0;
   uint16_t skip_device = packet->port;
   for (uint16_t device = 0; device < nb_devices; device++) {
     if (device != skip_device) {
-      total_sent += rte_eth_tx_burst(device, 0, &packet, 1);
+      // should not happen, but if the device refuses the packet, release its
+      // reference ourselves; the other devices may still hold theirs
+      uint16_t sent = rte_eth_tx_burst(device, queue_id, &packet, 1);
+#ifdef VIGOR_TELEMETRY
+      telemetry_tx(device, sent, 1 - sent);
+#endif  // VIGOR_TELEMETRY
+      if (sent != 1) {
+        rte_pktmbuf_free(packet);
+      }
     }
   }
-  // should not happen, but in case we couldn't transmit, ensure the packet is
-  // freed
-  if (total_sent != nb_devices - 1) {
-    rte_mbuf_refcnt_set(packet, 1);
+}
+
+#if VIGOR_BATCH_SIZE != 1
+// Packets waiting to be sent to one device, sent as a single burst
+struct tx_buffer {
+  uint16_t count;
+  struct rte_mbuf *mbufs[VIGOR_BATCH_SIZE];
+};
+
+// Sends all buffered packets, freeing the ones the device does not accept
+static void tx_buffer_flush(struct tx_buffer *buffer, uint16_t device,
+                            uint16_t queue_id) {
+  if (buffer->count == 0) {
+    return;
+  }
+
+  uint16_t sent_count =
+      rte_eth_tx_burst(device, queue_id, buffer->mbufs, buffer->count);
+  for (uint16_t n = sent_count; n < buffer->count; n++) {
+    rte_pktmbuf_free(buffer->mbufs[n]);
+  }
+
+  if (sent_count != buffer->count) {
+    NF_DEBUG("Device %" PRIu16 " dropped %" PRIu16 " packets on TX.", device,
+             (uint16_t)(buffer->count - sent_count));
+  }
+
+#ifdef VIGOR_TELEMETRY
+  telemetry_tx(device, sent_count, buffer->count - sent_count);
+#endif  // VIGOR_TELEMETRY
+  buffer->count = 0;
+}
+
+// Buffers the packet for the given device, sending the buffer once it is full
+static void tx_buffer_add(struct tx_buffer *buffers, uint16_t device,
+                          uint16_t queue_id, struct rte_mbuf *packet) {
+  struct tx_buffer *buffer = &buffers[device];
+  buffer->mbufs[buffer->count] = packet;
+  buffer->count++;
+  if (buffer->count == VIGOR_BATCH_SIZE) {
+    tx_buffer_flush(buffer, device, queue_id);
+  }
+}
+
+// Pool of indirect mbufs used to flood packets; they only point to the data
+// of the original packet, so they need no data room of their own
+static struct rte_mempool *clone_pool;
+
+// Batched version of flood: buffers a clone of the packet for every device
+// except the packet's own and the last one, which gets the packet itself.
+// The data is never copied, and each device still gets a single burst.
+static void flood_batch(struct tx_buffer *buffers, uint16_t nb_devices,
+                        uint16_t queue_id, struct rte_mbuf *packet) {
+  if (nb_devices < 2) {
+#ifdef VIGOR_TELEMETRY
+    telemetry_nf_drop(packet->port);
+#endif  // VIGOR_TELEMETRY
     rte_pktmbuf_free(packet);
+    return;
+  }
+
+  uint16_t skip_device = packet->port;
+  uint16_t last_device =
+      skip_device == nb_devices - 1 ? nb_devices - 2 : nb_devices - 1;
+  // Clones hold a reference to the packet, so they must all be created before
+  // the packet itself is buffered, which may send and free it
+  for (uint16_t device = 0; device < nb_devices; device++) {
+    if (device == skip_device || device == last_device) {
+      continue;
+    }
+
+    struct rte_mbuf *clone = rte_pktmbuf_clone(packet, clone_pool);
+    if (clone == NULL) {
+      NF_DEBUG("Out of clones, not flooding to device %" PRIu16 ".", device);
+#ifdef VIGOR_TELEMETRY
+      telemetry_tx(device, 0, 1);
+#endif  // VIGOR_TELEMETRY
+      continue;
+    }
+    tx_buffer_add(buffers, device, queue_id, clone);
+  }
+  tx_buffer_add(buffers, last_device, queue_id, packet);
+}
+#endif  // VIGOR_BATCH_SIZE != 1
+
+#ifndef KLEE_VERIFICATION
+// Assigns one queue index to each lcore, in lcore order
+static void nf_init_lcores(void) {
+#ifndef VIGOR_SHARDED_STATE
+  if (rte_lcore_count() > 1) {
+    rte_exit(EXIT_FAILURE,
+             "This NF does not shard its state per flow, it must run on a "
+             "single lcore\n");
+  }
+#endif  // VIGOR_SHARDED_STATE
+
+  unsigned lcore_id;
+  uint16_t queue_id = 0;
+  RTE_LCORE_FOREACH(lcore_id) {
+    lcores_conf[lcore_id].queue_id = queue_id;
+    queue_id++;
   }
 }
 
-// Initializes the given device using the given memory pool
+// Fills the device's RSS redirection table by spreading its buckets
+// round-robin over the given number of RX queues
+static int nf_set_reta(uint16_t device, uint16_t nb_queues) {
+  struct rte_eth_dev_info dev_info;
+  int retval = rte_eth_dev_info_get(device, &dev_info);
+  if (retval != 0) {
+    return retval;
+  }
+
+  // Some drivers do not expose their redirection table
+  if (dev_info.reta_size == 0) {
+    return 0;
+  }
+
+  // Tables smaller than a group, or not a multiple of it, use a partial group
+  struct rte_eth_rss_reta_entry64
+      reta_conf[(dev_info.reta_size + RTE_RETA_GROUP_SIZE - 1) /
+                RTE_RETA_GROUP_SIZE];
+  memset(reta_conf, 0, sizeof(reta_conf));
+
+  for (uint16_t bucket = 0; bucket < dev_info.reta_size; bucket++) {
+    uint16_t reta_id = bucket / RTE_RETA_GROUP_SIZE;
+    uint16_t reta_pos = bucket % RTE_RETA_GROUP_SIZE;
+    reta_conf[reta_id].mask |= 1ULL << reta_pos;
+    reta_conf[reta_id].reta[reta_pos] = bucket % nb_queues;
+  }
+
+  return rte_eth_dev_rss_reta_update(device, reta_conf, dev_info.reta_size);
+}
+
+// Enables RSS over the IP/TCP/UDP headers with the symmetric key
+static int nf_set_rss_conf(uint16_t device, struct rte_eth_conf *device_conf) {
+  struct rte_eth_dev_info dev_info;
+  int retval = rte_eth_dev_info_get(device, &dev_info);
+  if (retval != 0) {
+    return retval;
+  }
+
+  uint8_t key_len = dev_info.hash_key_size == 0 ? RSS_HASH_KEY_DEFAULT_LENGTH
+                                                : dev_info.hash_key_size;
+  if (key_len > RSS_HASH_KEY_LENGTH) {
+    return -EINVAL;
+  }
+
+  device_conf->rxmode.mq_mode = ETH_MQ_RX_RSS;
+  device_conf->rx_adv_conf.rss_conf.rss_key = rss_hash_key;
+  device_conf->rx_adv_conf.rss_conf.rss_key_len = key_len;
+  device_conf->rx_adv_conf.rss_conf.rss_hf =
+      RSS_HASH_FUNCTIONS & dev_info.flow_type_rss_offloads;
+  return 0;
+}
+
+#ifdef VIGOR_RSS_HASH
+// The flow tables are probed with the RSS hash of the packets, so RSS is
+// enabled even with a single queue; if the device cannot hash non-fragmented
+// IPv4 TCP and UDP packets with the symmetric key, they are hashed in software
+static void nf_set_rss_hash_offload(uint16_t device,
+                                    struct rte_eth_conf *device_conf,
+                                    uint16_t nb_queues) {
+  if (nb_queues == 1 && nf_set_rss_conf(device, device_conf) != 0) {
+    nf_rss_hash_offload = false;
+    return;
+  }
+
+  uint64_t flow_types = ETH_RSS_NONFRAG_IPV4_TCP | ETH_RSS_NONFRAG_IPV4_UDP;
+  if ((device_conf->rx_adv_conf.rss_conf.rss_hf & flow_types) != flow_types) {
+    nf_rss_hash_offload = false;
+  }
+}
+#endif  // VIGOR_RSS_HASH
+#endif  // KLEE_VERIFICATION
+
+// Initializes the given device using the given memory pool,
+// with one RX and one TX queue per lcore
 static int nf_init_device(uint16_t device, struct rte_mempool *mbuf_pool) {
   int retval;
+  uint16_t nb_queues = nf_lcores_count();
 
   // device_conf passed to rte_eth_dev_configure cannot be NULL
   struct rte_eth_conf device_conf = {0};
   // device_conf.rxmode.hw_strip_crc = 1;
 
-  // Configure the device (1, 1 == number of RX/TX queues)
-  retval = rte_eth_dev_configure(device, 1, 1, &device_conf);
+#ifdef VIGOR_MTU
+  // Jumbo frames are received as chains of default-sized mbufs
+  device_conf.rxmode.max_rx_pkt_len =
+      VIGOR_MTU + RTE_ETHER_HDR_LEN + RTE_ETHER_CRC_LEN;
+  device_conf.rxmode.offloads |= DEV_RX_OFFLOAD_SCATTER;
+  if (device_conf.rxmode.max_rx_pkt_len > RTE_ETHER_MAX_LEN) {
+    device_conf.rxmode.offloads |= DEV_RX_OFFLOAD_JUMBO_FRAME;
+  }
+  device_conf.txmode.offloads |= DEV_TX_OFFLOAD_MULTI_SEGS;
+#endif  // VIGOR_MTU
+
+#ifdef VIGOR_CHECKSUM_OFFLOAD
+  // Checksums are only offloaded if all devices can compute them
+  struct rte_eth_dev_info dev_info;
+  retval = rte_eth_dev_info_get(device, &dev_info);
   if (retval != 0) {
     return retval;
   }
+  uint64_t checksum_offloads = DEV_TX_OFFLOAD_IPV4_CKSUM |
+                               DEV_TX_OFFLOAD_TCP_CKSUM |
+                               DEV_TX_OFFLOAD_UDP_CKSUM;
+  if ((dev_info.tx_offload_capa & checksum_offloads) == checksum_offloads) {
+    device_conf.txmode.offloads |= checksum_offloads;
+  } else {
+    nf_checksum_offload = false;
+  }
+#endif  // VIGOR_CHECKSUM_OFFLOAD
+
+#ifndef KLEE_VERIFICATION
+  if (nb_queues > 1) {
+    retval = nf_set_rss_conf(device, &device_conf);
+    if (retval != 0) {
+      return retval;
+    }
+  }
+#ifdef VIGOR_RSS_HASH
+  nf_set_rss_hash_offload(device, &device_conf, nb_queues);
+#endif  // VIGOR_RSS_HASH
+#endif  // KLEE_VERIFICATION
 
-  // Allocate and set up a TX queue (NULL == default config)
-  retval = rte_eth_tx_queue_setup(device, 0, TX_QUEUE_SIZE,
-                                  rte_eth_dev_socket_id(device), NULL);
+  // Configure the device (number of RX/TX queues)
+  retval = rte_eth_dev_configure(device, nb_queues, nb_queues, &device_conf);
   if (retval != 0) {
     return retval;
   }
 
-  // Allocate and set up RX queues (NULL == default config)
-  retval = rte_eth_rx_queue_setup(
-      device, 0, RX_QUEUE_SIZE, rte_eth_dev_socket_id(device), NULL, mbuf_pool);
+#ifdef VIGOR_MTU
+  retval = rte_eth_dev_set_mtu(device, VIGOR_MTU);
   if (retval != 0) {
     return retval;
   }
+#endif  // VIGOR_MTU
+
+  // Allocate and set up TX queues (NULL == default config)
+  for (uint16_t queue = 0; queue < nb_queues; queue++) {
+    retval = rte_eth_tx_queue_setup(device, queue, TX_QUEUE_SIZE,
+                                    rte_eth_dev_socket_id(device), NULL);
+    if (retval != 0) {
+      return retval;
+    }
+  }
+
+  // Allocate and set up RX queues (NULL == default config)
+  for (uint16_t queue = 0; queue < nb_queues; queue++) {
+    retval = rte_eth_rx_queue_setup(device, queue, RX_QUEUE_SIZE,
+                                    rte_eth_dev_socket_id(device), NULL,
+                                    mbuf_pool);
+    if (retval != 0) {
+      return retval;
+    }
+  }
 
   // Start the device
   retval = rte_eth_dev_start(device);
@@ -134,36 +430,98 @@ static int nf_init_device(uint16_t device, struct rte_mempool *mbuf_pool) {
     return retval;
   }
 
+#ifndef KLEE_VERIFICATION
+  if (nb_queues > 1) {
+    retval = nf_set_reta(device, nb_queues);
+    if (retval != 0) {
+      return retval;
+    }
+  }
+#endif  // KLEE_VERIFICATION
+
   return 0;
 }
 
-// Main worker method (for now used on a single thread...)
-static void worker_main(void) {
+// Main worker method, runs on every lcore with its own NF instance
+static int worker_main(void *unused) {
+  (void)unused;
+  const uint16_t queue_id = nf_lcore_index();
+
+#ifdef VIGOR_TELEMETRY
+  telemetry_init_lcore(queue_id);
+#endif  // VIGOR_TELEMETRY
+
   if (!nf_init()) {
     rte_exit(EXIT_FAILURE, "Error initializing NF");
   }
 
-  NF_INFO("Core %u forwarding packets.", rte_lcore_id());
+#ifndef KLEE_VERIFICATION
+  struct vigor_alloc_stats alloc_stats;
+  vigor_alloc_get_stats(&alloc_stats);
+  NF_INFO("Core %u: NF state uses %zu KiB of hugepage memory and %zu KiB of "
+          "regular memory.",
+          rte_lcore_id(), alloc_stats.hugepage_bytes / 1024,
+          alloc_stats.fallback_bytes / 1024);
+  if (!rte_eal_has_hugepages()) {
+    NF_INFO("Warning: running without hugepages, performance will suffer.");
+  } else if (alloc_stats.fallback_bytes != 0) {
+    NF_INFO("Warning: not enough hugepage memory on socket %d, reserve more "
+            "hugepages for full performance.",
+            rte_eth_dev_socket_id(0));
+  }
+#endif  // KLEE_VERIFICATION
+
+  NF_INFO("Core %u forwarding packets on queue %" PRIu16 ".", rte_lcore_id(),
+          queue_id);
 
 #if VIGOR_BATCH_SIZE == 1
   VIGOR_LOOP_BEGIN
+#ifdef VIGOR_TELEMETRY
+  telemetry_tick(VIGOR_NOW);
+#endif  // VIGOR_TELEMETRY
   struct rte_mbuf *mbuf;
-  if (rte_eth_rx_burst(CONCRETE_VIGOR_DEVICE, 0, &mbuf, 1) != 0) {
+  if (rte_eth_rx_burst(CONCRETE_VIGOR_DEVICE, queue_id, &mbuf, 1) != 0) {
+#ifdef VIGOR_EXPIRATION_BUDGET
+    expirator_run(VIGOR_NOW, VIGOR_EXPIRATION_BUDGET);
+#endif  // VIGOR_EXPIRATION_BUDGET
     uint8_t *data = rte_pktmbuf_mtod(mbuf, uint8_t *);
     packet_state_total_length(data, &(mbuf->pkt_len));
+#ifndef KLEE_VERIFICATION
+    packet_state_mbuf(mbuf);
+#endif  // KLEE_VERIFICATION
 
+#ifdef VIGOR_TELEMETRY
+    telemetry_rx(VIGOR_DEVICE, 1);
+    uint64_t process_begin = telemetry_process_begin();
+#endif  // VIGOR_TELEMETRY
+#ifdef VIGOR_PROFILE
+    uint64_t profile_begin = rte_rdtsc();
+#endif  // VIGOR_PROFILE
     uint16_t dst_device =
         nf_process(VIGOR_DEVICE, &data, mbuf->pkt_len, VIGOR_NOW, mbuf);
+#ifdef VIGOR_PROFILE
+    profile_record(PROFILE_NF_PROCESS, rte_rdtsc() - profile_begin);
+#endif  // VIGOR_PROFILE
+#ifdef VIGOR_TELEMETRY
+    telemetry_process_end(process_begin);
+#endif  // VIGOR_TELEMETRY
     nf_return_all_chunks(data);
 
     if (dst_device == VIGOR_DEVICE) {
+#ifdef VIGOR_TELEMETRY
+      telemetry_nf_drop(VIGOR_DEVICE);
+#endif  // VIGOR_TELEMETRY
       rte_pktmbuf_free(mbuf);
     } else if (dst_device == FLOOD_FRAME) {
-      flood(mbuf, VIGOR_DEVICES_COUNT);
+      flood(mbuf, VIGOR_DEVICES_COUNT, queue_id);
     } else {
       // ensure we don't leak symbols into DPDK
       concretize_devices(&dst_device, rte_eth_dev_count_avail());
-      if (rte_eth_tx_burst(dst_device, 0, &mbuf, 1) != 1) {
+      uint16_t sent = rte_eth_tx_burst(dst_device, queue_id, &mbuf, 1);
+#ifdef VIGOR_TELEMETRY
+      telemetry_tx(dst_device, sent, 1 - sent);
+#endif  // VIGOR_TELEMETRY
+      if (sent != 1) {
 #ifdef VIGOR_ALLOW_DROPS
         rte_pktmbuf_free(mbuf);  // OK, we're debugging
 #else
@@ -175,56 +533,122 @@ static void worker_main(void) {
       }
     }
   }
+#ifdef VIGOR_EXPIRATION_BUDGET
+  else {
+    // Nothing to process, catch up on expiration
+    expirator_run(VIGOR_NOW, VIGOR_EXPIRATION_IDLE_BUDGET);
+  }
+#endif  // VIGOR_EXPIRATION_BUDGET
   VIGOR_LOOP_END
 
 #else  // if VIGOR_BATCH_SIZE != 1
 
-  if (rte_eth_dev_count_avail() != 2) {
-    printf(
-        "We assume there will be exactly 2 devices for our simple batching "
-        "implementation.");
-    exit(1);
-  }
   NF_INFO("Running with batches, this code is unverified!");
 
+  const uint16_t nb_devices = rte_eth_dev_count_avail();
+  struct tx_buffer tx_buffers[nb_devices];
+  for (uint16_t device = 0; device < nb_devices; device++) {
+    tx_buffers[device].count = 0;
+  }
+
   while (1) {
-    unsigned VIGOR_DEVICES_COUNT = rte_eth_dev_count_avail();
-    for (uint16_t VIGOR_DEVICE = 0; VIGOR_DEVICE < VIGOR_DEVICES_COUNT;
-         VIGOR_DEVICE++) {
+    for (uint16_t device = 0; device < nb_devices; device++) {
       struct rte_mbuf *mbufs[VIGOR_BATCH_SIZE];
       uint16_t rx_count =
-          rte_eth_rx_burst(VIGOR_DEVICE, 0, mbufs, VIGOR_BATCH_SIZE);
+          rte_eth_rx_burst(device, queue_id, mbufs, VIGOR_BATCH_SIZE);
+#ifdef VIGOR_TELEMETRY
+      telemetry_rx(device, rx_count);
+#endif  // VIGOR_TELEMETRY
+
+#if defined(VIGOR_TIME_PER_BURST) || defined(VIGOR_EXPIRATION_BUDGET) || \
+    defined(VIGOR_TELEMETRY)
+      // Expiration and telemetry run once per burst, with the time at which
+      // it arrived; with VIGOR_TIME_PER_BURST, so do its packets
+      vigor_time_t burst_time = current_time();
+#endif
+
+#ifdef VIGOR_TELEMETRY
+      telemetry_tick(burst_time);
+#endif  // VIGOR_TELEMETRY
+
+#ifdef VIGOR_EXPIRATION_BUDGET
+      // Expire before processing the burst, like NFs do before each packet;
+      // catch up when there is nothing to process
+      expirator_run(burst_time, rx_count == 0 ? VIGOR_EXPIRATION_IDLE_BUDGET
+                                              : VIGOR_EXPIRATION_BUDGET);
+#endif  // VIGOR_EXPIRATION_BUDGET
+
+#ifdef VIGOR_PREFETCH_DISTANCE
+      // Keep the first stage VIGOR_PREFETCH_DISTANCE packets ahead of the
+      // second one; with a distance of at least the batch size, this is
+      // group prefetching
+      bool prefetch_hash_valid[VIGOR_BATCH_SIZE];
+      unsigned prefetch_hashes[VIGOR_BATCH_SIZE];
+      for (uint16_t n = 0; n < rx_count && n < VIGOR_PREFETCH_DISTANCE; n++) {
+        prefetch_hash_valid[n] = nf_prefetch(
+            device, rte_pktmbuf_mtod(mbufs[n], uint8_t *), mbufs[n]->pkt_len,
+            mbufs[n], &prefetch_hashes[n]);
+      }
+#endif  // VIGOR_PREFETCH_DISTANCE
 
-      struct rte_mbuf *mbufs_to_send[VIGOR_BATCH_SIZE];
-      uint16_t tx_count = 0;
       for (uint16_t n = 0; n < rx_count; n++) {
+#ifdef VIGOR_PREFETCH_DISTANCE
+        if (n + VIGOR_PREFETCH_DISTANCE < rx_count) {
+          uint16_t ahead = n + VIGOR_PREFETCH_DISTANCE;
+          prefetch_hash_valid[ahead] = nf_prefetch(
+              device, rte_pktmbuf_mtod(mbufs[ahead], uint8_t *),
+              mbufs[ahead]->pkt_len, mbufs[ahead], &prefetch_hashes[ahead]);
+        }
+        nf_prefetch_hash_valid = prefetch_hash_valid[n];
+        nf_prefetch_hash = prefetch_hashes[n];
+#endif  // VIGOR_PREFETCH_DISTANCE
         uint8_t *data = rte_pktmbuf_mtod(mbufs[n], uint8_t *);
         packet_state_total_length(data, &(mbufs[n]->pkt_len));
-        vigor_time_t VIGOR_NOW = current_time();
-        uint16_t dst_device = nf_process(
-            mbufs[n]->port, &data, mbufs[n]->pkt_len, VIGOR_NOW, mbufs[n]);
+#ifndef KLEE_VERIFICATION
+        packet_state_mbuf(mbufs[n]);
+#endif  // KLEE_VERIFICATION
+#ifdef VIGOR_TIME_PER_BURST
+        vigor_time_t now = burst_time;
+#else   // VIGOR_TIME_PER_BURST
+        vigor_time_t now = current_time();
+#endif  // VIGOR_TIME_PER_BURST
+#ifdef VIGOR_TELEMETRY
+        uint64_t process_begin = telemetry_process_begin();
+#endif  // VIGOR_TELEMETRY
+#ifdef VIGOR_PROFILE
+        uint64_t profile_begin = rte_rdtsc();
+#endif  // VIGOR_PROFILE
+        uint16_t dst_device =
+            nf_process(device, &data, mbufs[n]->pkt_len, now, mbufs[n]);
+#ifdef VIGOR_PROFILE
+        profile_record(PROFILE_NF_PROCESS, rte_rdtsc() - profile_begin);
+#endif  // VIGOR_PROFILE
+#ifdef VIGOR_TELEMETRY
+        telemetry_process_end(process_begin);
+#endif  // VIGOR_TELEMETRY
         nf_return_all_chunks(data);
 
-        if (dst_device == VIGOR_DEVICE) {
+        if (dst_device == FLOOD_FRAME) {
+          flood_batch(tx_buffers, nb_devices, queue_id, mbufs[n]);
+        } else if (dst_device == device || dst_device >= nb_devices) {
+#ifdef VIGOR_TELEMETRY
+          telemetry_nf_drop(device);
+#endif  // VIGOR_TELEMETRY
           rte_pktmbuf_free(mbufs[n]);
-        } else {  // includes flood when 2 devices, which is equivalent
-                  // to just
-                  // a
-                  // send
-          mbufs_to_send[tx_count] = mbufs[n];
-          tx_count++;
+        } else {
+          tx_buffer_add(tx_buffers, dst_device, queue_id, mbufs[n]);
         }
       }
 
-      uint16_t sent_count =
-          rte_eth_tx_burst(1 - VIGOR_DEVICE, 0, mbufs_to_send, tx_count);
-      for (uint16_t n = sent_count; n < tx_count; n++) {
-        rte_pktmbuf_free(mbufs[n]);  // should not happen, but we're in
-                                     // the unverified case anyway
+      // Do not hold packets across RX bursts, to bound latency
+      for (uint16_t dst_device = 0; dst_device < nb_devices; dst_device++) {
+        tx_buffer_flush(&tx_buffers[dst_device], dst_device, queue_id);
       }
     }
   }
 #endif
+
+  return 0;
 }
 
 // Entry point
@@ -241,13 +665,20 @@ int main(int argc, char **argv) {
   nf_config_init(argc, argv);
   nf_config_print();
 
+#ifndef KLEE_VERIFICATION
+  nf_init_lcores();
+  vigor_time_init();
+#endif  // KLEE_VERIFICATION
+
   // Create a memory pool
   unsigned nb_devices = rte_eth_dev_count_avail();
+  unsigned nb_lcores = nf_lcores_count();
   struct rte_mempool *mbuf_pool = rte_pktmbuf_pool_create(
-      "MEMPOOL",                          // name
-      MEMPOOL_BUFFER_COUNT * nb_devices,  // #elements
-      0,  // cache size (per-core, not useful in a single-threaded app)
-      0,  // application private area size
+      "MEMPOOL",                                      // name
+      MEMPOOL_BUFFER_COUNT * nb_devices * nb_lcores,  // #elements
+      // cache size (per-core, not useful in a single-threaded app)
+      nb_lcores > 1 ? MEMPOOL_CACHE_SIZE : 0,
+      0,                          // application private area size
       RTE_MBUF_DEFAULT_BUF_SIZE,  // data buffer size
       rte_socket_id()             // socket ID
   );
@@ -255,6 +686,29 @@ int main(int argc, char **argv) {
     rte_exit(EXIT_FAILURE, "Cannot create pool: %s\n", rte_strerror(rte_errno));
   }
 
+#if VIGOR_BATCH_SIZE != 1
+  // Flooded packets hold one clone per extra output device while in flight
+  clone_pool = rte_pktmbuf_pool_create(
+      "CLONE_POOL", MEMPOOL_BUFFER_COUNT * nb_devices * nb_lcores,
+      nb_lcores > 1 ? MEMPOOL_CACHE_SIZE : 0,
+      0,  // application private area size
+      0,  // no data buffer, clones point to the original's
+      rte_socket_id());
+  if (clone_pool == NULL) {
+    rte_exit(EXIT_FAILURE, "Cannot create clone pool: %s\n",
+             rte_strerror(rte_errno));
+  }
+#endif  // VIGOR_BATCH_SIZE != 1
+
+#ifdef VIGOR_CHECKSUM_OFFLOAD
+  nf_checksum_offload = nb_devices > 0;
+#endif  // VIGOR_CHECKSUM_OFFLOAD
+
+#ifdef VIGOR_RSS_HASH
+  rss_hash_init();
+  nf_rss_hash_offload = nb_devices > 0;
+#endif  // VIGOR_RSS_HASH
+
   // Initialize all devices
   for (uint16_t device = 0; device < nb_devices; device++) {
     ret = nf_init_device(device, mbuf_pool);
@@ -265,8 +719,55 @@ int main(int argc, char **argv) {
     }
   }
 
+#ifdef VIGOR_CHECKSUM_OFFLOAD
+  NF_INFO("Checksums are %s.", nf_checksum_offload
+                                   ? "offloaded"
+                                   : "updated in software, not all devices "
+                                     "can compute them");
+#endif  // VIGOR_CHECKSUM_OFFLOAD
+
+#ifdef VIGOR_RSS_HASH
+  NF_INFO("Flow hashes are %s.", nf_rss_hash_offload
+                                     ? "taken from the NICs"
+                                     : "computed in software, not all devices "
+                                       "can compute them");
+#endif  // VIGOR_RSS_HASH
+
+#ifndef KLEE_VERIFICATION
+  // Keep the NF state close to the NICs; with NICs on different sockets,
+  // the first one wins
+  if (nb_devices > 0) {
+    vigor_alloc_set_socket(rte_eth_dev_socket_id(0));
+  }
+#endif  // KLEE_VERIFICATION
+
+#ifdef VIGOR_TELEMETRY
+  if (!telemetry_init(nb_lcores, nb_devices)) {
+    rte_exit(EXIT_FAILURE, "Cannot create the telemetry region %s\n",
+             TELEMETRY_SHM_NAME);
+  }
+  NF_INFO("Publishing telemetry in shared memory region %s.",
+          TELEMETRY_SHM_NAME);
+#endif  // VIGOR_TELEMETRY
+
+#ifdef VIGOR_PROFILE
+  profile_init();
+  NF_INFO("Profiling, cycle histograms will be printed on SIGINT/SIGTERM.");
+#endif  // VIGOR_PROFILE
+
   // Run!
-  worker_main();
+#ifndef KLEE_VERIFICATION
+  unsigned lcore_id;
+  RTE_LCORE_FOREACH_SLAVE(lcore_id) {
+    rte_eal_remote_launch(worker_main, NULL, lcore_id);
+  }
+#endif  // KLEE_VERIFICATION
+
+  worker_main(NULL);
+
+#ifndef KLEE_VERIFICATION
+  rte_eal_mp_wait_lcore();
+#endif  // KLEE_VERIFICATION
 
   return 0;
 }
@@ -10,10 +10,27 @@
 struct nf_config;
 struct rte_mbuf;
 
+// Called once on every lcore, each of which runs its own NF instance
 bool nf_init(void);
 int nf_process(uint16_t device, uint8_t **buffer, uint16_t packet_length,
                vigor_time_t now, struct rte_mbuf *mbuf);
 
+#ifdef VIGOR_PREFETCH_DISTANCE
+// Unverified first stage of batched processing, for NFs built with
+// NF_PREFETCH: runs ahead of nf_process on the same packet, reading its headers
+// and prefetching the state nf_process will need. Must not modify the packet
+// or the NF state. Returns whether it left in *hash the hash of the key it
+// prefetched, which nf_process then gets from nf_prefetched_hash instead of
+// hashing the key again; with RSS_HASH, that is the mbuf's RSS hash if any.
+bool nf_prefetch(uint16_t device, uint8_t *packet, uint16_t packet_length,
+                 struct rte_mbuf *mbuf, unsigned *hash);
+#endif  // VIGOR_PREFETCH_DISTANCE
+
+// Number of lcores running NF instances, and the index in [0, count) of the
+// instance running on the calling lcore
+unsigned nf_lcores_count(void);
+unsigned nf_lcore_index(void);
+
 extern struct nf_config config;
 void nf_config_init(int argc, char **argv);
 void nf_config_usage(void);
@@ -4,7 +4,7 @@
 #ifdef KLEE_VERIFICATION
 #include "lib/models/verified/ether.h"
 #endif  // KLEE_VERIFICATION
-struct State* allocated_nf_state = NULL;
+VIGOR_PER_LCORE struct State* allocated_nf_state = NULL;
 
 struct State* alloc_state() {
   return NULL;
@@ -14,6 +14,9 @@
 #include "lib/verified/map.h"
 #include "lib/verified/vector.h"
 #include "lib/verified/expirator.h"
+#ifdef VIGOR_EXPIRATION_BUDGET
+#include "lib/unverified/expirator.h"
+#endif  // VIGOR_EXPIRATION_BUDGET
 
 struct nf_config config;
 
@@ -105,7 +108,21 @@ bool policer_check_tb(uint32_t dst, uint16_t size, vigor_time_t time) {
 bool nf_init(void) {
   unsigned capacity = config.dyn_capacity;
   dynamic_ft = alloc_state(capacity, rte_eth_dev_count_avail());
-  return dynamic_ft != NULL;
+  if (dynamic_ft == NULL) {
+    return false;
+  }
+
+#ifdef VIGOR_EXPIRATION_BUDGET
+  // Entries are expired by the runtime instead of policer_expire_entries
+  vigor_time_t exp_time =
+      VIGOR_TIME_SECONDS_MULTIPLIER * (config.burst / config.rate);
+  if (!expirator_register(dynamic_ft->dyn_heap, dynamic_ft->dyn_keys,
+                          dynamic_ft->dyn_map, exp_time)) {
+    return false;
+  }
+#endif  // VIGOR_EXPIRATION_BUDGET
+
+  return true;
 }
 
 int nf_process(uint16_t device, uint8_t **buffer, uint16_t packet_length,
@@ -120,7 +137,9 @@ int nf_process(uint16_t device, uint8_t **buffer, uint16_t packet_length,
     return device;
   }
 
+#ifndef VIGOR_EXPIRATION_BUDGET
   policer_expire_entries(now);
+#endif  // VIGOR_EXPIRATION_BUDGET
 
   if (device == config.lan_device) {
     // Simply forward outgoing packets.
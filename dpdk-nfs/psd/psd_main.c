@@ -22,8 +22,21 @@ bool nf_init(void) {
   uint32_t dev_count = rte_eth_dev_count_avail();
 
   state = alloc_state(capacity, max_ports, dev_count);
+  if (state == NULL) {
+    return false;
+  }
+
+#ifdef VIGOR_EXPIRATION_BUDGET
+  // Sources are expired by the runtime instead of expire_entries
+  uint64_t expiration_time_ns =
+      ((uint64_t)config.expiration_time) * 1000;  // us to ns
+  if (!expirator_register(state->allocator, state->srcs_key, state->srcs,
+                          expiration_time_ns)) {
+    return false;
+  }
+#endif  // VIGOR_EXPIRATION_BUDGET
 
-  return state != NULL;
+  return true;
 }
 
 void expire_entries(vigor_time_t time) {
@@ -159,7 +172,9 @@ int nf_process(uint16_t device, uint8_t **buffer, uint16_t packet_length,
     return device;
   }
 
+#ifndef VIGOR_EXPIRATION_BUDGET
   expire_entries(now);
+#endif  // VIGOR_EXPIRATION_BUDGET
 
   if (device == config.lan_device) {
     // Simply forward outgoing packets.
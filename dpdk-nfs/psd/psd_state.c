@@ -3,6 +3,7 @@
 #include <stdlib.h>
 
 #include "lib/verified/boilerplate-util.h"
+#include "lib/verified/vigor-alloc.h"
 #ifdef KLEE_VERIFICATION
 #include "lib/models/verified/double-chain-control.h"
 #include "lib/models/verified/ether.h"
@@ -24,7 +25,7 @@ struct State *alloc_state(uint32_t capacity, uint64_t max_ports,
                           uint32_t dev_count) {
   if (allocated_nf_state != NULL) return allocated_nf_state;
 
-  struct State *ret = malloc(sizeof(struct State));
+  struct State *ret = vigor_malloc(sizeof(struct State));
 
   if (ret == NULL) return NULL;
 
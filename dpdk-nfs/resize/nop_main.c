@@ -79,6 +79,27 @@ int nf_process(uint16_t device, uint8_t **buffer, uint16_t packet_length,
   // new_hdr[7] = 0xEF;
   // =========================================================
 
+  // =========================================================
+  // Example 5: remove ip options and add new header after ethernet header,
+  // moving the packet once (unverified)
+  // if (!ip_options) {
+  //   return device;
+  // }
+  //
+  // nf_return_chunk(buffer); // return TCP/UDP
+  //
+  // size_t new_hdr_length = 8;
+  // struct packet_chunk_edit edits[] = {
+  //     {.chunk = 0, .length = sizeof(struct rte_ether_hdr) + new_hdr_length},
+  //     {.chunk = 2, .length = 0}};
+  // nf_edit_chunks(buffer, edits, 2, mbuf);
+  //
+  // rte_ether_header = (struct rte_ether_hdr *)nf_get_borrowed_chunk(0);
+  // rte_ipv4_header = (struct rte_ipv4_hdr *)nf_get_borrowed_chunk(1);
+  //
+  // uint8_t *new_hdr = (uint8_t *)(rte_ether_header + 1);
+  // =========================================================
+
   // =========================================================
   // Example 4: add new header after ethernet header
   nf_return_chunk(buffer);  // return TCP/UDP
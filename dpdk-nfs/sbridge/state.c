@@ -3,6 +3,7 @@
 #include <stdlib.h>
 
 #include "lib/verified/boilerplate-util.h"
+#include "lib/verified/vigor-alloc.h"
 
 #ifdef KLEE_VERIFICATION
 #include "lib/models/verified/double-chain-control.h"
@@ -27,7 +28,7 @@ bool stat_map_condition(void* value, int index, void* state) {
 struct State* alloc_state(uint32_t capacity, uint32_t stat_capacity,
                           uint32_t dev_count) {
   if (allocated_nf_state != NULL) return allocated_nf_state;
-  struct State* ret = malloc(sizeof(struct State));
+  struct State* ret = vigor_malloc(sizeof(struct State));
   if (ret == NULL) return NULL;
   ret->dyn_map = NULL;
   if (map_allocate(rte_ether_addr_eq, rte_ether_addr_hash, capacity,
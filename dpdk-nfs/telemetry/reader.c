@@ -0,0 +1,102 @@
+// Polls the telemetry of a running NF built with TELEMETRY=true,
+// and prints what changed every interval.
+// Usage: reader [interval in ms, default 1000]
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lib/unverified/telemetry.h"
+
+static const struct telemetry_region *open_region(void) {
+  int fd = shm_open(TELEMETRY_SHM_NAME, O_RDONLY, 0);
+  if (fd < 0) {
+    return NULL;
+  }
+  void *mapped = mmap(NULL, sizeof(struct telemetry_region), PROT_READ,
+                      MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    return NULL;
+  }
+
+  const struct telemetry_region *region = mapped;
+  if (__atomic_load_n(&region->magic, __ATOMIC_ACQUIRE) != TELEMETRY_MAGIC ||
+      region->version != TELEMETRY_VERSION) {
+    munmap(mapped, sizeof(struct telemetry_region));
+    return NULL;
+  }
+  return region;
+}
+
+static void print_lcore(unsigned index, const struct telemetry_lcore *now,
+                        const struct telemetry_lcore *before,
+                        unsigned device_count, uint64_t tsc_hz,
+                        double seconds) {
+  uint64_t processed = now->processed - before->processed;
+  uint64_t cycles = now->process_cycles - before->process_cycles;
+  printf("lcore %u: %.0f pkt/s in nf_process, %" PRIu64
+         " cycles/pkt (%.1f%% busy)\n",
+         index, processed / seconds, processed == 0 ? 0 : cycles / processed,
+         100.0 * cycles / (tsc_hz * seconds));
+
+  for (unsigned device = 0; device < device_count; device++) {
+    const struct telemetry_device *d = &now->devices[device];
+    const struct telemetry_device *b = &before->devices[device];
+    printf("  device %u: rx %.0f/s, tx %.0f/s, nf drops %.0f/s, "
+           "tx drops %.0f/s\n",
+           device, (d->rx - b->rx) / seconds, (d->tx - b->tx) / seconds,
+           (d->nf_dropped - b->nf_dropped) / seconds,
+           (d->tx_dropped - b->tx_dropped) / seconds);
+  }
+
+  for (uint64_t map = 0; map < now->map_count; map++) {
+    printf("  map %" PRIu64 ": %" PRIu64 "/%" PRIu64 " (%.1f%%)\n", map,
+           now->maps[map].size, now->maps[map].capacity,
+           100.0 * now->maps[map].size / now->maps[map].capacity);
+  }
+
+  printf("  chain allocation failures: %" PRIu64 " (+%" PRIu64
+         "), expired last tick: %" PRIu64 "\n",
+         now->chain_allocation_failures,
+         now->chain_allocation_failures - before->chain_allocation_failures,
+         now->expired_last_tick);
+}
+
+int main(int argc, char **argv) {
+  unsigned interval_ms = argc > 1 ? atoi(argv[1]) : 1000;
+  if (interval_ms == 0) {
+    fprintf(stderr, "Usage: %s [interval in ms]\n", argv[0]);
+    return 1;
+  }
+
+  const struct telemetry_region *region = open_region();
+  if (region == NULL) {
+    fprintf(stderr, "No NF publishes telemetry in %s.\n", TELEMETRY_SHM_NAME);
+    return 1;
+  }
+
+  static struct telemetry_lcore before[TELEMETRY_MAX_LCORES];
+  memcpy(before, region->lcores, sizeof(before));
+
+  struct timespec sleep_time = {.tv_sec = interval_ms / 1000,
+                                .tv_nsec = (interval_ms % 1000) * 1000000L};
+  while (1) {
+    nanosleep(&sleep_time, NULL);
+
+    static struct telemetry_lcore now[TELEMETRY_MAX_LCORES];
+    memcpy(now, region->lcores, sizeof(now));
+    for (unsigned lcore = 0; lcore < region->lcore_count; lcore++) {
+      print_lcore(lcore, &now[lcore], &before[lcore], region->device_count,
+                  region->tsc_hz, interval_ms / 1000.0);
+    }
+    printf("\n");
+    fflush(stdout);
+    memcpy(before, now, sizeof(before));
+  }
+}
@@ -0,0 +1,242 @@
+// Tests of the checksum updates of nf_set_rte_ipv4_udptcp_checksum with
+// CHECKSUM=incremental (RFC 1624): headers are borrowed and rewritten like
+// NFs do, and the checksums must then be those of the rewritten packet
+//
+// Usage: checksum-test <EAL args>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <netinet/in.h>
+
+#include <rte_byteorder.h>
+#include <rte_common.h>
+#include <rte_eal.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_tcp.h>
+#include <rte_udp.h>
+
+#include "nf-util.h"
+
+#define MAX_PAYLOAD_LENGTH 64
+
+static unsigned failures = 0;
+
+static struct rte_mempool *pool;
+
+// The one's complement sum of the big-endian 16-bit words of the data, padded
+// with a zero byte, computed byte by byte to be independent of nf-util and DPDK
+static uint32_t sum_words(const void *data, size_t length, uint32_t sum) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  for (size_t i = 0; i + 1 < length; i += 2) {
+    sum += (uint32_t)bytes[i] << 8 | bytes[i + 1];
+  }
+  if (length % 2 != 0) {
+    sum += (uint32_t)bytes[length - 1] << 8;
+  }
+  return sum;
+}
+
+static uint16_t fold(uint32_t sum) {
+  while (sum >> 16 != 0) {
+    sum = (sum & 0xffff) + (sum >> 16);
+  }
+  return sum;
+}
+
+static uint32_t pseudo_header_sum(const struct rte_ipv4_hdr *ip_header,
+                                  uint16_t l4_length) {
+  uint8_t pseudo_header[12];
+  memcpy(pseudo_header, &ip_header->src_addr, 8);
+  pseudo_header[8] = 0;
+  pseudo_header[9] = ip_header->next_proto_id;
+  pseudo_header[10] = l4_length >> 8;
+  pseudo_header[11] = l4_length & 0xff;
+  return sum_words(pseudo_header, sizeof(pseudo_header), 0);
+}
+
+// A header or datagram is valid if its words, checksum included, sum to -0
+static bool ipv4_checksum_valid(const struct rte_ipv4_hdr *ip_header) {
+  return fold(sum_words(ip_header, sizeof(*ip_header), 0)) == 0xffff;
+}
+
+static bool l4_checksum_valid(const struct rte_ipv4_hdr *ip_header,
+                              const void *l4_header, uint16_t l4_length) {
+  uint32_t sum = pseudo_header_sum(ip_header, l4_length);
+  return fold(sum_words(l4_header, l4_length, sum)) == 0xffff;
+}
+
+// The L4 checksum field is in a packed header
+static uint16_t load_checksum(const uint8_t *field) {
+  uint16_t checksum;
+  memcpy(&checksum, field, sizeof(checksum));
+  return checksum;
+}
+
+static void store_checksum(uint8_t *field, uint16_t checksum) {
+  memcpy(field, &checksum, sizeof(checksum));
+}
+
+static void set_checksums(struct rte_ipv4_hdr *ip_header, uint8_t *l4_cksum,
+                          void *l4_header, uint16_t l4_length) {
+  ip_header->hdr_checksum = 0;
+  ip_header->hdr_checksum = rte_cpu_to_be_16(
+      (uint16_t)~fold(sum_words(ip_header, sizeof(*ip_header), 0)));
+  store_checksum(l4_cksum, 0);
+  uint32_t sum = pseudo_header_sum(ip_header, l4_length);
+  store_checksum(l4_cksum, rte_cpu_to_be_16((uint16_t)~fold(
+                               sum_words(l4_header, l4_length, sum))));
+}
+
+static void fail(unsigned iteration, const char *what) {
+  printf("FAIL iteration %u: %s\n", iteration, what);
+  failures++;
+}
+
+// Builds a random TCP or UDP packet with valid checksums, borrows its headers
+// like an NF, rewrites random fields of them and checks the updated checksums
+static void test_random_rewrite(unsigned iteration) {
+  struct rte_mbuf *mbuf = rte_pktmbuf_alloc(pool);
+  if (mbuf == NULL) {
+    rte_exit(EXIT_FAILURE, "Out of mbufs\n");
+  }
+
+  bool is_tcp = rand() % 2 == 0;
+  uint16_t l4_header_length =
+      is_tcp ? sizeof(struct rte_tcp_hdr) : sizeof(struct rte_udp_hdr);
+  uint16_t l4_length = l4_header_length + rand() % (MAX_PAYLOAD_LENGTH + 1);
+  uint32_t length = sizeof(struct rte_ether_hdr) +
+                    sizeof(struct rte_ipv4_hdr) + l4_length;
+  uint8_t *data = (uint8_t *)rte_pktmbuf_append(mbuf, length);
+  for (uint32_t i = 0; i < length; i++) {
+    data[i] = rand();
+  }
+
+  struct rte_ether_hdr *ether_header = (struct rte_ether_hdr *)data;
+  ether_header->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+  struct rte_ipv4_hdr *ip_header = (struct rte_ipv4_hdr *)(ether_header + 1);
+  ip_header->version_ihl = RTE_IPV4_VHL_DEF;
+  ip_header->total_length =
+      rte_cpu_to_be_16(sizeof(struct rte_ipv4_hdr) + l4_length);
+  ip_header->next_proto_id = is_tcp ? IPPROTO_TCP : IPPROTO_UDP;
+  void *l4_header = ip_header + 1;
+  uint8_t *l4_cksum;
+  bool no_udp_checksum = false;
+  if (is_tcp) {
+    struct rte_tcp_hdr *tcp_header = (struct rte_tcp_hdr *)l4_header;
+    tcp_header->data_off = (sizeof(struct rte_tcp_hdr) / 4) << 4;
+    l4_cksum = (uint8_t *)l4_header + offsetof(struct rte_tcp_hdr, cksum);
+  } else {
+    struct rte_udp_hdr *udp_header = (struct rte_udp_hdr *)l4_header;
+    udp_header->dgram_len = rte_cpu_to_be_16(l4_length);
+    l4_cksum = (uint8_t *)l4_header + offsetof(struct rte_udp_hdr, dgram_cksum);
+  }
+  set_checksums(ip_header, l4_cksum, l4_header, l4_length);
+  if (!is_tcp && rand() % 4 == 0) {
+    no_udp_checksum = true;
+    store_checksum(l4_cksum, 0);
+  }
+
+  // NFs borrow the ports only, or the whole L4 header
+  uint8_t *p = data;
+  packet_state_total_length(p, &length);
+  packet_state_mbuf(mbuf);
+  struct rte_ether_hdr *borrowed_ether = nf_then_get_rte_ether_header(&p);
+  struct rte_ipv4_hdr *borrowed_ip =
+      nf_then_get_rte_ipv4_header(borrowed_ether, &p);
+  bool whole_l4 = rand() % 2 == 0;
+  void *borrowed_l4;
+  if (!whole_l4) {
+    borrowed_l4 = nf_then_get_tcpudp_header(borrowed_ip, &p);
+  } else if (is_tcp) {
+    borrowed_l4 = nf_then_get_tcp_header(borrowed_ip, &p);
+  } else {
+    borrowed_l4 = nf_then_get_udp_header(borrowed_ip, &p);
+  }
+  if (borrowed_ip != ip_header || borrowed_l4 != l4_header) {
+    fail(iteration, "headers not borrowed in place");
+    nf_return_all_chunks(p);
+    rte_pktmbuf_free(mbuf);
+    return;
+  }
+
+  // Any field but the lengths, the protocol and the checksums themselves
+  if (rand() % 2 == 0) {
+    ip_header->src_addr = rand();
+  }
+  if (rand() % 2 == 0) {
+    ip_header->dst_addr = rand();
+  }
+  if (rand() % 2 == 0) {
+    ip_header->time_to_live = rand();
+  }
+  if (rand() % 4 == 0) {
+    ip_header->type_of_service = rand();
+    ip_header->packet_id = rand();
+    ip_header->fragment_offset = rand();
+  }
+  struct tcpudp_hdr *ports = (struct tcpudp_hdr *)l4_header;
+  if (rand() % 2 == 0) {
+    ports->src_port = rand();
+  }
+  if (rand() % 2 == 0) {
+    ports->dst_port = rand();
+  }
+  if (whole_l4 && is_tcp) {
+    struct rte_tcp_hdr *tcp_header = (struct rte_tcp_hdr *)l4_header;
+    tcp_header->sent_seq = rand();
+    tcp_header->recv_ack = rand();
+    tcp_header->tcp_flags = rand();
+    tcp_header->rx_win = rand();
+  }
+
+  nf_set_rte_ipv4_udptcp_checksum(ip_header, l4_header, p);
+
+  if (!ipv4_checksum_valid(ip_header)) {
+    fail(iteration, "wrong IPv4 checksum");
+  }
+  if (no_udp_checksum) {
+    if (load_checksum(l4_cksum) != 0) {
+      fail(iteration, "UDP checksum added");
+    }
+  } else if (load_checksum(l4_cksum) == 0 && !is_tcp) {
+    fail(iteration, "UDP checksum of 0, i.e. none");
+  } else if (!l4_checksum_valid(ip_header, l4_header, l4_length)) {
+    fail(iteration, is_tcp ? "wrong TCP checksum" : "wrong UDP checksum");
+  }
+
+  nf_return_all_chunks(p);
+  rte_pktmbuf_free(mbuf);
+}
+
+int main(int argc, char **argv) {
+  if (rte_eal_init(argc, argv) < 0) {
+    rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+  }
+
+  pool = rte_pktmbuf_pool_create("test", 63, 0, 0, RTE_MBUF_DEFAULT_BUF_SIZE,
+                                 rte_socket_id());
+  if (pool == NULL) {
+    rte_exit(EXIT_FAILURE, "Cannot create the mbuf pool\n");
+  }
+
+  srand(1);
+  for (unsigned iteration = 0; iteration < 100000 && failures == 0;
+       iteration++) {
+    test_random_rewrite(iteration);
+  }
+
+  if (failures != 0) {
+    printf("checksum-test: %u failures\n", failures);
+    return EXIT_FAILURE;
+  }
+  printf("checksum-test: OK\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,98 @@
+// Tests of the bounded expiration scheduler, lib/unverified/expirator.c
+//
+// Usage: expirator-test <EAL args>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <rte_common.h>
+#include <rte_eal.h>
+
+#include "lib/unverified/expirator.h"
+
+#define CAPACITY 1024
+#define EXPIRATION_TIME 10
+
+static unsigned failures = 0;
+
+struct table {
+  struct DoubleChain *chain;
+  struct Vector *vector;
+  struct Map *map;
+};
+
+static bool key_eq(void *a, void *b) { return *(int *)a == *(int *)b; }
+
+static unsigned key_hash(void *key) { return *(unsigned *)key; }
+
+static void key_init(void *key) { *(int *)key = 0; }
+
+static void table_init(struct table *table) {
+  if (dchain_allocate(CAPACITY, &table->chain) == 0 ||
+      vector_allocate(sizeof(int), CAPACITY, key_init, &table->vector) == 0 ||
+      map_allocate(key_eq, key_hash, CAPACITY, &table->map) == 0 ||
+      !expirator_register(table->chain, table->vector, table->map,
+                          EXPIRATION_TIME)) {
+    rte_exit(EXIT_FAILURE, "Cannot allocate the table\n");
+  }
+}
+
+static void table_fill(struct table *table, int count, vigor_time_t time) {
+  for (int i = 0; i < count; i++) {
+    int index;
+    dchain_allocate_new_index(table->chain, &index, time);
+    int *key;
+    vector_borrow(table->vector, index, (void **)&key);
+    *key = index;
+    map_put(table->map, key, index);
+    vector_return(table->vector, index, key);
+  }
+}
+
+static bool table_has_expired(struct table *table, vigor_time_t now) {
+  int index;
+  return dchain_expire_one_index(table->chain, &index, now - EXPIRATION_TIME);
+}
+
+// A table with more expired items than the budget must not keep the tables
+// after it from expiring theirs
+static void test_no_starvation(void) {
+  struct table busy, quiet;
+  table_init(&busy);
+  table_init(&quiet);
+  table_fill(&busy, CAPACITY, 0);
+  table_fill(&quiet, 4, 0);
+
+  vigor_time_t now = 2 * EXPIRATION_TIME;
+  for (int run = 0; run < 2; run++) {
+    if (expirator_run(now, 16) != 16) {
+      printf("FAIL starvation: run %d did not use up the budget\n", run);
+      failures++;
+    }
+  }
+  if (table_has_expired(&quiet, now)) {
+    printf("FAIL starvation: the quiet table was never expired\n");
+    failures++;
+  }
+  if (!table_has_expired(&busy, now)) {
+    printf("FAIL starvation: the busy table expired more than the budget\n");
+    failures++;
+  }
+}
+
+int main(int argc, char **argv) {
+  if (rte_eal_init(argc, argv) < 0) {
+    rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+  }
+
+  test_no_starvation();
+
+  if (failures != 0) {
+    printf("expirator-test: %u failures\n", failures);
+    return EXIT_FAILURE;
+  }
+  printf("expirator-test: OK\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,210 @@
+// Tests of the LPM_LAYOUT=dynamic table, lib/unverified/lpm-dir-24-8-dynamic.c
+//
+// Usage: lpm-test <EAL args>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <rte_common.h>
+#include <rte_eal.h>
+
+#include "lib/verified/lpm-dir-24-8.h"
+
+#define IP(a, b, c, d) \
+  ((uint32_t)(a) << 24 | (uint32_t)(b) << 16 | (uint32_t)(c) << 8 | (d))
+
+static unsigned failures = 0;
+
+static void check_lookup(struct lpm *lpm, uint32_t address, int expected,
+                         const char *what) {
+  int value = lpm_lookup_elem(lpm, address);
+  if (value != expected) {
+    printf("FAIL %s: %08x -> %d, expected %d\n", what, address, value,
+           expected);
+    failures++;
+  }
+}
+
+// Two /25s with the same value are left after deleting a /26 inside them:
+// their group must survive, since deleting one of them needs it
+static void test_group_of_long_rules(void) {
+  struct lpm *lpm;
+  if (!lpm_allocate(&lpm)) {
+    rte_exit(EXIT_FAILURE, "Cannot allocate the table\n");
+  }
+
+  // Groups are handed out lowest first: 10.0.1.0/24 gets group 0 and
+  // 10.0.2.0/24 group 1, which is also the value of the /25s, so that
+  // mistaking one of their entries for a group hits a live one
+  lpm_update_elem(lpm, IP(10, 0, 1, 0), 25, 9);
+  lpm_update_elem(lpm, IP(10, 0, 2, 0), 25, 9);
+  lpm_update_elem(lpm, IP(10, 0, 0, 0), 25, 1);
+  lpm_update_elem(lpm, IP(10, 0, 0, 128), 25, 1);
+  lpm_update_elem(lpm, IP(10, 0, 0, 0), 26, 7);
+  check_lookup(lpm, IP(10, 0, 0, 1), 7, "/26");
+
+  if (!lpm_delete_elem(lpm, IP(10, 0, 0, 0), 26)) {
+    printf("FAIL delete /26\n");
+    failures++;
+  }
+  check_lookup(lpm, IP(10, 0, 0, 1), 1, "/25 after deleting the /26");
+
+  if (!lpm_delete_elem(lpm, IP(10, 0, 0, 0), 25)) {
+    printf("FAIL delete /25\n");
+    failures++;
+  }
+  check_lookup(lpm, IP(10, 0, 0, 1), INVALID, "deleted /25");
+  check_lookup(lpm, IP(10, 0, 0, 129), 1, "other /25");
+  check_lookup(lpm, IP(10, 0, 1, 1), 9, "other /24's group 0");
+  check_lookup(lpm, IP(10, 0, 2, 1), 9, "other /24's group 1");
+
+  lpm_free(lpm);
+}
+
+// Reference table for the fuzz test: the rules, looked up by scanning them
+#define FUZZ_MAX_RULES 16
+// Addresses looked up after every step
+#define FUZZ_LOOKUPS 64
+
+struct fuzz_rule {
+  uint32_t prefix;
+  uint8_t prefixlen;
+  uint16_t value;
+};
+
+static struct fuzz_rule fuzz_rules[FUZZ_MAX_RULES];
+static unsigned fuzz_rule_count = 0;
+
+static uint32_t fuzz_mask(uint8_t prefixlen) {
+  return prefixlen == 0 ? 0 : UINT32_MAX << (32 - prefixlen);
+}
+
+static int fuzz_find(uint32_t prefix, uint8_t prefixlen) {
+  for (unsigned i = 0; i < fuzz_rule_count; i++) {
+    if (fuzz_rules[i].prefix == prefix &&
+        fuzz_rules[i].prefixlen == prefixlen) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int fuzz_lookup(uint32_t address) {
+  int value = INVALID;
+  int best = -1;
+  for (unsigned i = 0; i < fuzz_rule_count; i++) {
+    struct fuzz_rule *rule = &fuzz_rules[i];
+    if ((address & fuzz_mask(rule->prefixlen)) == rule->prefix &&
+        rule->prefixlen > best) {
+      best = rule->prefixlen;
+      value = rule->value;
+    }
+  }
+  return value;
+}
+
+// Rules of all lengths within a few /24s, so that they nest and share groups,
+// and often /25s: two of them with the same value cover a whole /24 with
+// rules longer than 24 bits
+static void fuzz_random_rule(uint32_t *prefix, uint8_t *prefixlen) {
+  switch (rand() % 4) {
+    case 0:
+      *prefixlen = 8 + rand() % 17;
+      break;
+    case 1:
+      *prefixlen = 25;
+      break;
+    default:
+      *prefixlen = 25 + rand() % 8;
+  }
+  *prefix = (IP(10, 0, 0, 0) | (rand() & 0x3FF)) & fuzz_mask(*prefixlen);
+}
+
+// @returns whether the table and the reference agree on random addresses
+static bool fuzz_check(struct lpm *lpm, unsigned step) {
+  unsigned failures_before = failures;
+  uint32_t addresses[FUZZ_LOOKUPS];
+  uint16_t values[FUZZ_LOOKUPS];
+  for (unsigned i = 0; i < FUZZ_LOOKUPS; i++) {
+    addresses[i] = IP(10, 0, 0, 0) | (rand() & 0x7FF);
+  }
+  lpm_lookup_bulk(lpm, addresses, values, FUZZ_LOOKUPS);
+  for (unsigned i = 0; i < FUZZ_LOOKUPS; i++) {
+    int expected = fuzz_lookup(addresses[i]);
+    check_lookup(lpm, addresses[i], expected, "fuzz");
+    if (values[i] != expected) {
+      printf("FAIL fuzz step %u: bulk %08x -> %d, expected %d\n", step,
+             addresses[i], values[i], expected);
+      failures++;
+    }
+  }
+  return failures == failures_before;
+}
+
+// Random adds and deletes, checked against the reference table
+static void test_fuzz(void) {
+  struct lpm *lpm;
+  if (!lpm_allocate(&lpm)) {
+    rte_exit(EXIT_FAILURE, "Cannot allocate the table\n");
+  }
+
+  srand(1);
+  for (unsigned step = 0; step < 20000; step++) {
+    uint32_t prefix;
+    uint8_t prefixlen;
+    bool add = rand() % 2 == 0 && fuzz_rule_count < FUZZ_MAX_RULES;
+    if (!add && fuzz_rule_count != 0 && rand() % 4 != 0) {
+      // Mostly delete rules that exist
+      struct fuzz_rule *rule = &fuzz_rules[rand() % fuzz_rule_count];
+      prefix = rule->prefix;
+      prefixlen = rule->prefixlen;
+    } else {
+      fuzz_random_rule(&prefix, &prefixlen);
+    }
+    int found = fuzz_find(prefix, prefixlen);
+    if (add) {
+      uint16_t value = rand() % 4;
+      if (!lpm_update_elem(lpm, prefix, prefixlen, value)) {
+        printf("FAIL fuzz step %u: add %08x/%u\n", step, prefix, prefixlen);
+        failures++;
+      }
+      if (found < 0) {
+        found = fuzz_rule_count++;
+      }
+      fuzz_rules[found] = (struct fuzz_rule){prefix, prefixlen, value};
+    } else {
+      if (lpm_delete_elem(lpm, prefix, prefixlen) != (found >= 0)) {
+        printf("FAIL fuzz step %u: delete %08x/%u returned %d\n", step, prefix,
+               prefixlen, found < 0);
+        failures++;
+      }
+      if (found >= 0) {
+        fuzz_rules[found] = fuzz_rules[--fuzz_rule_count];
+      }
+    }
+    // The first divergence says it all
+    if (!fuzz_check(lpm, step)) {
+      break;
+    }
+  }
+
+  lpm_free(lpm);
+}
+
+int main(int argc, char **argv) {
+  if (rte_eal_init(argc, argv) < 0) {
+    rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+  }
+
+  test_group_of_long_rules();
+  test_fuzz();
+
+  if (failures != 0) {
+    printf("lpm-test: %u failures\n", failures);
+    return EXIT_FAILURE;
+  }
+  printf("lpm-test: OK\n");
+  return EXIT_SUCCESS;
+}
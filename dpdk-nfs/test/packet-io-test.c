@@ -0,0 +1,175 @@
+// Tests of the chunk edits of lib/verified/packet-io.c, packet_edit_chunks
+// and the packet_shrink_chunk/packet_insert_new_chunk built on it
+//
+// Usage: packet-io-test <EAL args>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <rte_common.h>
+#include <rte_eal.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+
+#include "lib/verified/packet-io.h"
+
+#define MAX_PACKET_LENGTH 256
+#define MAX_CHUNKS 6
+#define MAX_CHUNK_LENGTH 24
+
+static unsigned failures = 0;
+
+static struct rte_mempool *pool;
+
+// A borrowed chunk as the test expects it after the edits: its offset in the
+// packet, and how many of its first bytes are those it had before
+struct expected_chunk {
+  size_t offset;
+  size_t length;
+  size_t kept;
+  const uint8_t *original;  // bytes before the edits
+};
+
+static void fail(unsigned iteration, const char *what) {
+  printf("FAIL iteration %u: %s\n", iteration, what);
+  failures++;
+}
+
+// Borrows random chunks from a random packet, edits random ones of them, and
+// checks where all of the packet's bytes end up
+static void test_random_edits(unsigned iteration) {
+  struct rte_mbuf *mbuf = rte_pktmbuf_alloc(pool);
+  if (mbuf == NULL) {
+    rte_exit(EXIT_FAILURE, "Out of mbufs\n");
+  }
+  // Little headroom makes the edits move the tail of the packet instead
+  mbuf->data_off = rand() % (RTE_PKTMBUF_HEADROOM + 1);
+
+  // Long enough for all chunks
+  uint32_t min_length = MAX_CHUNKS * MAX_CHUNK_LENGTH;
+  uint32_t length = min_length + rand() % (MAX_PACKET_LENGTH - min_length);
+  uint8_t original[MAX_PACKET_LENGTH];
+  for (uint32_t i = 0; i < length; i++) {
+    original[i] = rand();
+  }
+  void *p = rte_pktmbuf_append(mbuf, length);
+  memcpy(p, original, length);
+  packet_state_total_length(p, &length);
+  packet_state_mbuf(mbuf);
+
+  void *chunks[MAX_CHUNKS + 1];
+  size_t num_chunks = 1 + rand() % MAX_CHUNKS;
+  size_t lengths[MAX_CHUNKS];
+  size_t read_length = 0;
+  for (size_t i = 0; i < num_chunks; i++) {
+    lengths[i] = 1 + rand() % MAX_CHUNK_LENGTH;
+    packet_borrow_next_chunk(p, lengths[i], &chunks[i]);
+    read_length += lengths[i];
+  }
+
+  // Edits of distinct chunks, in order, possibly one adding a chunk
+  struct packet_chunk_edit edits[PACKET_MAX_CHUNK_EDITS];
+  size_t num_edits = 0;
+  for (size_t chunk = 0; chunk <= num_chunks; chunk++) {
+    if (num_edits < PACKET_MAX_CHUNK_EDITS && rand() % 2 == 0) {
+      edits[num_edits].chunk = chunk;
+      edits[num_edits].length = 1 + rand() % MAX_CHUNK_LENGTH;
+      num_edits++;
+    }
+  }
+  if (num_edits == 0) {
+    edits[0].chunk = rand() % (num_chunks + 1);
+    edits[0].length = 1 + rand() % MAX_CHUNK_LENGTH;
+    num_edits = 1;
+  }
+
+  struct expected_chunk expected[MAX_CHUNKS + 1];
+  size_t expected_num_chunks = num_chunks;
+  size_t offset = 0;
+  size_t k = 0;
+  for (size_t i = 0; i < num_chunks; i++) {
+    size_t new_length = lengths[i];
+    if (k < num_edits && edits[k].chunk == i) {
+      new_length = edits[k].length;
+      k++;
+    }
+    expected[i] = (struct expected_chunk){
+        .offset = offset,
+        .length = new_length,
+        .kept = RTE_MIN(new_length, lengths[i]),
+        .original = original + ((uint8_t *)chunks[i] - (uint8_t *)p)};
+    offset += new_length;
+  }
+  if (k < num_edits) {
+    expected[num_chunks] = (struct expected_chunk){
+        .offset = offset, .length = edits[k].length, .kept = 0};
+    offset += edits[k].length;
+    expected_num_chunks++;
+  }
+  size_t unread_length = length - read_length;
+  size_t expected_length = offset + unread_length;
+
+  packet_edit_chunks(&p, chunks, &num_chunks, edits, num_edits, mbuf);
+
+  uint8_t *data = rte_pktmbuf_mtod(mbuf, uint8_t *);
+  if (p != data) {
+    fail(iteration, "the packet does not start at the mbuf's data");
+  }
+  if (rte_pktmbuf_pkt_len(mbuf) != expected_length ||
+      rte_pktmbuf_data_len(mbuf) != expected_length) {
+    fail(iteration, "wrong mbuf length");
+  }
+  if (packet_get_unread_length(p) != unread_length) {
+    fail(iteration, "wrong unread length");
+  }
+  if (num_chunks != expected_num_chunks) {
+    fail(iteration, "wrong number of chunks");
+    num_chunks = RTE_MIN(num_chunks, expected_num_chunks);
+  }
+  for (size_t i = 0; i < num_chunks; i++) {
+    if (chunks[i] != data + expected[i].offset) {
+      fail(iteration, "chunk at the wrong place");
+    } else if (memcmp(chunks[i], expected[i].original, expected[i].kept) !=
+               0) {
+      fail(iteration, "chunk lost its bytes");
+    }
+  }
+  if (memcmp(data + offset, original + read_length, unread_length) != 0) {
+    fail(iteration, "unread bytes lost");
+  }
+
+  for (size_t i = num_chunks; i-- > 0;) {
+    packet_return_chunk(p, chunks[i]);
+  }
+  if (packet_get_unread_length(p) != expected_length) {
+    fail(iteration, "chunks not returned");
+  }
+  rte_pktmbuf_free(mbuf);
+}
+
+int main(int argc, char **argv) {
+  if (rte_eal_init(argc, argv) < 0) {
+    rte_exit(EXIT_FAILURE, "Error with EAL initialization\n");
+  }
+
+  pool = rte_pktmbuf_pool_create("test", 63, 0, 0, RTE_MBUF_DEFAULT_BUF_SIZE,
+                                 rte_socket_id());
+  if (pool == NULL) {
+    rte_exit(EXIT_FAILURE, "Cannot create the mbuf pool\n");
+  }
+
+  srand(1);
+  for (unsigned iteration = 0; iteration < 100000 && failures == 0;
+       iteration++) {
+    test_random_edits(iteration);
+  }
+
+  if (failures != 0) {
+    printf("packet-io-test: %u failures\n", failures);
+    return EXIT_FAILURE;
+  }
+  printf("packet-io-test: OK\n");
+  return EXIT_SUCCESS;
+}